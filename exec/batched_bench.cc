@@ -0,0 +1,165 @@
+#include <iostream>
+#include <chrono>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_naive.hpp"
+#include "batched_gemm.hpp"
+
+using namespace ocl;
+
+
+// Mean absolute error of the batch results (stored back to back) versus the references
+float BatchError(const std::vector<float>& results, const std::vector<Matrix>& references) {
+  float err = 0.0f;
+  size_t count = 0;
+  for (size_t b = 0; b < references.size(); b++) {
+    const Matrix& reference = references[b];
+    for (size_t i = 0; i < reference.NumElmts(); i++) {
+      err += std::abs(results[b * reference.NumElmts() + i] - reference.RawPtr()[i]);
+      count++;
+    }
+  }
+  return count > 0 ? err / count : 0.0f;
+}
+
+void PrintTimes(const std::string& title, double seconds, size_t batch_count, float err) {
+  std::cout << "<<< " << title << " >>>" << std::endl;
+  std::cout << "total: " << seconds * 1e3 << " ms, "
+            << "per product: " << seconds / batch_count * 1e6 << " us" << std::endl;
+  std::cout << "err.: " << err << std::endl;
+  std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <kernel dir> [batch count] [M] [N] [K]" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+  const int batch_count = argc > 2 ? std::stoi(argv[2]) : 4096;
+  const int M = argc > 3 ? std::stoi(argv[3]) : 8;
+  const int N = argc > 4 ? std::stoi(argv[4]) : 8;
+  const int K = argc > 5 ? std::stoi(argv[5]) : 8;
+
+  // Operands of all products stored back to back, column-major each
+  const int lhs_size = M * K, rhs_size = K * N, result_size = M * N;
+  std::vector<float> lhs(static_cast<size_t>(batch_count) * lhs_size);
+  std::vector<float> rhs(static_cast<size_t>(batch_count) * rhs_size);
+  std::vector<Matrix> references;
+  for (int b = 0; b < batch_count; b++) {
+    Matrix a(M, K), c(K, N), reference(M, N);
+    for (size_t i = 0; i < a.NumElmts(); i++) {
+      a.RawPtr()[i] = lhs[b * lhs_size + i] = (static_cast<int>((b + i) % 7) - 3) / 4.0f;
+    }
+    for (size_t i = 0; i < c.NumElmts(); i++) {
+      c.RawPtr()[i] = rhs[b * rhs_size + i] = (static_cast<int>((b * 3 + i) % 5) - 2) / 4.0f;
+    }
+    matmul_naive(a, c, reference);
+    references.push_back(reference);
+  }
+
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
+  Context context(device);
+  CommandQueue queue(context, device);
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  KernelVariants matmul_variants(
+    device, context, utils::ReadKernelFileFromDisk(kernel_dir + "/matmul.cl"), {}, &program_cache
+  );
+  // Argument info lets BatchedGemm check the kernel signatures
+  KernelVariants batched_variants(
+    device, context, utils::ReadKernelFileFromDisk(kernel_dir + "/matmul_batched.cl"),
+    { "-cl-kernel-arg-info" }, &program_cache
+  );
+
+  Buffer<float> device_lhs(context, lhs.size());
+  Buffer<float> device_rhs(context, rhs.size());
+  Buffer<float> device_results(context, static_cast<size_t>(batch_count) * result_size);
+  device_lhs.CopyFromHost(queue, lhs.data(), lhs.size());
+  device_rhs.CopyFromHost(queue, rhs.data(), rhs.size());
+  std::vector<float> results(static_cast<size_t>(batch_count) * result_size);
+
+  // Baseline: one matmul_v1 launch per product on its own buffers
+  {
+    Kernel kernel = matmul_variants.Get("matmul_v1", {});
+    std::vector<Buffer<float>> device_lhs_list, device_rhs_list, device_result_list;
+    for (int b = 0; b < batch_count; b++) {
+      device_lhs_list.emplace_back(context, lhs_size);
+      device_rhs_list.emplace_back(context, rhs_size);
+      device_result_list.emplace_back(context, result_size);
+      device_lhs_list[b].CopyFromHost(queue, &lhs[b * lhs_size], lhs_size);
+      device_rhs_list[b].CopyFromHost(queue, &rhs[b * rhs_size], rhs_size);
+    }
+
+    size_t global_work_size[2] = { static_cast<size_t>(M), static_cast<size_t>(N) };
+    auto start = std::chrono::steady_clock::now();
+    for (int b = 0; b < batch_count; b++) {
+      kernel.SetArguments(M, N, K, device_lhs_list[b](), device_rhs_list[b](), device_result_list[b]());
+      kernel.Run(queue, 2, nullptr, global_work_size, nullptr);
+    }
+    queue.Finish();
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+    for (int b = 0; b < batch_count; b++) {
+      device_result_list[b].CopyFromDevice(queue, &results[b * result_size], result_size);
+    }
+    PrintTimes("matmul_v1, one launch per product", diff.count(), batch_count, BatchError(results, references));
+  }
+
+  BatchedGemm batched(batched_variants);
+
+  // Strided batch: one launch over the back to back operands
+  {
+    std::fill(results.begin(), results.end(), 0.0f);
+    auto start = std::chrono::steady_clock::now();
+    Event event = batched.RunStrided(
+      queue, M, N, K, batch_count,
+      device_lhs, lhs_size,
+      device_rhs, rhs_size,
+      device_results, result_size
+    );
+    event.Wait();
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+    device_results.CopyFromDevice(queue, results.data(), results.size());
+    PrintTimes("matmul_batched_strided, one launch", diff.count(), batch_count, BatchError(results, references));
+    std::cout << "kernel time: " << event.Duration() * 1e3 << " ms" << std::endl << std::endl;
+  }
+
+  // Pointer-array batch: the same products through offset arrays
+  {
+    std::vector<int> lhs_offsets(batch_count), rhs_offsets(batch_count), result_offsets(batch_count);
+    for (int b = 0; b < batch_count; b++) {
+      lhs_offsets[b] = b * lhs_size;
+      rhs_offsets[b] = b * rhs_size;
+      result_offsets[b] = b * result_size;
+    }
+    Buffer<int> device_lhs_offsets(context, batch_count);
+    Buffer<int> device_rhs_offsets(context, batch_count);
+    Buffer<int> device_result_offsets(context, batch_count);
+    device_lhs_offsets.CopyFromHost(queue, lhs_offsets.data(), batch_count);
+    device_rhs_offsets.CopyFromHost(queue, rhs_offsets.data(), batch_count);
+    device_result_offsets.CopyFromHost(queue, result_offsets.data(), batch_count);
+
+    // The strided run left the right products in device_results
+    std::fill(results.begin(), results.end(), 0.0f);
+    device_results.CopyFromHost(queue, results.data(), results.size());
+    auto start = std::chrono::steady_clock::now();
+    Event event = batched.RunIndexed(
+      queue, M, N, K, batch_count,
+      device_lhs, device_lhs_offsets,
+      device_rhs, device_rhs_offsets,
+      device_results, device_result_offsets
+    );
+    event.Wait();
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+    device_results.CopyFromDevice(queue, results.data(), results.size());
+    PrintTimes("matmul_batched_indexed, one launch", diff.count(), batch_count, BatchError(results, references));
+    std::cout << "kernel time: " << event.Duration() * 1e3 << " ms" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+
+#include "ocl/ocl.h"
+
+
+/// @brief Many small products result[b] = lhs[b] * rhs[b] of one shape in a
+/// single clEnqueueNDRangeKernel, using the kernels of matmul_batched.cl.
+///
+/// Each work-group covers several matrices: the first dimension walks the
+/// M * N elements of a product and the second one the batch.
+class BatchedGemm {
+public:
+  /// @param variants Variants of the matmul_batched.cl program
+  explicit BatchedGemm(ocl::KernelVariants& variants)
+    : strided_(variants.Get("matmul_batched_strided", {})),
+      indexed_(variants.Get("matmul_batched_indexed", {})) {}
+
+  /// @brief Strided batch: product b starts at element b * stride of each buffer
+  ocl::Event RunStrided(ocl::CommandQueue& queue,
+                        int M, int N, int K,
+                        int batch_count,
+                        ocl::Buffer<float>& lhs, int lhs_stride,
+                        ocl::Buffer<float>& rhs, int rhs_stride,
+                        ocl::Buffer<float>& result, int result_stride,
+                        cl_uint num_events_in_wait_list=0,
+                        const cl_event* event_wait_list=nullptr) {
+    strided_.SetArguments(
+      M, N, K, batch_count,
+      lhs, lhs_stride,
+      rhs, rhs_stride,
+      result, result_stride
+    );
+    return Launch(strided_, queue, M, N, batch_count, num_events_in_wait_list, event_wait_list);
+  }
+
+  /// @brief Pointer-array batch: product b starts at the element offsets
+  /// lhs_offsets[b], rhs_offsets[b] and result_offsets[b]
+  ocl::Event RunIndexed(ocl::CommandQueue& queue,
+                        int M, int N, int K,
+                        int batch_count,
+                        ocl::Buffer<float>& lhs, ocl::Buffer<int>& lhs_offsets,
+                        ocl::Buffer<float>& rhs, ocl::Buffer<int>& rhs_offsets,
+                        ocl::Buffer<float>& result, ocl::Buffer<int>& result_offsets,
+                        cl_uint num_events_in_wait_list=0,
+                        const cl_event* event_wait_list=nullptr) {
+    indexed_.SetArguments(
+      M, N, K, batch_count,
+      lhs, lhs_offsets,
+      rhs, rhs_offsets,
+      result, result_offsets
+    );
+    return Launch(indexed_, queue, M, N, batch_count, num_events_in_wait_list, event_wait_list);
+  }
+
+  /// @brief Work-group shape: up to 64 elements of one product along the
+  /// first dimension, and enough products along the second one to fill 64
+  /// work-items
+  static void LocalWorkSize(int M, int N, size_t local_work_size[2]) {
+    size_t elements = 1;
+    while (elements < static_cast<size_t>(M * N) && elements < 64) {
+      elements *= 2;
+    }
+    local_work_size[0] = elements;
+    local_work_size[1] = std::max(size_t{1}, 64 / elements);
+  }
+
+private:
+  typedef ocl::TypedKernel<int, int, int, int,
+                           ocl::Buffer<float>, int,
+                           ocl::Buffer<float>, int,
+                           ocl::Buffer<float>, int> StridedKernel;
+  typedef ocl::TypedKernel<int, int, int, int,
+                           ocl::Buffer<float>, ocl::Buffer<int>,
+                           ocl::Buffer<float>, ocl::Buffer<int>,
+                           ocl::Buffer<float>, ocl::Buffer<int>> IndexedKernel;
+
+  StridedKernel strided_;
+  IndexedKernel indexed_;
+
+  static size_t RoundUp(size_t size, size_t multiple) {
+    return (size + multiple - 1) / multiple * multiple;
+  }
+
+  template <typename Kernel>
+  ocl::Event Launch(Kernel& kernel,
+                    ocl::CommandQueue& queue,
+                    int M, int N,
+                    int batch_count,
+                    cl_uint num_events_in_wait_list,
+                    const cl_event* event_wait_list) {
+    size_t local_work_size[2];
+    LocalWorkSize(M, N, local_work_size);
+    size_t global_work_size[2] = {
+      RoundUp(M * N, local_work_size[0]),
+      RoundUp(batch_count, local_work_size[1])
+    };
+    return kernel.Run(
+      queue,
+      2,
+      global_work_size,
+      local_work_size,
+      num_events_in_wait_list,
+      event_wait_list
+    );
+  }
+}; // class BatchedGemm
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_tuner.hpp"
+#include "primitives.hpp"
+
+namespace bench {
+
+  /// @brief GEMM problem size: (M x K) * (K x N)
+  struct Shape {
+    int M;
+    int N;
+    int K;
+  };
+
+  /// @brief Parse a comma separated list of 'MxNxK' shapes
+  inline std::vector<Shape> ParseShapes(const std::string& list) {
+    std::vector<Shape> shapes;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+      Shape shape;
+      char x1 = 0, x2 = 0;
+      std::istringstream fields(item);
+      fields >> shape.M >> x1 >> shape.N >> x2 >> shape.K;
+      if (!fields || x1 != 'x' || x2 != 'x') {
+        throw std::runtime_error("Invalid shape: " + item);
+      }
+      shapes.push_back(shape);
+    }
+    return shapes;
+  }
+
+
+  /// @brief OpenCL objects shared by all benchmarks of a run
+  class Environment {
+  public:
+    explicit Environment(const ocl::Device& device,
+                         const std::string& kernel_dir,
+                         const std::string& cache_dir,
+                         const std::string& tuning_db)
+      : device(device), context(device), queue(context, device),
+        memory_pool(context), program_cache(cache_dir),
+        kernel_dir_(kernel_dir), tuning_db_(tuning_db) {}
+
+    ocl::Device device;
+    ocl::Context context;
+    ocl::CommandQueue queue;
+    ocl::MemoryPool memory_pool;
+    ocl::ProgramCache program_cache;
+
+    /// @brief Variants of the program in '<kernel_dir>/<file_name>'
+    ocl::KernelVariants& Variants(const std::string& file_name) {
+      auto it = variants_.find(file_name);
+      if (it == variants_.end()) {
+        std::string source = utils::ReadKernelFileFromDisk(kernel_dir_ + "/" + file_name);
+        std::unique_ptr<ocl::KernelVariants> variants(
+          new ocl::KernelVariants(device, context, source, {}, &program_cache)
+        );
+        it = variants_.emplace(file_name, std::move(variants)).first;
+      }
+      return *it->second;
+    }
+
+    /// @brief Reductions and comparisons of primitives.cl
+    DevicePrimitives& Primitives() {
+      if (!primitives_) {
+        primitives_.reset(new DevicePrimitives(context, Variants("primitives.cl")));
+      }
+      return *primitives_;
+    }
+
+    /// @brief Auto-tuner of the kernels in matmul.cl
+    MatmulTuner& Tuner() {
+      if (!tuner_) {
+        tuner_.reset(new MatmulTuner(device, context, queue, Variants("matmul.cl"), tuning_db_));
+      }
+      return *tuner_;
+    }
+
+  private:
+    std::string kernel_dir_;
+    std::string tuning_db_;
+    std::map<std::string, std::unique_ptr<ocl::KernelVariants>> variants_;
+    std::unique_ptr<MatmulTuner> tuner_;
+    std::unique_ptr<DevicePrimitives> primitives_;
+  }; // class Environment
+
+
+  /// @brief A GEMM implementation under test.
+  ///
+  /// Setup() is called once per shape and may throw or return false when
+  /// the shape is not supported, Run() once per warmup and repeat.
+  class GemmBenchmark {
+  public:
+    virtual ~GemmBenchmark() {}
+
+    /// @brief Prepare (e.g. upload) the operands of result = lhs * rhs
+    virtual bool Setup(Environment& env, const Matrix& lhs, const Matrix& rhs) = 0;
+
+    /// @brief Compute the product once and return the measured time in seconds
+    virtual double Run(Environment& env) = 0;
+
+    /// @brief Copy the result of the last run into 'result'
+    virtual void GetResult(Environment& env, Matrix& result) = 0;
+
+    /// @brief Device buffer holding the float result of the last run, which
+    /// lets the harness check it on the device and read back two scalars;
+    /// nullptr to check the copy from GetResult on the host instead
+    virtual const ocl::Buffer<float>* DeviceResult() const { return nullptr; }
+
+    /// @brief Bytes of one stored operand element, for the reported GB/s
+    virtual size_t ElementBytes() const { return sizeof(float); }
+  }; // class GemmBenchmark
+
+  typedef std::function<std::unique_ptr<GemmBenchmark>()> GemmBenchmarkFactory;
+
+  /// @brief Benchmarks register themselves here with REGISTER_GEMM_BENCHMARK
+  class Registry {
+  public:
+    static Registry& Instance() {
+      static Registry registry;
+      return registry;
+    }
+
+    bool Register(const std::string& name, const GemmBenchmarkFactory& factory) {
+      entries_.emplace_back(name, factory);
+      return true;
+    }
+
+    const std::vector<std::pair<std::string, GemmBenchmarkFactory>>& Entries() const {
+      return entries_;
+    }
+
+  private:
+    std::vector<std::pair<std::string, GemmBenchmarkFactory>> entries_;
+  }; // class Registry
+
+#define REGISTER_GEMM_BENCHMARK(_name, _factory) \
+  static const bool _registered_##_factory =     \
+    bench::Registry::Instance().Register(_name, _factory)
+
+
+  /// @brief Summary of the measured times of one (benchmark, shape) pair
+  struct Result {
+    std::string name;
+    Shape shape;
+    size_t num_repeats = 0;
+    double min_seconds = 0.0;
+    double median_seconds = 0.0;
+    double p95_seconds = 0.0;
+    double mean_seconds = 0.0;
+    double gflops = 0.0;        // at the median time
+    double gbytes_per_sec = 0.0; // compulsory traffic at the median time
+    double error = 0.0;         // mean absolute error versus the reference
+  };
+
+  inline Result Summarize(const std::string& name,
+                          const Shape& shape,
+                          std::vector<double> seconds,
+                          double error,
+                          size_t element_bytes=sizeof(float)) {
+    Result result;
+    result.name = name;
+    result.shape = shape;
+    result.num_repeats = seconds.size();
+    result.error = error;
+    if (seconds.empty()) {
+      return result;
+    }
+
+    std::sort(seconds.begin(), seconds.end());
+    const size_t n = seconds.size();
+    result.min_seconds = seconds.front();
+    result.median_seconds = n % 2 == 1
+      ? seconds[n / 2]
+      : 0.5 * (seconds[n / 2 - 1] + seconds[n / 2]);
+    result.p95_seconds = seconds[std::min(n - 1, static_cast<size_t>(std::ceil(0.95 * n)) - 1)];
+    double total = 0.0;
+    for (double s : seconds) {
+      total += s;
+    }
+    result.mean_seconds = total / n;
+
+    const double flops = 2.0 * shape.M * shape.N * shape.K;
+    const double bytes = element_bytes *
+      (static_cast<double>(shape.M) * shape.K + static_cast<double>(shape.K) * shape.N
+       + static_cast<double>(shape.M) * shape.N);
+    if (result.median_seconds > 0.0) {
+      result.gflops = flops / result.median_seconds * 1e-9;
+      result.gbytes_per_sec = bytes / result.median_seconds * 1e-9;
+    }
+    return result;
+  }
+
+  inline double MeanAbsError(const Matrix& result, const Matrix& ref) {
+    double err = 0.0;
+    for (size_t i = 0; i < ref.NumElmts(); i++) {
+      err += std::abs(result.RawPtr()[i] - ref.RawPtr()[i]);
+    }
+    return ref.NumElmts() > 0 ? err / ref.NumElmts() : 0.0;
+  }
+
+  inline std::string ShapeString(const Shape& shape) {
+    return std::to_string(shape.M) + "x" + std::to_string(shape.N) + "x" + std::to_string(shape.K);
+  }
+
+  inline void PrintTable(std::ostream& os, const std::vector<Result>& results) {
+    os << std::left << std::setw(20) << "benchmark"
+       << std::setw(18) << "shape"
+       << std::right << std::setw(12) << "min(ms)"
+       << std::setw(12) << "median(ms)"
+       << std::setw(12) << "p95(ms)"
+       << std::setw(11) << "GFLOP/s"
+       << std::setw(9) << "GB/s"
+       << std::setw(12) << "err." << std::endl;
+    for (const auto& r : results) {
+      os << std::left << std::setw(20) << r.name
+         << std::setw(18) << ShapeString(r.shape)
+         << std::right << std::fixed << std::setprecision(3)
+         << std::setw(12) << r.min_seconds * 1e3
+         << std::setw(12) << r.median_seconds * 1e3
+         << std::setw(12) << r.p95_seconds * 1e3
+         << std::setprecision(2)
+         << std::setw(11) << r.gflops
+         << std::setw(9) << r.gbytes_per_sec
+         << std::scientific << std::setprecision(2)
+         << std::setw(12) << r.error
+         << std::defaultfloat << std::endl;
+    }
+  }
+
+  inline void WriteCsv(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream os(path, std::ios::trunc);
+    os << "benchmark,M,N,K,repeats,min_s,median_s,p95_s,mean_s,gflops,gbytes_per_s,error\n";
+    os << std::setprecision(9);
+    for (const auto& r : results) {
+      os << r.name << "," << r.shape.M << "," << r.shape.N << "," << r.shape.K << ","
+         << r.num_repeats << "," << r.min_seconds << "," << r.median_seconds << ","
+         << r.p95_seconds << "," << r.mean_seconds << "," << r.gflops << ","
+         << r.gbytes_per_sec << "," << r.error << "\n";
+    }
+  }
+
+  /// @brief 'text' as the contents of a JSON string
+  inline std::string JsonEscape(const std::string& text) {
+    std::ostringstream os;
+    for (unsigned char c : text) {
+      if (c == '"' || c == '\\') {
+        os << '\\' << c;
+      } else if (c < 0x20) {
+        os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+           << std::dec << std::setfill(' ');
+      } else {
+        os << c;
+      }
+    }
+    return os.str();
+  }
+
+  inline void WriteJson(const std::string& path,
+                        const std::string& device_name,
+                        const std::string& driver_version,
+                        const std::vector<Result>& results) {
+    std::ofstream os(path, std::ios::trunc);
+    os << std::setprecision(9);
+    os << "{\n"
+       << "  \"device\": \"" << JsonEscape(device_name) << "\",\n"
+       << "  \"driver_version\": \"" << JsonEscape(driver_version) << "\",\n"
+       << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+      const Result& r = results[i];
+      os << "    {\"benchmark\": \"" << JsonEscape(r.name) << "\", "
+         << "\"M\": " << r.shape.M << ", \"N\": " << r.shape.N << ", \"K\": " << r.shape.K << ", "
+         << "\"repeats\": " << r.num_repeats << ", "
+         << "\"min_s\": " << r.min_seconds << ", "
+         << "\"median_s\": " << r.median_seconds << ", "
+         << "\"p95_s\": " << r.p95_seconds << ", "
+         << "\"mean_s\": " << r.mean_seconds << ", "
+         << "\"gflops\": " << r.gflops << ", "
+         << "\"gbytes_per_s\": " << r.gbytes_per_sec << ", "
+         << "\"error\": " << r.error << "}"
+         << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+  }
+
+} // namespace bench
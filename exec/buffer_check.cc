@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "benchmark.hpp"
+
+using namespace ocl;
+
+
+/// Check that CopyFromHost / CopyFromDevice offsets count elements, like
+/// the other copies of Buffer
+bool CheckCopyOffsets(bench::Environment& env) {
+  const size_t n = 64, offset = 5, count = 7;
+  std::vector<float> elements(n, 0.0f);
+  Buffer<float> buffer(env.context, n);
+  buffer.CopyFromHost(env.queue, elements.data(), n);
+
+  std::vector<float> written(count);
+  std::iota(written.begin(), written.end(), 1.0f);
+  buffer.CopyFromHost(env.queue, written.data(), count, offset);
+  std::copy(written.begin(), written.end(), elements.begin() + offset);
+
+  std::vector<float> all(n), read(count);
+  buffer.CopyFromDevice(env.queue, all.data(), n);
+  buffer.CopyFromDeviceAsync(env.queue, read.data(), count, offset).Wait();
+  const bool ok = all == elements && read == written;
+  std::cout << "element offsets: " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+/// Check sub-buffer views: origins of a view of a view, writes through a
+/// view seen from the root, AlignSubBufferOffset and the misaligned offset
+/// error
+bool CheckSubBuffers(bench::Environment& env) {
+  const size_t alignment = Buffer<float>(env.context, 1).SubBufferAlignment();
+  const size_t n = 8 * alignment;
+  Buffer<float> root(env.context, n);
+  std::vector<float> elements(n);
+  std::iota(elements.begin(), elements.end(), 0.0f);
+  root.CopyFromHost(env.queue, elements.data(), n);
+
+  // Views of views are taken on the root, at the sum of the offsets
+  Buffer<float> view(root, alignment, 4 * alignment);
+  Buffer<float> inner(view, 2 * alignment, alignment);
+  bool ok = view.Origin() == alignment && inner.Origin() == 3 * alignment
+         && view.NumElmts() == 4 * alignment && inner.NumElmts() == alignment;
+
+  std::vector<float> read(alignment);
+  inner.CopyFromDevice(env.queue, read.data(), alignment);
+  ok = ok && std::equal(read.begin(), read.end(), elements.begin() + 3 * alignment);
+
+  // Written through the innermost view, read back from the root
+  std::vector<float> written(alignment, -1.0f);
+  inner.CopyFromHost(env.queue, written.data(), alignment);
+  std::fill(elements.begin() + 3 * alignment, elements.begin() + 4 * alignment, -1.0f);
+  std::vector<float> all(n);
+  root.CopyFromDevice(env.queue, all.data(), n);
+  ok = ok && all == elements;
+
+  // Offsets are relative to the view, the alignment to the root
+  ok = ok && view.AlignSubBufferOffset(2 * alignment + alignment / 2) == 2 * alignment
+          && inner.AlignSubBufferOffset(alignment - 1) == 0;
+  if (alignment > 1) {
+    bool thrown = false;
+    try {
+      Buffer<float> misaligned(view, 1, 1);
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    ok = ok && thrown;
+  }
+
+  std::cout << "sub-buffers (alignment " << alignment << " elements): "
+            << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  bench::Environment env(
+    SelectDevice(DeviceCriteria::FromEnvironment()),
+    argc > 1 ? argv[1] : ".",
+    cache_dir != nullptr ? cache_dir : ".ocl_program_cache",
+    tuning_db != nullptr ? tuning_db : "matmul_tuning.db"
+  );
+  std::cout << "Device: " << env.device.Name() << std::endl << std::endl;
+
+  bool ok = CheckCopyOffsets(env);
+  ok = CheckSubBuffers(env) && ok;
+  std::cout << std::endl << (ok ? "All checks passed." : "Some checks FAILED.") << std::endl;
+  return ok ? 0 : 1;
+}
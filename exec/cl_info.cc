@@ -5,10 +5,51 @@
 #include <vector>
 #include <string>
 
-#include "ocl/platform.hpp"
-#include "ocl/device.hpp"
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "device_profile.hpp"
+
+// Measure the device and write its roofline profile
+int Characterize(const std::string& kernel_dir, const std::string& profile_path,
+                 const ocl::Device& device) {
+  ocl::Context context(device);
+  ocl::CommandQueue queue(context, device);
+  ocl::KernelVariants variants(
+    device, context, utils::ReadKernelFileFromDisk(kernel_dir + "/characterize.cl")
+  );
+
+  DeviceCharacterizer characterizer(device, context, queue, variants);
+  DeviceProfile profile = characterizer.Run();
+  profile.Print(std::cout);
+  profile.Save(profile_path);
+  std::cout << "Profile written to " << profile_path << std::endl;
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    if (std::string(argv[1]) != "--characterize" || argc < 3) {
+      std::cerr << "Usage: " << argv[0] << std::endl
+                << "       " << argv[0] << " --characterize <kernel dir> [profile file] [platform device]"
+                << std::endl;
+      return 1;
+    }
+    // The given platform / device, otherwise the fastest one
+    ocl::Device device;
+    if (argc > 5) {
+      std::vector<ocl::Platform> all_platforms = ocl::GetAllPlatforms();
+      const size_t platform_id = std::stoul(argv[4]);
+      if (platform_id >= all_platforms.size()) {
+        std::cerr << "Invalid platform ID " << platform_id << std::endl;
+        return 1;
+      }
+      device = ocl::Device(all_platforms[platform_id], std::stoul(argv[5]));
+    } else {
+      device = ocl::SelectDevice(ocl::DeviceCriteria::FromEnvironment());
+    }
+    return Characterize(argv[2], argc > 3 ? argv[3] : "device_profile.txt", device);
+  }
 
-int main(void) {
   std::vector<ocl::Platform> all_platforms = ocl::GetAllPlatforms();
   size_t num_platforms = all_platforms.size();
   
@@ -38,6 +79,12 @@ int main(void) {
 
     std::cout << "-------------------------------" << std::endl;
   }
+
+  // What the other executables run on, unless OCL_DEVICE_TYPE / OCL_DEVICE say otherwise
+  auto devices = ocl::SelectDevices(ocl::DeviceCriteria::FromEnvironment());
+  if (!devices.empty()) {
+    std::cout << "Selected device: " << devices.front().Name() << std::endl;
+  }
   
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "ocl/ocl.h"
+#include "matrix.hpp"
+
+
+/// @brief On-device copy, transpose, layout conversion and fill of float
+/// matrices, with the kernels of memcpy.cl.
+///
+/// All matrices are column-major unless a MatrixLayout says otherwise, and
+/// every call only enqueues work; wait on the returned event.
+class DataMovement {
+public:
+  /// @param variants Variants of the memcpy.cl program
+  /// @param tile_size Edge of the local-memory tile of the transpose
+  explicit DataMovement(ocl::KernelVariants& variants, size_t tile_size=16)
+    : copy_(variants.Get("copy_matrix", {})),
+      copy_strided_(variants.Get("copy_strided", {})),
+      transpose_(variants.Get("transpose", {{"TRANSPOSE_TILE", static_cast<long>(tile_size)}})),
+      fill_(variants.Get("fill", {})),
+      tile_size_(tile_size) {}
+
+  /// @brief dst = src for a rows x cols matrix
+  ocl::Event Copy(ocl::CommandQueue& queue,
+                  int rows, int cols,
+                  const ocl::Buffer<float>& src,
+                  ocl::Buffer<float>& dst) {
+    copy_.SetArguments(rows, cols, src(), dst());
+    size_t global_work_size[2] = { static_cast<size_t>(rows), static_cast<size_t>(cols) };
+    return copy_.Run(queue, 2, nullptr, global_work_size, nullptr);
+  }
+
+  /// @brief Copy a rows x cols sub-matrix. Offsets and leading dimensions
+  /// are in elements.
+  ocl::Event CopyStrided(ocl::CommandQueue& queue,
+                         int rows, int cols,
+                         const ocl::Buffer<float>& src, int src_offset, int src_ld,
+                         ocl::Buffer<float>& dst, int dst_offset, int dst_ld) {
+    copy_strided_.SetArguments(
+      rows, cols,
+      src(), src_offset, src_ld,
+      dst(), dst_offset, dst_ld
+    );
+    size_t global_work_size[2] = { static_cast<size_t>(rows), static_cast<size_t>(cols) };
+    return copy_strided_.Run(queue, 2, nullptr, global_work_size, nullptr);
+  }
+
+  /// @brief dst (cols x rows) = transpose of src (rows x cols)
+  ocl::Event Transpose(ocl::CommandQueue& queue,
+                       int rows, int cols,
+                       const ocl::Buffer<float>& src,
+                       ocl::Buffer<float>& dst) {
+    transpose_.SetArguments(rows, cols, src(), dst());
+    size_t global_work_size[2] = { RoundUp(rows, tile_size_), RoundUp(cols, tile_size_) };
+    size_t local_work_size[2] = { tile_size_, tile_size_ };
+    return transpose_.Run(queue, 2, nullptr, global_work_size, local_work_size);
+  }
+
+  /// @brief Re-order a rows x cols matrix stored in layout 'from' into
+  /// layout 'to'. A row-major matrix is the column-major storage of its
+  /// transpose, so a conversion is a transpose; same layouts are copied.
+  ocl::Event ConvertLayout(ocl::CommandQueue& queue,
+                           int rows, int cols,
+                           MatrixLayout from,
+                           MatrixLayout to,
+                           const ocl::Buffer<float>& src,
+                           ocl::Buffer<float>& dst) {
+    if (from == to) {
+      return dst.CopyFromBuffer(queue, src, static_cast<size_t>(rows) * cols);
+    }
+    if (from == MatrixLayout::kColMajor) {
+      return Transpose(queue, rows, cols, src, dst);
+    }
+    return Transpose(queue, cols, rows, src, dst);
+  }
+
+  /// @brief Upload a host matrix as is into 'staging' and convert it on the
+  /// device into 'dst' in the layout the consumer expects. Relies on the
+  /// in-order queue to run the conversion after the upload.
+  ocl::Event Upload(ocl::CommandQueue& queue,
+                    const Matrix& matrix,
+                    MatrixLayout layout,
+                    ocl::Buffer<float>& staging,
+                    ocl::Buffer<float>& dst) {
+    if (matrix.Layout() == layout) {
+      return dst.CopyFromHost(queue, matrix.RawPtr(), matrix.NumElmts(), 0, false);
+    }
+    staging.CopyFromHost(queue, matrix.RawPtr(), matrix.NumElmts(), 0, false);
+    return ConvertLayout(queue, matrix.Rows(), matrix.Cols(), matrix.Layout(), layout, staging, dst);
+  }
+
+  /// @brief Set the first 'num_elmts' elements of dst to 'value'
+  ocl::Event Fill(ocl::CommandQueue& queue,
+                  int num_elmts,
+                  float value,
+                  ocl::Buffer<float>& dst) {
+    fill_.SetArguments(num_elmts, value, dst());
+    size_t global_work_size[1] = { (static_cast<size_t>(num_elmts) + 3) / 4 };
+    return fill_.Run(queue, 1, nullptr, global_work_size, nullptr);
+  }
+
+private:
+  ocl::Kernel copy_;
+  ocl::Kernel copy_strided_;
+  ocl::Kernel transpose_;
+  ocl::Kernel fill_;
+  size_t tile_size_;
+
+  static size_t RoundUp(int size, size_t multiple) {
+    return (static_cast<size_t>(size) + multiple - 1) / multiple * multiple;
+  }
+}; // class DataMovement
+
+
+/// @brief Upload the rows x cols tile of a column-major host matrix at
+/// (row, col) into 'dst' at element 'dst_offset' with leading dimension
+/// 'dst_ld', straight from the matrix storage (no host packing).
+inline ocl::Future UploadTile(ocl::CommandQueue& queue,
+                              const Matrix& matrix,
+                              int row, int col, int rows, int cols,
+                              ocl::Buffer<float>& dst,
+                              size_t dst_offset,
+                              size_t dst_ld,
+                              const std::vector<ocl::Future>& dependencies={}) {
+  if (matrix.Layout() != MatrixLayout::kColMajor) {
+    throw std::runtime_error("UploadTile: the matrix must be column-major.");
+  }
+  const size_t ld = static_cast<size_t>(matrix.LeadingDimension());
+  return dst.CopyRectFromHostAsync(
+    queue, matrix.RawPtr() + static_cast<size_t>(col) * ld + row, ld,
+    static_cast<size_t>(rows), static_cast<size_t>(cols), dst_offset, dst_ld, dependencies
+  );
+}
+
+/// @brief Download a rows x cols tile of 'src' at element 'src_offset' with
+/// leading dimension 'src_ld' into a column-major host matrix at (row, col)
+inline ocl::Future DownloadTile(ocl::CommandQueue& queue,
+                                ocl::Buffer<float>& src,
+                                size_t src_offset,
+                                size_t src_ld,
+                                Matrix& matrix,
+                                int row, int col, int rows, int cols,
+                                const std::vector<ocl::Future>& dependencies={}) {
+  if (matrix.Layout() != MatrixLayout::kColMajor) {
+    throw std::runtime_error("DownloadTile: the matrix must be column-major.");
+  }
+  const size_t ld = static_cast<size_t>(matrix.LeadingDimension());
+  return src.CopyRectFromDeviceAsync(
+    queue, matrix.RawPtr() + static_cast<size_t>(col) * ld + row, ld,
+    static_cast<size_t>(rows), static_cast<size_t>(cols), src_offset, src_ld, dependencies
+  );
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+#include "ocl/ocl.h"
+
+
+/// @brief Bandwidth of one transfer size
+struct BandwidthSample {
+  size_t bytes = 0;
+  double gb_per_second = 0.0;
+};
+
+
+/// @brief Measured limits of a device: the roofs of a roofline model plus
+/// the transfer and launch costs around them.
+///
+/// Saved as a text file of '<key> <value...>' lines, so other tools (the
+/// tuner, plotting scripts) can load it without running the measurements:
+///
+///   device <name>
+///   launch_latency_us <us>
+///   peak_gflops_fp32 <GFLOP/s>            (fp16 / fp64: 0 if unsupported)
+///   global_bandwidth_gbs <GB/s>           (best device to device copy)
+///   local_bandwidth_gbs <GB/s>
+///   host_to_device <bytes> <GB/s>         (one line per transfer size;
+///   device_to_host <bytes> <GB/s>          same for device_to_device)
+struct DeviceProfile {
+  std::string device;
+  double launch_latency_us = 0.0;
+  double peak_gflops_fp16 = 0.0;
+  double peak_gflops_fp32 = 0.0;
+  double peak_gflops_fp64 = 0.0;
+  double local_bandwidth_gbs = 0.0;
+  std::vector<BandwidthSample> host_to_device;
+  std::vector<BandwidthSample> device_to_host;
+  std::vector<BandwidthSample> device_to_device;
+
+  /// @brief Memory roof: the best device to device bandwidth
+  double GlobalBandwidth() const {
+    double best = 0.0;
+    for (const auto& sample : device_to_device) {
+      best = std::max(best, sample.gb_per_second);
+    }
+    return best;
+  }
+
+  /// @brief Arithmetic intensity (FLOP/byte) above which a kernel is
+  /// compute-bound rather than memory-bound
+  double RidgePoint(double peak_gflops) const {
+    const double bandwidth = GlobalBandwidth();
+    return bandwidth > 0.0 ? peak_gflops / bandwidth : 0.0;
+  }
+
+  /// @brief Best GFLOP/s reachable at the given arithmetic intensity
+  double Attainable(double peak_gflops, double flops_per_byte) const {
+    return std::min(peak_gflops, flops_per_byte * GlobalBandwidth());
+  }
+
+  void Save(const std::string& path) const {
+    std::ofstream output_file_stream(path, std::ios::trunc);
+    if (!output_file_stream) {
+      throw std::runtime_error("Failed to write device profile '" + path + "'.");
+    }
+    output_file_stream << "device " << device << "\n"
+      << "launch_latency_us " << launch_latency_us << "\n"
+      << "peak_gflops_fp16 " << peak_gflops_fp16 << "\n"
+      << "peak_gflops_fp32 " << peak_gflops_fp32 << "\n"
+      << "peak_gflops_fp64 " << peak_gflops_fp64 << "\n"
+      << "global_bandwidth_gbs " << GlobalBandwidth() << "\n"
+      << "local_bandwidth_gbs " << local_bandwidth_gbs << "\n";
+    SaveSamples(output_file_stream, "host_to_device", host_to_device);
+    SaveSamples(output_file_stream, "device_to_host", device_to_host);
+    SaveSamples(output_file_stream, "device_to_device", device_to_device);
+  }
+
+  static DeviceProfile Load(const std::string& path) {
+    std::ifstream input_file_stream(path);
+    if (!input_file_stream) {
+      throw std::runtime_error("Failed to read device profile '" + path + "'.");
+    }
+    DeviceProfile profile;
+    std::string line;
+    while (std::getline(input_file_stream, line)) {
+      std::istringstream fields(line);
+      std::string key;
+      fields >> key;
+      if (key == "device") {
+        std::getline(fields >> std::ws, profile.device);
+      } else if (key == "launch_latency_us") {
+        fields >> profile.launch_latency_us;
+      } else if (key == "peak_gflops_fp16") {
+        fields >> profile.peak_gflops_fp16;
+      } else if (key == "peak_gflops_fp32") {
+        fields >> profile.peak_gflops_fp32;
+      } else if (key == "peak_gflops_fp64") {
+        fields >> profile.peak_gflops_fp64;
+      } else if (key == "local_bandwidth_gbs") {
+        fields >> profile.local_bandwidth_gbs;
+      } else if (key == "host_to_device" || key == "device_to_host" || key == "device_to_device") {
+        BandwidthSample sample;
+        fields >> sample.bytes >> sample.gb_per_second;
+        if (fields) {
+          (key == "host_to_device" ? profile.host_to_device
+           : key == "device_to_host" ? profile.device_to_host
+           : profile.device_to_device).push_back(sample);
+        }
+      }
+      // global_bandwidth_gbs is derived from the samples; unknown keys are
+      // skipped so newer files still load
+    }
+    return profile;
+  }
+
+  void Print(std::ostream& os) const {
+    os << "device: " << device << std::endl
+       << std::fixed << std::setprecision(2)
+       << "launch latency: " << launch_latency_us << " us" << std::endl
+       << "peak FP32: " << peak_gflops_fp32 << " GFLOP/s, ridge point "
+       << RidgePoint(peak_gflops_fp32) << " FLOP/byte" << std::endl;
+    if (peak_gflops_fp16 > 0.0) {
+      os << "peak FP16: " << peak_gflops_fp16 << " GFLOP/s, ridge point "
+         << RidgePoint(peak_gflops_fp16) << " FLOP/byte" << std::endl;
+    }
+    if (peak_gflops_fp64 > 0.0) {
+      os << "peak FP64: " << peak_gflops_fp64 << " GFLOP/s, ridge point "
+         << RidgePoint(peak_gflops_fp64) << " FLOP/byte" << std::endl;
+    }
+    os << "global memory bandwidth: " << GlobalBandwidth() << " GB/s" << std::endl
+       << "local memory bandwidth: " << local_bandwidth_gbs << " GB/s" << std::endl;
+
+    os << std::setw(14) << "bytes" << std::setw(16) << "host->device"
+       << std::setw(16) << "device->host" << std::setw(18) << "device->device" << std::endl;
+    for (size_t i = 0; i < host_to_device.size(); i++) {
+      os << std::setw(14) << host_to_device[i].bytes
+         << std::setw(16) << host_to_device[i].gb_per_second
+         << std::setw(16) << (i < device_to_host.size() ? device_to_host[i].gb_per_second : 0.0)
+         << std::setw(18) << (i < device_to_device.size() ? device_to_device[i].gb_per_second : 0.0)
+         << std::endl;
+    }
+    os << std::defaultfloat;
+  }
+
+private:
+  static void SaveSamples(std::ostream& os, const std::string& key, const std::vector<BandwidthSample>& samples) {
+    for (const auto& sample : samples) {
+      os << key << " " << sample.bytes << " " << sample.gb_per_second << "\n";
+    }
+  }
+}; // struct DeviceProfile
+
+
+/// @brief Measures a DeviceProfile with the kernels of characterize.cl.
+///
+/// Device times come from profiling events and are the best of the
+/// repeats after one warmup, except for the launch latency, which is the
+/// mean host-side time from enqueue to completion of an empty kernel.
+class DeviceCharacterizer {
+public:
+  /// @param variants Variants of the characterize.cl program
+  explicit DeviceCharacterizer(const ocl::Device& device,
+                               const ocl::Context& context,
+                               ocl::CommandQueue& queue,
+                               ocl::KernelVariants& variants,
+                               size_t num_repeats=5)
+    : device_(device), context_(context), queue_(queue), variants_(variants),
+      num_repeats_(num_repeats) {}
+
+  /// @param max_transfer_bytes Largest transfer size; sizes go up by 4x
+  /// from 4 KiB and stay below half of the maximum allocation
+  DeviceProfile Run(size_t max_transfer_bytes=size_t{256} << 20) {
+    DeviceProfile profile;
+    profile.device = device_.Name();
+    profile.launch_latency_us = LaunchLatency() * 1e6;
+    profile.peak_gflops_fp32 = PeakGflops<cl_float>(32);
+    if (device_.SupportsFP16()) {
+      profile.peak_gflops_fp16 = PeakGflops<cl_half>(16);
+    }
+    if (device_.SupportsFP64()) {
+      profile.peak_gflops_fp64 = PeakGflops<cl_double>(64);
+    }
+    profile.local_bandwidth_gbs = LocalBandwidth();
+
+    const size_t max_bytes = std::min<size_t>(max_transfer_bytes, device_.MaxAllocSize() / 2);
+    for (size_t bytes = 4096; bytes <= max_bytes; bytes *= 4) {
+      TransferBandwidth(bytes, profile);
+    }
+    return profile;
+  }
+
+  /// @brief Mean host time of enqueueing an empty kernel and waiting for it
+  double LaunchLatency() {
+    ocl::TypedKernel<> kernel(variants_.Get("empty", {}));
+    const size_t global_work_size[1] = { 1 };
+    kernel(queue_, 1, global_work_size, nullptr).Wait();
+
+    const size_t num_launches = 100 * num_repeats_;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t n = 0; n < num_launches; n++) {
+      kernel(queue_, 1, global_work_size, nullptr).Wait();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count() / num_launches;
+  }
+
+  /// @brief Multiply-add throughput of peak_flops in the given precision
+  /// (16, 32 or 64 bits, with T the matching host type), or 0 when the
+  /// FP16 or FP64 variant does not build. Any other failure throws.
+  template <typename T>
+  double PeakGflops(int precision) {
+    const long kIterations = 256;
+    const size_t local_size = std::min<size_t>(256, device_.MaxWorkGroupSize());
+    const size_t global_size = device_.ComputeUnits() * 16 * local_size;
+    const ocl::VariantParams params = {{"PRECISION", precision}, {"FLOPS_ITERATIONS", kIterations}};
+    std::unique_ptr<ocl::Kernel> built;
+    try {
+      built.reset(new ocl::Kernel(variants_.Get("peak_flops", params)));
+    } catch (const std::runtime_error&) {
+      if (precision == 32) {
+        throw;
+      }
+      return 0.0;
+    }
+
+    ocl::TypedKernel<ocl::Buffer<T>, float, float> kernel(*built);
+    ocl::Buffer<T> result(context_, global_size);
+    const size_t global_work_size[1] = { global_size };
+    const size_t local_work_size[1] = { local_size };
+    kernel.SetArguments(result, 0.5f, 0.5f);
+    const double seconds = BestTime([&] {
+      return kernel.Run(queue_, 1, global_work_size, local_work_size);
+    });
+    const double flops = static_cast<double>(global_size) * kIterations * 8 * 4 * 2;
+    return flops / seconds * 1e-9;
+  }
+
+  /// @brief Read bandwidth of local memory
+  double LocalBandwidth() {
+    size_t local_size = 1;
+    while (local_size * 2 <= std::min<size_t>(256, device_.MaxWorkGroupSize())) {
+      local_size *= 2;
+    }
+    const int iterations = 1024;
+    const size_t global_size = device_.ComputeUnits() * 16 * local_size;
+    ocl::TypedKernel<ocl::Buffer<float>, int> kernel(
+      variants_.Get("local_bandwidth", {{"LOCAL_SIZE", static_cast<long>(local_size)}})
+    );
+    ocl::Buffer<float> result(context_, global_size);
+    const size_t global_work_size[1] = { global_size };
+    const size_t local_work_size[1] = { local_size };
+    kernel.SetArguments(result, iterations);
+    const double seconds = BestTime([&] {
+      return kernel.Run(queue_, 1, global_work_size, local_work_size);
+    });
+    // 4 float4 loads per iteration
+    const double bytes = static_cast<double>(global_size) * iterations * 4 * 4 * sizeof(float);
+    return bytes / seconds * 1e-9;
+  }
+
+  /// @brief Host to device, device to host and device to device bandwidth
+  /// of one transfer size, appended to the samples of 'profile'
+  void TransferBandwidth(size_t bytes, DeviceProfile& profile) {
+    const size_t num_elmts = bytes / sizeof(float);
+    std::vector<float> host(num_elmts, 1.0f);
+    ocl::Buffer<float> src(context_, num_elmts);
+    ocl::Buffer<float> dst(context_, num_elmts);
+
+    BandwidthSample sample;
+    sample.bytes = num_elmts * sizeof(float);
+    sample.gb_per_second = sample.bytes / BestTime([&] {
+      return src.CopyFromHost(queue_, host.data(), num_elmts, 0, false);
+    }) * 1e-9;
+    profile.host_to_device.push_back(sample);
+
+    sample.gb_per_second = sample.bytes / BestTime([&] {
+      return src.CopyFromDevice(queue_, host.data(), num_elmts, 0, false);
+    }) * 1e-9;
+    profile.device_to_host.push_back(sample);
+
+    // A copy reads and writes every byte
+    sample.gb_per_second = 2.0 * sample.bytes / BestTime([&] {
+      return dst.CopyFromBuffer(queue_, src, num_elmts);
+    }) * 1e-9;
+    profile.device_to_device.push_back(sample);
+  }
+
+private:
+  ocl::Device device_;
+  ocl::Context context_;
+  ocl::CommandQueue& queue_;
+  ocl::KernelVariants& variants_;
+  size_t num_repeats_;
+
+  // Best device time of the repeats of 'enqueue', after one warmup run
+  template <typename Function>
+  double BestTime(Function enqueue) {
+    double best = std::numeric_limits<double>::max();
+    for (size_t n = 0; n < num_repeats_ + 1; n++) {
+      ocl::Event event = enqueue();
+      event.Wait();
+      if (n > 0) {
+        best = std::min(best, event.Duration());
+      }
+    }
+    return std::max(best, 1e-9);
+  }
+}; // class DeviceCharacterizer
@@ -0,0 +1,229 @@
+#include "benchmark.hpp"
+#include "matmul_naive.hpp"
+#include "matmul_cpu.hpp"
+#include "matmul_precision.hpp"
+
+using namespace ocl;
+
+namespace {
+
+  /// Host implementations, timed with the wall clock
+  class HostBenchmark : public bench::GemmBenchmark {
+  public:
+    typedef std::function<void(const Matrix&, const Matrix&, Matrix&)> Gemm;
+
+    explicit HostBenchmark(const Gemm& gemm) : gemm_(gemm) {}
+
+    bool Setup(bench::Environment& /*env*/, const Matrix& lhs, const Matrix& rhs) override {
+      lhs_ = &lhs;
+      rhs_ = &rhs;
+      result_ = Matrix(lhs.Rows(), rhs.Cols());
+      return true;
+    }
+
+    double Run(bench::Environment& /*env*/) override {
+      auto start = std::chrono::high_resolution_clock::now();
+      gemm_(*lhs_, *rhs_, result_);
+      auto end = std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> diff = end - start;
+      return diff.count();
+    }
+
+    void GetResult(bench::Environment& /*env*/, Matrix& result) override {
+      result = result_;
+    }
+
+  private:
+    Gemm gemm_;
+    const Matrix* lhs_ = nullptr;
+    const Matrix* rhs_ = nullptr;
+    Matrix result_;
+  }; // class HostBenchmark
+
+
+  /// Kernels of matmul.cl with their tuned launch configuration, timed with
+  /// the device timestamps of the kernel launch
+  class MatmulKernelBenchmark : public bench::GemmBenchmark {
+  public:
+    explicit MatmulKernelBenchmark(const std::string& kernel_name)
+      : kernel_name_(kernel_name) {}
+
+    bool Setup(bench::Environment& env, const Matrix& lhs, const Matrix& rhs) override {
+      M_ = lhs.Rows();
+      N_ = rhs.Cols();
+      K_ = lhs.Cols();
+      config_ = env.Tuner().Get(kernel_name_, M_, N_, K_);
+
+      // Specialize the tuned variant for the problem shape
+      VariantParams params = config_.Params();
+      params["FIXED_M"] = M_;
+      params["FIXED_N"] = N_;
+      params["FIXED_K"] = K_;
+      kernel_.reset(new Kernel(env.Variants("matmul.cl").Get(kernel_name_, params)));
+
+      device_lhs_.reset(new Buffer<float>(env.memory_pool, M_ * K_));
+      device_rhs_.reset(new Buffer<float>(env.memory_pool, K_ * N_));
+      device_result_.reset(new Buffer<float>(env.memory_pool, M_ * N_));
+      device_lhs_->CopyFromHost(env.queue, lhs.RawPtr(), lhs.NumElmts());
+      device_rhs_->CopyFromHost(env.queue, rhs.RawPtr(), rhs.NumElmts());
+      kernel_->SetArguments(
+        M_, N_, K_,
+        (*device_lhs_)(),
+        (*device_rhs_)(),
+        (*device_result_)()
+      );
+      return true;
+    }
+
+    double Run(bench::Environment& env) override {
+      size_t global_work_size[2];
+      config_.GlobalWorkSize(M_, N_, global_work_size);
+      Event run = kernel_->Run(
+        env.queue,
+        2,
+        nullptr,
+        global_work_size,
+        config_.local_work_size
+      );
+      run.Wait();
+      return run.Duration();
+    }
+
+    void GetResult(bench::Environment& env, Matrix& result) override {
+      result = Matrix(M_, N_);
+      device_result_->CopyFromDevice(env.queue, result.RawPtr(), result.NumElmts());
+    }
+
+    const Buffer<float>* DeviceResult() const override {
+      return device_result_.get();
+    }
+
+  private:
+    std::string kernel_name_;
+    int M_ = 0, N_ = 0, K_ = 0;
+    MatmulConfig config_;
+    std::unique_ptr<Kernel> kernel_;
+    std::unique_ptr<Buffer<float>> device_lhs_;
+    std::unique_ptr<Buffer<float>> device_rhs_;
+    std::unique_ptr<Buffer<float>> device_result_;
+  }; // class MatmulKernelBenchmark
+
+
+  /// matmul_v3 with the operands stored as T and accumulated in 'precision',
+  /// skipped on devices without the needed extension. The tuned float
+  /// configuration is reused, with the tile shrunk if it no longer fits.
+  template <typename T>
+  class PrecisionBenchmark : public bench::GemmBenchmark {
+  public:
+    typedef TypedKernel<int, int, int, Buffer<T>, Buffer<T>, Buffer<T>> MatmulKernel;
+
+    explicit PrecisionBenchmark(GemmPrecision precision) : precision_(precision) {}
+
+    bool Setup(bench::Environment& env, const Matrix& lhs, const Matrix& rhs) override {
+      if (!IsPrecisionSupported(env.device, precision_)) {
+        return false;
+      }
+      M_ = lhs.Rows();
+      N_ = rhs.Cols();
+      K_ = lhs.Cols();
+      config_ = FitLocalMemory(env.device, env.Tuner().Get("matmul_v3", M_, N_, K_), precision_);
+
+      VariantParams params = config_.Params();
+      for (const auto& param : PrecisionParams(precision_)) {
+        params[param.first] = param.second;
+      }
+      params["FIXED_M"] = M_;
+      params["FIXED_N"] = N_;
+      params["FIXED_K"] = K_;
+      kernel_.reset(new MatmulKernel(env.Variants("matmul.cl").Get("matmul_v3", params)));
+
+      device_lhs_.reset(new Buffer<T>(env.memory_pool, M_ * K_));
+      device_rhs_.reset(new Buffer<T>(env.memory_pool, K_ * N_));
+      device_result_.reset(new Buffer<T>(env.memory_pool, M_ * N_));
+      Upload(env, lhs, *device_lhs_);
+      Upload(env, rhs, *device_rhs_);
+      return true;
+    }
+
+    double Run(bench::Environment& env) override {
+      size_t global_work_size[2];
+      config_.GlobalWorkSize(M_, N_, global_work_size);
+      Event run = (*kernel_)(
+        env.queue, 2, global_work_size, config_.local_work_size,
+        M_, N_, K_, *device_lhs_, *device_rhs_, *device_result_
+      );
+      run.Wait();
+      return run.Duration();
+    }
+
+    void GetResult(bench::Environment& env, Matrix& result) override {
+      std::vector<T> stored(static_cast<size_t>(M_) * N_);
+      device_result_->CopyFromDevice(env.queue, stored.data(), stored.size());
+      result = Matrix(M_, N_);
+      StorageConversion<T>::ToFloat(stored.data(), result.RawPtr(), stored.size());
+    }
+
+    size_t ElementBytes() const override { return sizeof(T); }
+
+  private:
+    void Upload(bench::Environment& env, const Matrix& matrix, Buffer<T>& buffer) {
+      std::vector<T> stored(matrix.NumElmts());
+      StorageConversion<T>::FromFloat(matrix.RawPtr(), stored.data(), stored.size());
+      buffer.CopyFromHost(env.queue, stored.data(), stored.size());
+    }
+
+    GemmPrecision precision_;
+    int M_ = 0, N_ = 0, K_ = 0;
+    MatmulConfig config_;
+    std::unique_ptr<MatmulKernel> kernel_;
+    std::unique_ptr<Buffer<T>> device_lhs_;
+    std::unique_ptr<Buffer<T>> device_rhs_;
+    std::unique_ptr<Buffer<T>> device_result_;
+  }; // class PrecisionBenchmark
+
+
+  std::unique_ptr<bench::GemmBenchmark> CreateNaive() {
+    return std::unique_ptr<bench::GemmBenchmark>(new HostBenchmark(matmul_naive));
+  }
+
+  std::unique_ptr<bench::GemmBenchmark> CreateCpu() {
+    return std::unique_ptr<bench::GemmBenchmark>(new HostBenchmark(
+      [](const Matrix& lhs, const Matrix& rhs, Matrix& result) { matmul_cpu(lhs, rhs, result); }
+    ));
+  }
+
+  std::unique_ptr<bench::GemmBenchmark> CreateMatmulV1() {
+    return std::unique_ptr<bench::GemmBenchmark>(new MatmulKernelBenchmark("matmul_v1"));
+  }
+
+  std::unique_ptr<bench::GemmBenchmark> CreateMatmulV2() {
+    return std::unique_ptr<bench::GemmBenchmark>(new MatmulKernelBenchmark("matmul_v2"));
+  }
+
+  std::unique_ptr<bench::GemmBenchmark> CreateMatmulV3() {
+    return std::unique_ptr<bench::GemmBenchmark>(new MatmulKernelBenchmark("matmul_v3"));
+  }
+
+  std::unique_ptr<bench::GemmBenchmark> CreateMatmulV3FP16Storage() {
+    return std::unique_ptr<bench::GemmBenchmark>(
+      new PrecisionBenchmark<cl_half>(GemmPrecision::kFP16Storage));
+  }
+
+  std::unique_ptr<bench::GemmBenchmark> CreateMatmulV3FP16() {
+    return std::unique_ptr<bench::GemmBenchmark>(new PrecisionBenchmark<cl_half>(GemmPrecision::kFP16));
+  }
+
+  std::unique_ptr<bench::GemmBenchmark> CreateMatmulV3FP64() {
+    return std::unique_ptr<bench::GemmBenchmark>(new PrecisionBenchmark<cl_double>(GemmPrecision::kFP64));
+  }
+
+} // namespace
+
+REGISTER_GEMM_BENCHMARK("naive", CreateNaive);
+REGISTER_GEMM_BENCHMARK("cpu", CreateCpu);
+REGISTER_GEMM_BENCHMARK("matmul_v1", CreateMatmulV1);
+REGISTER_GEMM_BENCHMARK("matmul_v2", CreateMatmulV2);
+REGISTER_GEMM_BENCHMARK("matmul_v3", CreateMatmulV3);
+REGISTER_GEMM_BENCHMARK("matmul_v3_fp16acc32", CreateMatmulV3FP16Storage);
+REGISTER_GEMM_BENCHMARK("matmul_v3_fp16", CreateMatmulV3FP16);
+REGISTER_GEMM_BENCHMARK("matmul_v3_fp64", CreateMatmulV3FP64);
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+
+using namespace ocl;
+
+
+typedef TypedKernel<int, int, int, Buffer<float>, Buffer<float>, Buffer<float>> MatmulKernel;
+
+// Host time per launch of 'num_launches' calls of 'launch', which enqueues
+// one kernel; the device work is waited for outside of the timed region
+template <typename Function>
+double HostSecondsPerLaunch(CommandQueue& queue, size_t num_launches, Function launch) {
+  launch();
+  queue.Finish();
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t n = 0; n < num_launches; n++) {
+    launch();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  queue.Finish();
+  return std::chrono::duration<double>(end - start).count() / num_launches;
+}
+
+void PrintOverhead(const std::string& title, double seconds, double baseline) {
+  std::cout << std::left << std::setw(36) << title
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << seconds * 1e6
+            << std::setprecision(2)
+            << std::setw(10) << baseline / seconds << "x"
+            << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <kernel dir> [launches]" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+  const size_t num_launches = argc > 2 ? std::stoul(argv[2]) : 10000;
+
+  // A launch small enough for the host side to dominate
+  const int M = 16, N = 16, K = 16;
+  const size_t global_work_size[2] = { static_cast<size_t>(M), static_cast<size_t>(N) };
+
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
+  Context context(device);
+  CommandQueue queue(context, device);
+
+  // Argument info lets TypedKernel check the types, not only their number
+  Program program(context, utils::ReadKernelFileFromDisk(kernel_dir + "/matmul.cl"));
+  program.Build(device, { "-cl-kernel-arg-info" });
+
+  std::vector<float> zeros(static_cast<size_t>(M) * N, 0.0f);
+  Buffer<float> lhs(context, zeros.size());
+  Buffer<float> rhs(context, zeros.size());
+  Buffer<float> result(context, zeros.size());
+  Buffer<float> other_result(context, zeros.size());
+  lhs.CopyFromHost(queue, zeros.data(), zeros.size());
+  rhs.CopyFromHost(queue, zeros.data(), zeros.size());
+
+  Kernel kernel(program, "matmul_v1");
+  MatmulKernel typed_kernel(program, "matmul_v1");
+  std::cout << "kernel: " << typed_kernel.Name() << ", argument types "
+            << (typed_kernel.ArgInfoChecked() ? "checked" : "not reported by the driver")
+            << std::endl << std::endl;
+
+  std::cout << std::left << std::setw(36) << "launch"
+            << std::right << std::setw(12) << "host(us)"
+            << std::setw(11) << "speedup" << std::endl;
+
+  // Before: every argument is set on every launch
+  const double baseline = HostSecondsPerLaunch(queue, num_launches, [&] {
+    int m = M, n = N, k = K;
+    kernel.SetArguments(m, n, k, lhs, rhs, result);
+    kernel.Run(queue, 2, nullptr, global_work_size, nullptr);
+  });
+  PrintOverhead("Kernel::SetArguments + Run", baseline, baseline);
+
+  // No argument changes: no clSetKernelArg at all
+  double seconds = HostSecondsPerLaunch(queue, num_launches, [&] {
+    typed_kernel(queue, 2, global_work_size, nullptr, M, N, K, lhs, rhs, result);
+  });
+  PrintOverhead("TypedKernel, same arguments", seconds, baseline);
+
+  // One buffer alternates: one clSetKernelArg per launch
+  size_t n = 0;
+  seconds = HostSecondsPerLaunch(queue, num_launches, [&] {
+    typed_kernel(queue, 2, global_work_size, nullptr, M, N, K, lhs, rhs, (n++ % 2) ? other_result : result);
+  });
+  PrintOverhead("TypedKernel, result alternating", seconds, baseline);
+
+  std::cout << std::endl << "clSetKernelArg calls: " << typed_kernel.NumArgumentsSet()
+            << ", skipped: " << typed_kernel.NumArgumentsSkipped() << std::endl;
+  return 0;
+}
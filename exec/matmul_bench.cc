@@ -0,0 +1,156 @@
+#include <iostream>
+#include <chrono>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_cpu.hpp"
+#include "benchmark.hpp"
+
+using namespace ocl;
+
+
+void PrintUsage(const char* program_name) {
+  std::cerr << "Usage: " << program_name << " <kernel dir> [options]\n"
+            << "  --shapes MxNxK[,MxNxK...]  problem sizes (default 1024x1024x8,256x256x256,512x512x512,131x77x259)\n"
+            << "  --warmup N                 untimed runs per benchmark (default 1)\n"
+            << "  --repeats N                timed runs per benchmark (default 10)\n"
+            << "  --filter NAME              only run benchmarks whose name contains NAME\n"
+            << "  --platform I --device J    OpenCL device to use (default: fastest)\n"
+            << "  --json PATH                write the results as JSON\n"
+            << "  --csv PATH                 write the results as CSV\n";
+}
+
+// Deterministic operands, same as matmul_test
+void InitOperands(const bench::Shape& shape, Matrix& lhs, Matrix& rhs) {
+  lhs = Matrix(shape.M, shape.K);
+  for (int m = 0; m < shape.M; m++) {
+    for (int k = 0; k < shape.K; k++) {
+      lhs(m, k) = (m + 1) * (k + 1) / static_cast<float>(shape.M);
+    }
+  }
+
+  rhs = Matrix(shape.K, shape.N);
+  for (int k = 0; k < shape.K; k++) {
+    for (int n = 0; n < shape.N; n++) {
+      rhs(k, n) = (k + 1) * (n + 1) / static_cast<float>(shape.M);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::string kernel_dir = argv[1];
+  std::vector<bench::Shape> shapes = bench::ParseShapes("1024x1024x8,256x256x256,512x512x512,131x77x259");
+  size_t num_warmups = 1, num_repeats = 10;
+  size_t platform_id = 0, device_id = 0;
+  bool explicit_device = false;
+  std::string filter, json_path, csv_path;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--shapes") { shapes = bench::ParseShapes(value); }
+    else if (arg == "--warmup") { num_warmups = std::stoul(value); }
+    else if (arg == "--repeats") { num_repeats = std::stoul(value); }
+    else if (arg == "--filter") { filter = value; }
+    else if (arg == "--platform") { platform_id = std::stoul(value); explicit_device = true; }
+    else if (arg == "--device") { device_id = std::stoul(value); explicit_device = true; }
+    else if (arg == "--json") { json_path = value; }
+    else if (arg == "--csv") { csv_path = value; }
+    else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  // The given platform / device, otherwise the fastest one
+  Device device;
+  if (explicit_device) {
+    std::vector<Platform> all_platforms = GetAllPlatforms();
+    if (platform_id >= all_platforms.size()) {
+      std::cerr << "Invalid platform " << platform_id << std::endl;
+      return 1;
+    }
+    device = Device(all_platforms[platform_id], device_id);
+  } else {
+    device = SelectDevice(DeviceCriteria::FromEnvironment());
+  }
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  bench::Environment env(
+    device,
+    kernel_dir,
+    cache_dir != nullptr ? cache_dir : ".ocl_program_cache",
+    tuning_db != nullptr ? tuning_db : "matmul_tuning.db"
+  );
+  std::cout << "Device: " << device.Name() << " (" << device.DriverVersion() << ")" << std::endl;
+
+  std::vector<bench::Result> results;
+  for (const auto& shape : shapes) {
+    Matrix lhs, rhs;
+    InitOperands(shape, lhs, rhs);
+    Matrix reference(shape.M, shape.N);
+    matmul_cpu(lhs, rhs, reference);
+    // Device results are compared with this copy without reading them back
+    Buffer<float> device_reference(env.context, reference.NumElmts());
+    device_reference.CopyFromHost(env.queue, reference.RawPtr(), reference.NumElmts());
+
+    for (const auto& entry : bench::Registry::Instance().Entries()) {
+      if (!filter.empty() && entry.first.find(filter) == std::string::npos) {
+        continue;
+      }
+
+      std::unique_ptr<bench::GemmBenchmark> benchmark = entry.second();
+      try {
+        if (!benchmark->Setup(env, lhs, rhs)) {
+          continue;
+        }
+        for (size_t n = 0; n < num_warmups; n++) {
+          benchmark->Run(env);
+        }
+        std::vector<double> seconds;
+        for (size_t n = 0; n < num_repeats; n++) {
+          seconds.push_back(benchmark->Run(env));
+        }
+
+        double error = 0.0;
+        const Buffer<float>* device_result = benchmark->DeviceResult();
+        if (device_result != nullptr) {
+          error = env.Primitives().Compare(
+            env.queue, reference.NumElmts(), *device_result, device_reference
+          ).mean_abs_error;
+        } else {
+          Matrix result;
+          benchmark->GetResult(env, result);
+          error = bench::MeanAbsError(result, reference);
+        }
+        results.push_back(
+          bench::Summarize(entry.first, shape, seconds, error, benchmark->ElementBytes())
+        );
+      } catch (const std::runtime_error& e) {
+        std::cerr << entry.first << " " << bench::ShapeString(shape)
+                  << " skipped: " << e.what() << std::endl;
+      }
+    }
+  }
+
+  bench::PrintTable(std::cout, results);
+  env.program_cache.PrintStats(std::cout);
+  env.memory_pool.PrintStats(std::cout);
+  if (!json_path.empty()) {
+    bench::WriteJson(json_path, device.Name(), device.DriverVersion(), results);
+  }
+  if (!csv_path.empty()) {
+    bench::WriteCsv(csv_path, results);
+  }
+  return 0;
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define MATMUL_CPU_X86
+#endif
+
+#include "ocl/aligned_allocator.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+
+namespace cpu {
+
+  /// @brief Register-blocked kernel computing C += A * B for an MR x NR tile
+  /// of a column-major C (leading dimension ldc) from packed panels: A holds
+  /// MR rows per k, B holds NR columns per k.
+  struct MicroKernel {
+    const char* name;
+    int mr;
+    int nr;
+    void (*run)(int kc, const float* a, const float* b, float* c, int ldc);
+  };
+
+  // Cache blocking: a KC x NC panel of B stays in L2/L3 while MC x KC
+  // blocks of A stream through L2 and a KC x NR sliver of B sits in L1
+  constexpr int kBlockM = 128;
+  constexpr int kBlockN = 4096;
+  constexpr int kBlockK = 256;
+
+  inline void KernelScalar(int kc, const float* a, const float* b, float* c, int ldc) {
+    constexpr int MR = 8, NR = 4;
+    float acc[NR][MR] = {};
+    for (int k = 0; k < kc; k++) {
+      for (int j = 0; j < NR; j++) {
+        for (int i = 0; i < MR; i++) {
+          acc[j][i] += a[i] * b[j];
+        }
+      }
+      a += MR;
+      b += NR;
+    }
+    for (int j = 0; j < NR; j++) {
+      for (int i = 0; i < MR; i++) {
+        c[i + j * ldc] += acc[j][i];
+      }
+    }
+  }
+
+#ifdef MATMUL_CPU_X86
+  // 16 x 6 tile: two 8-wide columns of A times 6 broadcasts of B
+  __attribute__((target("avx2,fma")))
+  inline void KernelAvx2(int kc, const float* a, const float* b, float* c, int ldc) {
+    constexpr int NR = 6;
+    __m256 acc[NR][2];
+    for (int j = 0; j < NR; j++) {
+      acc[j][0] = _mm256_setzero_ps();
+      acc[j][1] = _mm256_setzero_ps();
+    }
+    for (int k = 0; k < kc; k++) {
+      const __m256 a0 = _mm256_loadu_ps(a);
+      const __m256 a1 = _mm256_loadu_ps(a + 8);
+      for (int j = 0; j < NR; j++) {
+        const __m256 bj = _mm256_broadcast_ss(b + j);
+        acc[j][0] = _mm256_fmadd_ps(a0, bj, acc[j][0]);
+        acc[j][1] = _mm256_fmadd_ps(a1, bj, acc[j][1]);
+      }
+      a += 16;
+      b += NR;
+    }
+    for (int j = 0; j < NR; j++) {
+      float* column = c + j * ldc;
+      _mm256_storeu_ps(column, _mm256_add_ps(_mm256_loadu_ps(column), acc[j][0]));
+      _mm256_storeu_ps(column + 8, _mm256_add_ps(_mm256_loadu_ps(column + 8), acc[j][1]));
+    }
+  }
+
+  // 32 x 8 tile: two 16-wide columns of A times 8 broadcasts of B
+  __attribute__((target("avx512f")))
+  inline void KernelAvx512(int kc, const float* a, const float* b, float* c, int ldc) {
+    constexpr int NR = 8;
+    __m512 acc[NR][2];
+    for (int j = 0; j < NR; j++) {
+      acc[j][0] = _mm512_setzero_ps();
+      acc[j][1] = _mm512_setzero_ps();
+    }
+    for (int k = 0; k < kc; k++) {
+      const __m512 a0 = _mm512_loadu_ps(a);
+      const __m512 a1 = _mm512_loadu_ps(a + 16);
+      for (int j = 0; j < NR; j++) {
+        const __m512 bj = _mm512_set1_ps(b[j]);
+        acc[j][0] = _mm512_fmadd_ps(a0, bj, acc[j][0]);
+        acc[j][1] = _mm512_fmadd_ps(a1, bj, acc[j][1]);
+      }
+      a += 32;
+      b += NR;
+    }
+    for (int j = 0; j < NR; j++) {
+      float* column = c + j * ldc;
+      _mm512_storeu_ps(column, _mm512_add_ps(_mm512_loadu_ps(column), acc[j][0]));
+      _mm512_storeu_ps(column + 16, _mm512_add_ps(_mm512_loadu_ps(column + 16), acc[j][1]));
+    }
+  }
+#endif
+
+  /// @brief Micro-kernels this CPU can run, widest first
+  inline std::vector<const MicroKernel*> SupportedKernels() {
+    static const MicroKernel scalar = { "scalar", 8, 4, KernelScalar };
+    std::vector<const MicroKernel*> kernels;
+#ifdef MATMUL_CPU_X86
+    static const MicroKernel avx2 = { "avx2", 16, 6, KernelAvx2 };
+    static const MicroKernel avx512 = { "avx512", 32, 8, KernelAvx512 };
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      kernels.push_back(&avx512);
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      kernels.push_back(&avx2);
+    }
+#endif
+    kernels.push_back(&scalar);
+    return kernels;
+  }
+
+  /// @brief Widest micro-kernel the CPU supports. The CPU_GEMM_ISA
+  /// environment variable ('scalar', 'avx2' or 'avx512') caps the choice.
+  inline const MicroKernel& SelectKernel() {
+    static const MicroKernel& selected = []() -> const MicroKernel& {
+      const char* env = getenv("CPU_GEMM_ISA");
+      const std::string cap = env != nullptr ? env : "avx512";
+      for (const MicroKernel* kernel : SupportedKernels()) {
+        const std::string name = kernel->name;
+        if (name == "scalar" || (name == "avx2" && cap != "scalar") || cap == name) {
+          return *kernel;
+        }
+      }
+      return *SupportedKernels().back();
+    }();
+    return selected;
+  }
+
+  /// @brief Strided read-only view of a Matrix: element (i, j) is at
+  /// data[i * row_stride + j * col_stride]
+  struct View {
+    explicit View(const Matrix& matrix)
+      : data(matrix.RawPtr()),
+        row_stride(matrix.Layout() == MatrixLayout::kColMajor ? 1 : matrix.Cols()),
+        col_stride(matrix.Layout() == MatrixLayout::kColMajor ? matrix.Rows() : 1) {}
+
+    const float* data;
+    size_t row_stride;
+    size_t col_stride;
+
+    float operator() (size_t i, size_t j) const { return data[i * row_stride + j * col_stride]; }
+  };
+
+  typedef std::vector<float, ocl::AlignedAllocator<float, 64>> PackBuffer;
+
+  // Pack rows [i0, i0 + mc) x cols [k0, k0 + kc) of A into MR-row panels,
+  // zero-padding the last panel
+  inline void PackA(const View& a, int i0, int mc, int k0, int kc, int mr, float* packed) {
+    for (int p = 0; p < mc; p += mr) {
+      const int rows = std::min(mr, mc - p);
+      for (int k = 0; k < kc; k++) {
+        for (int r = 0; r < rows; r++) {
+          packed[r] = a(i0 + p + r, k0 + k);
+        }
+        for (int r = rows; r < mr; r++) {
+          packed[r] = 0.0f;
+        }
+        packed += mr;
+      }
+    }
+  }
+
+  // Pack the NR-column panel starting at (k0, j0) of B, zero-padding
+  // columns past j0 + cols
+  inline void PackBPanel(const View& b, int k0, int kc, int j0, int cols, int nr, float* packed) {
+    for (int k = 0; k < kc; k++) {
+      for (int c = 0; c < cols; c++) {
+        packed[c] = b(k0 + k, j0 + c);
+      }
+      for (int c = cols; c < nr; c++) {
+        packed[c] = 0.0f;
+      }
+      packed += nr;
+    }
+  }
+
+} // namespace cpu
+
+
+/// @brief Host GEMM: result = lhs * rhs.
+///
+/// Packs panels of both operands, blocks them for the caches and runs the
+/// given SIMD micro-kernel, spreading blocks of rows and columns
+/// of the result over the threads of 'pool'. Any MatrixLayout is accepted
+/// for the three matrices; 'result' must already be M x N.
+inline void matmul_cpu(const Matrix& lhs,
+                       const Matrix& rhs,
+                       Matrix& result,
+                       const cpu::MicroKernel& kernel,
+                       ThreadPool& pool=ThreadPool::Default()) {
+  const int M = lhs.Rows();
+  const int N = rhs.Cols();
+  const int K = lhs.Cols();
+  const int MR = kernel.mr;
+  const int NR = kernel.nr;
+
+  std::fill(result.RawPtr(), result.RawPtr() + result.NumElmts(), 0.0f);
+  if (M == 0 || N == 0 || K == 0) {
+    return;
+  }
+
+  const cpu::View a(lhs);
+  const cpu::View b(rhs);
+  const bool col_major_result = result.Layout() == MatrixLayout::kColMajor;
+
+  const int num_blocks_m = (M + cpu::kBlockM - 1) / cpu::kBlockM;
+  std::vector<cpu::PackBuffer> packed_a(pool.NumThreads(), cpu::PackBuffer(cpu::kBlockM * cpu::kBlockK));
+  cpu::PackBuffer packed_b(static_cast<size_t>(cpu::kBlockK) * ((cpu::kBlockN + NR - 1) / NR * NR));
+
+  for (int jc = 0; jc < N; jc += cpu::kBlockN) {
+    const int nc = std::min(cpu::kBlockN, N - jc);
+    const int num_panels_n = (nc + NR - 1) / NR;
+
+    // Give every thread work even when M is small by also splitting the
+    // column panels
+    const int num_chunks_n = std::max(1, std::min(
+      num_panels_n,
+      static_cast<int>((pool.NumThreads() + num_blocks_m - 1) / num_blocks_m)
+    ));
+    const int panels_per_chunk = (num_panels_n + num_chunks_n - 1) / num_chunks_n;
+
+    for (int pc = 0; pc < K; pc += cpu::kBlockK) {
+      const int kc = std::min(cpu::kBlockK, K - pc);
+
+      pool.ParallelFor(num_panels_n, [&](size_t q, size_t) {
+        const int j0 = static_cast<int>(q) * NR;
+        cpu::PackBPanel(b, pc, kc, jc + j0, std::min(NR, nc - j0), NR, &packed_b[q * kc * NR]);
+      });
+
+      pool.ParallelFor(num_blocks_m * num_chunks_n, [&](size_t task, size_t thread_id) {
+        const int ic = static_cast<int>(task / num_chunks_n) * cpu::kBlockM;
+        const int mc = std::min(cpu::kBlockM, M - ic);
+        float* block_a = packed_a[thread_id].data();
+        cpu::PackA(a, ic, mc, pc, kc, MR, block_a);
+
+        const int first_panel = static_cast<int>(task % num_chunks_n) * panels_per_chunk;
+        const int last_panel = std::min(num_panels_n, first_panel + panels_per_chunk);
+        float tile[32 * 8];
+        for (int q = first_panel; q < last_panel; q++) {
+          const int jr = q * NR;
+          const int nr = std::min(NR, nc - jr);
+          const float* panel_b = &packed_b[static_cast<size_t>(q) * kc * NR];
+
+          for (int ir = 0; ir < mc; ir += MR) {
+            const int mr = std::min(MR, mc - ir);
+            const float* panel_a = block_a + static_cast<size_t>(ir) * kc;
+            const int row = ic + ir;
+            const int col = jc + jr;
+
+            if (col_major_result && mr == MR && nr == NR) {
+              kernel.run(kc, panel_a, panel_b, result.RawPtr() + row + static_cast<size_t>(col) * M, M);
+              continue;
+            }
+            // Edge tiles and row-major results go through a scratch tile
+            std::fill(tile, tile + MR * NR, 0.0f);
+            kernel.run(kc, panel_a, panel_b, tile, MR);
+            for (int j = 0; j < nr; j++) {
+              for (int i = 0; i < mr; i++) {
+                result(row + i, col + j) += tile[i + j * MR];
+              }
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+/// @brief matmul_cpu with the widest micro-kernel of this CPU
+inline void matmul_cpu(const Matrix& lhs,
+                       const Matrix& rhs,
+                       Matrix& result,
+                       ThreadPool& pool=ThreadPool::Default()) {
+  matmul_cpu(lhs, rhs, result, cpu::SelectKernel(), pool);
+}
+
+/// @brief Name of the micro-kernel matmul_cpu runs on this CPU
+inline std::string matmul_cpu_isa() {
+  return cpu::SelectKernel().name;
+}
@@ -0,0 +1,103 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matrix_file.hpp"
+#include "matmul_cpu.hpp"
+#include "matmul_tuner.hpp"
+
+using namespace ocl;
+
+
+/// Write a random M x N matrix file at 'path' unless it already exists
+void CreateIfMissing(const std::string& path, int rows, int cols, unsigned seed) {
+  if (access(path.c_str(), F_OK) == 0) {
+    return;
+  }
+  Matrix matrix(rows, cols);
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  for (size_t i = 0; i < matrix.NumElmts(); i++) {
+    matrix.RawPtr()[i] = distribution(generator);
+  }
+  MatrixFile::Write(path, matrix);
+  std::cout << "wrote " << path << " (" << rows << "x" << cols << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " <kernel dir> <lhs file> <rhs file> <result file> [M] [N] [K]" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+  const std::string lhs_path = argv[2], rhs_path = argv[3], result_path = argv[4];
+  // Missing operand files are created with random elements of these shapes
+  const int M = argc > 5 ? std::stoi(argv[5]) : 2048;
+  const int N = argc > 6 ? std::stoi(argv[6]) : 2048;
+  const int K = argc > 7 ? std::stoi(argv[7]) : 2048;
+  CreateIfMissing(lhs_path, M, K, 1);
+  CreateIfMissing(rhs_path, K, N, 2);
+
+  MatrixFile lhs_file(lhs_path), rhs_file(rhs_path);
+  if (lhs_file.Layout() != MatrixLayout::kColMajor || rhs_file.Layout() != MatrixLayout::kColMajor) {
+    std::cerr << "The operands must be column-major." << std::endl;
+    return 1;
+  }
+  if (lhs_file.Cols() != rhs_file.Rows()) {
+    std::cerr << "The shapes of the operands do not match." << std::endl;
+    return 1;
+  }
+  int m = lhs_file.Rows(), n = rhs_file.Cols(), k = lhs_file.Cols();
+
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
+  Context context(device);
+  CommandQueue queue(context, device);
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  KernelVariants variants(
+    device, context, utils::ReadKernelFileFromDisk(kernel_dir + "/matmul.cl"), {}, &program_cache
+  );
+  MatmulTuner tuner(device, context, queue, variants, tuning_db != nullptr ? tuning_db : "matmul_tuning.db");
+  const MatmulConfig config = tuner.Get("matmul_v3", m, n, k);
+  Kernel kernel = variants.Get("matmul_v3", config.Params());
+
+  // Operands go from the page cache to the device in chunks
+  Buffer<float> device_lhs(context, lhs_file.NumElmts());
+  Buffer<float> device_rhs(context, rhs_file.NumElmts());
+  Buffer<float> device_result(context, static_cast<size_t>(m) * n);
+  auto start = std::chrono::steady_clock::now();
+  lhs_file.Upload(queue, device_lhs);
+  rhs_file.Upload(queue, device_rhs).Wait();
+  std::chrono::duration<double> upload_time = std::chrono::steady_clock::now() - start;
+  std::cout << "Device: " << device.Name() << ", uploaded "
+            << static_cast<double>(lhs_file.DataBytes() + rhs_file.DataBytes()) / (1 << 20)
+            << " MiB in " << upload_time.count() * 1e3 << " ms" << std::endl;
+
+  kernel.SetArguments(m, n, k, device_lhs, device_rhs, device_result);
+  size_t global_work_size[2];
+  config.GlobalWorkSize(m, n, global_work_size);
+  Event event = kernel.Run(queue, 2, nullptr, global_work_size, config.local_work_size);
+  event.Wait();
+  std::cout << "kernel: " << event.Duration() * 1e3 << " ms" << std::endl;
+
+  Matrix result(m, n);
+  device_result.CopyFromDevice(queue, result.RawPtr(), result.NumElmts());
+  MatrixFile::Write(result_path, result);
+
+  // Check against the CPU on the zero-copy views of the operands
+  Matrix reference(m, n);
+  matmul_cpu(lhs_file.AsMatrix(), rhs_file.AsMatrix(), reference);
+  double err = 0.0;
+  const Matrix written = MatrixFile(result_path).AsMatrix();
+  for (size_t i = 0; i < reference.NumElmts(); i++) {
+    err += std::abs(written.RawPtr()[i] - reference.RawPtr()[i]);
+  }
+  std::cout << "err.: " << err / reference.NumElmts() << std::endl;
+  return 0;
+}
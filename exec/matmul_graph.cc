@@ -0,0 +1,84 @@
+#include <iostream>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_cpu.hpp"
+#include "matmul_tuner.hpp"
+
+using namespace ocl;
+
+
+// X = (A * B) * (C * D): the two inner products are independent and may run
+// concurrently, the outer one waits for both
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <matmul.cl> [size]" << std::endl;
+    return 1;
+  }
+  const int S = argc > 2 ? std::stoi(argv[2]) : 512;
+
+  std::vector<Matrix> inputs(4, Matrix(S, S));
+  for (size_t m = 0; m < inputs.size(); m++) {
+    for (size_t i = 0; i < inputs[m].NumElmts(); i++) {
+      inputs[m].RawPtr()[i] = static_cast<float>(static_cast<int>((i + m) % 7) - 3) / S;
+    }
+  }
+  Matrix ab(S, S), cd(S, S), reference(S, S), result(S, S);
+  matmul_cpu(inputs[0], inputs[1], ab);
+  matmul_cpu(inputs[2], inputs[3], cd);
+  matmul_cpu(ab, cd, reference);
+
+  std::string source = utils::ReadKernelFileFromDisk(argv[1]);
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
+  Context context(device);
+  CommandQueue queue(context, device);
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  KernelVariants variants(device, context, source, {}, &program_cache);
+  MatmulTuner tuner(device, context, queue, variants, tuning_db != nullptr ? tuning_db : "matmul_tuning.db");
+  MatmulConfig config = tuner.Get("matmul_v3", S, S, S);
+  Kernel kernel = variants.Get(config.kernel_name, config.Params());
+
+  std::vector<Buffer<float>> a;
+  for (size_t m = 0; m < inputs.size(); m++) {
+    a.emplace_back(context, S * S);
+  }
+  Buffer<float> device_ab(context, S * S), device_cd(context, S * S), device_x(context, S * S);
+
+  size_t global[2];
+  config.GlobalWorkSize(S, S, global);
+  const std::vector<size_t> global_work_size = { global[0], global[1] };
+  const std::vector<size_t> local_work_size = { config.local_work_size[0], config.local_work_size[1] };
+  auto matmul = [&](Buffer<float>& lhs, Buffer<float>& rhs, Buffer<float>& out) {
+    return [&lhs, &rhs, &out, S](Kernel& kernel) {
+      int M = S, N = S, K = S;
+      kernel.SetArguments(M, N, K, lhs(), rhs(), out());
+    };
+  };
+
+  TaskGraph graph(context, device);
+  const char* names[] = { "write A", "write B", "write C", "write D" };
+  for (size_t m = 0; m < inputs.size(); m++) {
+    graph.AddWrite(names[m], a[m], inputs[m].RawPtr(), inputs[m].NumElmts());
+  }
+  graph.AddKernel("A*B", kernel, global_work_size, local_work_size,
+                  { a[0](), a[1]() }, { device_ab() }, matmul(a[0], a[1], device_ab));
+  graph.AddKernel("C*D", kernel, global_work_size, local_work_size,
+                  { a[2](), a[3]() }, { device_cd() }, matmul(a[2], a[3], device_cd));
+  graph.AddKernel("AB*CD", kernel, global_work_size, local_work_size,
+                  { device_ab(), device_cd() }, { device_x() }, matmul(device_ab, device_cd, device_x));
+  graph.AddRead("read X", device_x, result.RawPtr(), result.NumElmts());
+
+  TaskGraphStats stats = graph.Run();
+  graph.PrintStats(std::cout, stats);
+
+  float err = 0.0f;
+  for (size_t i = 0; i < reference.NumElmts(); i++) {
+    err += std::abs(result.RawPtr()[i] - reference.RawPtr()[i]);
+  }
+  std::cout << "err.: " << err / reference.NumElmts() << std::endl;
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <chrono>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_cpu.hpp"
+#include "multi_device_gemm.hpp"
+
+using namespace ocl;
+
+
+// Wall time of each of 'num_repeats' runs, checking the last one
+double TimeRuns(MultiDeviceGemm& gemm,
+                const Matrix& lhs,
+                const Matrix& rhs,
+                const Matrix& reference,
+                size_t num_repeats,
+                bool print_shares) {
+  Matrix result(lhs.Rows(), rhs.Cols());
+  double best = 0.0;
+  for (size_t n = 0; n < num_repeats; n++) {
+    auto start = std::chrono::steady_clock::now();
+    gemm.Run(lhs, rhs, result);
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+    best = n == 0 ? diff.count() : std::min(best, diff.count());
+    if (print_shares) {
+      std::cout << "run " << n << ": " << diff.count() * 1e3 << " ms" << std::endl;
+      gemm.PrintShares(std::cout);
+    }
+  }
+
+  float err = 0.0f;
+  for (size_t i = 0; i < reference.NumElmts(); i++) {
+    err += std::abs(result.RawPtr()[i] - reference.RawPtr()[i]);
+  }
+  std::cout << "err.: " << err / reference.NumElmts() << std::endl;
+  return best;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <matmul.cl> [M] [N] [K] [repeats] [device type]" << std::endl;
+    return 1;
+  }
+  const int M = argc > 2 ? std::stoi(argv[2]) : 1024;
+  const int N = argc > 3 ? std::stoi(argv[3]) : 1024;
+  const int K = argc > 4 ? std::stoi(argv[4]) : 512;
+  const size_t num_repeats = argc > 5 ? std::stoul(argv[5]) : 5;
+  const std::string device_type = argc > 6 ? argv[6] : "";
+
+  Matrix lhs(M, K), rhs(K, N), reference(M, N);
+  for (size_t i = 0; i < lhs.NumElmts(); i++) {
+    lhs.RawPtr()[i] = (static_cast<int>(i % 7) - 3) / 4.0f;
+  }
+  for (size_t i = 0; i < rhs.NumElmts(); i++) {
+    rhs.RawPtr()[i] = (static_cast<int>(i % 5) - 2) / 4.0f;
+  }
+  matmul_cpu(lhs, rhs, reference);
+
+  // Every device, or only those of one type (e.g. 'CPU'), fastest first
+  std::vector<Device> devices;
+  for (const auto& device : SelectDevices()) {
+    if (device_type.empty() || device.Type() == device_type) {
+      devices.push_back(device);
+    }
+  }
+  if (devices.empty()) {
+    std::cerr << "No OpenCL device" << (device_type.empty() ? "" : " of type " + device_type) << std::endl;
+    return 1;
+  }
+
+  std::string source = utils::ReadKernelFileFromDisk(argv[1]);
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  const std::string db_path = tuning_db != nullptr ? tuning_db : "matmul_tuning.db";
+
+  std::cout << "<<< " << devices.size() << " device(s) >>>" << std::endl;
+  MultiDeviceGemm multi(devices, source, &program_cache, db_path);
+  const double multi_seconds = TimeRuns(multi, lhs, rhs, reference, num_repeats, true);
+  std::cout << std::endl;
+
+  std::cout << "<<< " << devices[0].Name() << " alone >>>" << std::endl;
+  MultiDeviceGemm single({ devices[0] }, source, &program_cache, db_path);
+  const double single_seconds = TimeRuns(single, lhs, rhs, reference, num_repeats, false);
+  std::cout << std::endl;
+
+  std::cout << "best: " << multi_seconds * 1e3 << " ms on all devices, "
+            << single_seconds * 1e3 << " ms on one, speedup "
+            << single_seconds / multi_seconds << std::endl;
+  return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "matrix.hpp"
+
+
+/// Reference matrix multiplication: result = lhs * rhs
+inline void matmul_naive(const Matrix& lhs, const Matrix& rhs, Matrix& result) {
+  int M = lhs.Rows();
+  int N = rhs.Cols();
+  int K = lhs.Cols();
+
+  for (int m = 0; m < M; m++) {
+    for (int n = 0; n < N; n++) {
+      float acc = 0;
+      for (int k = 0; k < K; k++) {
+        acc += lhs(m, k) * rhs(k, n);
+      }
+      result(m, n) = acc;
+    }
+  }
+}
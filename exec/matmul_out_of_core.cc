@@ -0,0 +1,69 @@
+#include <iostream>
+#include <random>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_cpu.hpp"
+#include "matmul_tuner.hpp"
+#include "out_of_core_gemm.hpp"
+
+using namespace ocl;
+
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <kernel dir> [M] [N] [K] [device budget MiB]" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+  const int M = argc > 2 ? std::stoi(argv[2]) : 4096;
+  const int N = argc > 3 ? std::stoi(argv[3]) : 4096;
+  const int K = argc > 4 ? std::stoi(argv[4]) : 4096;
+  // Small by default, so the operands do not fit on any device
+  const size_t budget = (argc > 5 ? std::stoul(argv[5]) : 64) << 20;
+
+  Matrix lhs(M, K), rhs(K, N), result;
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  for (size_t i = 0; i < lhs.NumElmts(); i++) {
+    lhs.RawPtr()[i] = distribution(generator);
+  }
+  for (size_t i = 0; i < rhs.NumElmts(); i++) {
+    rhs.RawPtr()[i] = distribution(generator);
+  }
+
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
+  Context context(device);
+  CommandQueue queue(context, device);
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  KernelVariants variants(
+    device, context, utils::ReadKernelFileFromDisk(kernel_dir + "/matmul.cl"), {}, &program_cache
+  );
+  MatmulTuner tuner(device, context, queue, variants, tuning_db != nullptr ? tuning_db : "matmul_tuning.db");
+
+  OutOfCoreGemm gemm(device, context, variants, tuner, budget);
+  std::cout << "Device: " << device.Name() << ", operands "
+            << (static_cast<double>(M) * K + static_cast<double>(K) * N) * sizeof(float) / (1 << 20)
+            << " MiB, budget " << (budget >> 20) << " MiB, tile " << gemm.TileSize() << std::endl;
+
+  // The first call is a warmup; time the second
+  gemm.Multiply(lhs, rhs, result);
+  gemm.Multiply(lhs, rhs, result);
+  const double seconds = gemm.Stats().seconds;
+  std::cout << "time: " << seconds * 1e3 << " ms, "
+            << 2.0 * M * N * K / seconds * 1e-9 << " GFLOP/s" << std::endl;
+  gemm.Stats().Print(std::cout);
+
+  Matrix reference(M, N);
+  matmul_cpu(lhs, rhs, reference);
+  double err = 0.0;
+  for (size_t i = 0; i < reference.NumElmts(); i++) {
+    err += std::abs(result.RawPtr()[i] - reference.RawPtr()[i]);
+  }
+  std::cout << "err.: " << err / reference.NumElmts() << std::endl;
+  return 0;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+
+#include "ocl/ocl.h"
+#include "matrix.hpp"
+#include "matmul_tuner.hpp"
+
+
+/// @brief Counters of a MatmulPipeline
+struct PipelineStats {
+  size_t num_batches = 0;
+  double wall_seconds = 0.0;     // host time from the first submit to the last drain
+  double device_seconds = 0.0;   // first upload start to last download end
+  double upload_seconds = 0.0;   // busy time of each stage
+  double compute_seconds = 0.0;
+  double download_seconds = 0.0;
+
+  double Throughput() const { return wall_seconds > 0.0 ? num_batches / wall_seconds : 0.0; }
+
+  // Fraction of the device span each stage was busy
+  double UploadOccupancy() const { return Fraction(upload_seconds); }
+  double ComputeOccupancy() const { return Fraction(compute_seconds); }
+  double DownloadOccupancy() const { return Fraction(download_seconds); }
+
+  /// @brief Sum of the stage busy times over the device span: 1 when the
+  /// stages run back to back, up to 3 when they fully overlap
+  double Overlap() const {
+    return Fraction(upload_seconds + compute_seconds + download_seconds);
+  }
+
+  void Print(std::ostream& os) const {
+    os << "batches: " << num_batches
+       << ", throughput: " << Throughput() << " batches/s" << std::endl;
+    os << "occupancy: upload " << UploadOccupancy()
+       << ", compute " << ComputeOccupancy()
+       << ", download " << DownloadOccupancy()
+       << ", overlap " << Overlap() << std::endl;
+  }
+
+private:
+  double Fraction(double seconds) const {
+    return device_seconds > 0.0 ? seconds / device_seconds : 0.0;
+  }
+}; // struct PipelineStats
+
+
+/// @brief Streams independent matmuls of one shape through separate upload,
+/// compute and download queues.
+///
+/// 'depth' buffer sets are used round-robin, so with depth 3 batch i+1
+/// uploads while batch i computes and batch i-1 downloads. The stages are
+/// chained with futures; the host only blocks when it reuses a buffer set
+/// whose previous batch has not been downloaded yet.
+class MatmulPipeline {
+public:
+  explicit MatmulPipeline(const ocl::Context& context,
+                          const ocl::Device& device,
+                          const ocl::Kernel& kernel,
+                          const MatmulConfig& config,
+                          int M, int N, int K,
+                          size_t depth=3)
+    : upload_queue_(context, device),
+      compute_queue_(context, device),
+      download_queue_(context, device),
+      kernel_(kernel), config_(config), M_(M), N_(N), K_(K) {
+    slots_.reserve(depth);
+    for (size_t i = 0; i < depth; i++) {
+      slots_.emplace_back(context, M, N, K);
+    }
+  }
+
+  ~MatmulPipeline() {
+    try {
+      Drain();
+    } catch (const std::runtime_error&) {
+    }
+  }
+
+  /// @brief Enqueue result = lhs * rhs. The matrices must stay alive and
+  /// unmodified until the batch has been drained.
+  /// @param on_done Optional continuation, run on a runtime thread once the
+  /// result is on the host (see Future::Then)
+  void Submit(const Matrix& lhs,
+              const Matrix& rhs,
+              Matrix& result,
+              const std::function<void()>& on_done=nullptr) {
+    if (stats_.num_batches == 0) {
+      start_ = std::chrono::steady_clock::now();
+    }
+    Slot& slot = slots_[next_slot_];
+    next_slot_ = (next_slot_ + 1) % slots_.size();
+    Retire(slot);
+
+    slot.upload_lhs = slot.lhs.CopyFromHostAsync(upload_queue_, lhs.RawPtr(), lhs.NumElmts());
+    slot.upload_rhs = slot.rhs.CopyFromHostAsync(upload_queue_, rhs.RawPtr(), rhs.NumElmts());
+
+    size_t global_work_size[2];
+    config_.GlobalWorkSize(M_, N_, global_work_size);
+    kernel_.SetArguments(M_, N_, K_, slot.lhs(), slot.rhs(), slot.result());
+    slot.compute = kernel_.RunAsync(
+      compute_queue_,
+      2,
+      nullptr,
+      global_work_size,
+      config_.local_work_size,
+      { slot.upload_lhs, slot.upload_rhs }
+    );
+
+    slot.download = slot.result.CopyFromDeviceAsync(
+      download_queue_,
+      result.RawPtr(),
+      result.NumElmts(),
+      0,
+      { slot.compute }
+    );
+    slot.done = on_done ? slot.download.Then(on_done) : slot.download;
+    slot.in_flight = true;
+    stats_.num_batches++;
+  }
+
+  /// @brief Wait for every submitted batch
+  void Drain() {
+    for (auto& slot : slots_) {
+      Retire(slot);
+    }
+    if (stats_.num_batches == 0) {
+      return;
+    }
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start_;
+    stats_.wall_seconds = diff.count();
+    stats_.device_seconds = last_end_ > first_start_
+      ? static_cast<double>(last_end_ - first_start_) * 1e-9 : 0.0;
+  }
+
+  const PipelineStats& Stats() const { return stats_; }
+
+private:
+  struct Slot {
+    Slot(const ocl::Context& context, int M, int N, int K)
+      : lhs(context, M * K), rhs(context, K * N), result(context, M * N) {}
+
+    ocl::Buffer<float> lhs;
+    ocl::Buffer<float> rhs;
+    ocl::Buffer<float> result;
+    ocl::Future upload_lhs;
+    ocl::Future upload_rhs;
+    ocl::Future compute;
+    ocl::Future download;
+    ocl::Future done;       // download, or its on_done continuation
+    bool in_flight = false;
+  }; // struct Slot
+
+  ocl::CommandQueue upload_queue_;
+  ocl::CommandQueue compute_queue_;
+  ocl::CommandQueue download_queue_;
+  ocl::Kernel kernel_;
+  MatmulConfig config_;
+  int M_, N_, K_;
+  std::vector<Slot> slots_;
+  size_t next_slot_ = 0;
+
+  PipelineStats stats_;
+  std::chrono::steady_clock::time_point start_;
+  cl_ulong first_start_ = std::numeric_limits<cl_ulong>::max();
+  cl_ulong last_end_ = 0;
+
+  // Wait for the batch occupying the slot and account its stage times
+  void Retire(Slot& slot) {
+    if (!slot.in_flight) {
+      return;
+    }
+    slot.done.Wait();
+    slot.in_flight = false;
+
+    const ocl::Event& upload_lhs = slot.upload_lhs.GetEvent();
+    const ocl::Event& upload_rhs = slot.upload_rhs.GetEvent();
+    const ocl::Event& compute = slot.compute.GetEvent();
+    const ocl::Event& download = slot.download.GetEvent();
+    stats_.upload_seconds += upload_lhs.Duration() + upload_rhs.Duration();
+    stats_.compute_seconds += compute.Duration();
+    stats_.download_seconds += download.Duration();
+    first_start_ = std::min(first_start_, upload_lhs.StartTime());
+    last_end_ = std::max(last_end_, download.EndTime());
+  }
+}; // class MatmulPipeline
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+
+#include "ocl/ocl.h"
+#include "matrix.hpp"
+#include "matmul_tuner.hpp"
+
+
+/// @brief Storage and accumulation precision of the matmul.cl kernels
+enum class GemmPrecision {
+  kFP32,          // float storage and accumulation
+  kFP16Storage,   // half storage, float accumulation; needs no device support
+  kFP16,          // half storage and accumulation; needs cl_khr_fp16
+  kFP64           // double storage and accumulation; needs cl_khr_fp64
+};
+
+inline const char* PrecisionName(GemmPrecision precision) {
+  switch (precision) {
+    case GemmPrecision::kFP16Storage: return "fp16_fp32acc";
+    case GemmPrecision::kFP16: return "fp16";
+    case GemmPrecision::kFP64: return "fp64";
+    default: return "fp32";
+  }
+}
+
+/// @brief Bytes of one stored element and of one accumulated value
+inline size_t StorageBytes(GemmPrecision precision) {
+  switch (precision) {
+    case GemmPrecision::kFP16Storage: case GemmPrecision::kFP16: return sizeof(cl_half);
+    case GemmPrecision::kFP64: return sizeof(cl_double);
+    default: return sizeof(cl_float);
+  }
+}
+
+inline size_t AccumulatorBytes(GemmPrecision precision) {
+  switch (precision) {
+    case GemmPrecision::kFP16: return sizeof(cl_half);
+    case GemmPrecision::kFP64: return sizeof(cl_double);
+    default: return sizeof(cl_float);
+  }
+}
+
+/// @brief PRECISION / ACC_PRECISION compile-time parameters of matmul.cl
+inline ocl::VariantParams PrecisionParams(GemmPrecision precision) {
+  return {
+    {"PRECISION", static_cast<long>(StorageBytes(precision) * 8)},
+    {"ACC_PRECISION", static_cast<long>(AccumulatorBytes(precision) * 8)}
+  };
+}
+
+inline bool IsPrecisionSupported(const ocl::Device& device, GemmPrecision precision) {
+  switch (precision) {
+    case GemmPrecision::kFP16: return device.SupportsFP16();
+    case GemmPrecision::kFP64: return device.SupportsFP64();
+    default: return true;
+  }
+}
+
+/// @brief Shrink the tile of a matmul_v2/v3 configuration (tuned with float
+/// tiles) until the tiles of 'precision' fit in local memory
+inline MatmulConfig FitLocalMemory(const ocl::Device& device, MatmulConfig config, GemmPrecision precision) {
+  const size_t element_bytes = AccumulatorBytes(precision);
+  while (config.tile_size > 1
+         && !device.IsLocalMemoryValid(MatmulTuner::LocalMemoryBytes(config, element_bytes))) {
+    config.tile_size /= 2;
+    config.work_per_thread = std::min(config.work_per_thread, config.tile_size);
+    config.local_work_size[0] = config.kernel_name == "matmul_v2"
+      ? config.tile_size : config.tile_size / config.work_per_thread;
+    config.local_work_size[1] = config.tile_size / config.work_per_thread;
+  }
+  return config;
+}
+
+
+/// @brief Host element type of a stored precision, and conversion of
+/// float data to and from it
+template <typename T>
+struct StorageConversion {
+  static void FromFloat(const float* src, T* dst, size_t num_elmts) {
+    std::copy(src, src + num_elmts, dst);
+  }
+  static void ToFloat(const T* src, float* dst, size_t num_elmts) {
+    for (size_t i = 0; i < num_elmts; i++) {
+      dst[i] = static_cast<float>(src[i]);
+    }
+  }
+};
+
+template <>
+struct StorageConversion<cl_half> {
+  static void FromFloat(const float* src, cl_half* dst, size_t num_elmts) {
+    ocl::FloatToHalf(src, dst, num_elmts);
+  }
+  static void ToFloat(const cl_half* src, float* dst, size_t num_elmts) {
+    ocl::HalfToFloat(src, dst, num_elmts);
+  }
+};
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <iostream>
+#include <chrono>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_cpu.hpp"
+#include "matmul_tuner.hpp"
+#include "matmul_pipeline.hpp"
+
+using namespace ocl;
+
+
+// Stream 'num_batches' independent products through a pipeline of the given depth
+PipelineStats RunStream(const std::vector<Matrix>& lhs,
+                        const std::vector<Matrix>& rhs,
+                        std::vector<Matrix>& results,
+                        Context& context,
+                        Device& device,
+                        Kernel& kernel,
+                        const MatmulConfig& config,
+                        size_t depth) {
+  const int M = lhs[0].Rows(), N = rhs[0].Cols(), K = lhs[0].Cols();
+  MatmulPipeline pipeline(context, device, kernel, config, M, N, K, depth);
+  std::atomic<size_t> num_done(0);
+  for (size_t i = 0; i < results.size(); i++) {
+    pipeline.Submit(lhs[i % lhs.size()], rhs[i % rhs.size()], results[i], [&num_done] { num_done++; });
+  }
+  pipeline.Drain();
+  if (num_done != results.size()) {
+    throw std::runtime_error("Missing completion callbacks.");
+  }
+  return pipeline.Stats();
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <matmul.cl> [num batches] [pipeline depth]" << std::endl;
+    return 1;
+  }
+  int M = 1024, N = 1024, K = 8;
+  size_t num_batches = argc > 2 ? std::stoul(argv[2]) : 32;
+  size_t depth = argc > 3 ? std::stoul(argv[3]) : 3;
+
+  // A few distinct operands, reused round-robin by the batches
+  const size_t num_operands = 4;
+  std::vector<Matrix> lhs, rhs;
+  for (size_t i = 0; i < num_operands; i++) {
+    Matrix a(M, K), b(K, N);
+    for (int m = 0; m < M; m++) {
+      for (int k = 0; k < K; k++) {
+        a(m, k) = (m + i + 1) * (k + 1) / static_cast<float>(M);
+      }
+    }
+    for (int k = 0; k < K; k++) {
+      for (int n = 0; n < N; n++) {
+        b(k, n) = (k + 1) * (n + i + 1) / static_cast<float>(M);
+      }
+    }
+    lhs.push_back(a);
+    rhs.push_back(b);
+  }
+
+  std::string source = utils::ReadKernelFileFromDisk(argv[1]);
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
+  Context context(device);
+  CommandQueue queue(context, device);
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  KernelVariants variants(device, context, source, {}, &program_cache);
+  MatmulTuner tuner(device, context, queue, variants, tuning_db != nullptr ? tuning_db : "matmul_tuning.db");
+  MatmulConfig config = tuner.Get("matmul_v1", M, N, K);
+  Kernel kernel = variants.Get(config.kernel_name, config.Params());
+
+  std::vector<Matrix> results(num_batches, Matrix(M, N));
+  for (size_t d : { size_t{1}, depth }) {
+    PipelineStats stats = RunStream(lhs, rhs, results, context, device, kernel, config, d);
+    std::cout << "<<< Streaming pipeline, depth " << d << " >>>" << std::endl;
+    stats.Print(std::cout);
+    std::cout << std::endl;
+  }
+
+  // Check the last batch
+  const size_t last = num_batches - 1;
+  Matrix reference(M, N);
+  matmul_cpu(lhs[last % num_operands], rhs[last % num_operands], reference);
+  float err = 0.0f;
+  for (size_t i = 0; i < reference.NumElmts(); i++) {
+    err += std::abs(results[last].RawPtr()[i] - reference.RawPtr()[i]);
+  }
+  std::cout << "err.: " << err / static_cast<float>(reference.NumElmts()) << std::endl;
+  return 0;
+}
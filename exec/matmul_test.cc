@@ -4,27 +4,14 @@
 #include "ocl/ocl.h"
 #include "utils.hpp"
 #include "matrix.hpp"
+#include "matmul_cpu.hpp"
+#include "matmul_naive.hpp"
+#include "matmul_tuner.hpp"
 
 using namespace ocl;
 
 
-void matmul_naive(const Matrix& lhs, const Matrix& rhs, Matrix& result) {
-  int M = lhs.Rows();
-  int N = rhs.Cols();
-  int K = lhs.Cols();
-
-  for (int m = 0; m < M; m++) {
-    for (int n = 0; n < N; n++) {
-      float acc = 0;
-      for (int k = 0; k < K; k++) {
-        acc += lhs(m, k) * rhs(k, n);
-      }
-      result(m, n) = acc;
-    }
-  }
-}
-
-void BenchNaiveMatmul(const Matrix& lhs, 
+void BenchCpuMatmul(const Matrix& lhs, 
                       const Matrix& rhs, 
                       const Matrix& ref,
                       size_t num_repeats=1) {
@@ -34,123 +21,165 @@ void BenchNaiveMatmul(const Matrix& lhs,
   for (int n = 0; n < num_repeats; n++) {
     Matrix result(lhs.Rows(), rhs.Cols());
     auto start = std::chrono::high_resolution_clock::now();
-    matmul_naive(lhs, rhs, result);
+    matmul_cpu(lhs, rhs, result);
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diff = end - start;
     double spent_time = diff.count();
     total_spent_time += spent_time;
 
     float err = 0.0f;
-    for (int i = 0; i < result.NumElmts(); i++) {
+    for (size_t i = 0; i < result.NumElmts(); i++) {
       err += std::abs(result.RawPtr()[i] - ref.RawPtr()[i]);
     }
-    total_err += err / static_cast<float>(lhs.Rows() * rhs.Cols());
+    total_err += err / static_cast<float>(result.NumElmts());
   }
 
-  std::cout << "<<< Naive kernel bench results >>>" << std::endl;
+  std::cout << "<<< CPU GEMM (" << matmul_cpu_isa() << ", "
+            << ThreadPool::Default().NumThreads() << " threads) bench results >>>" << std::endl;
   std::cout << "spent time: " << total_spent_time << " seconds" << std::endl;
   std::cout << "err.: " << total_err << std::endl;
   std::cout << std::endl;
 }
 
-void BenchMatmulKernel_v1(const Matrix& lhs, 
-                          const Matrix& rhs, 
-                          const Matrix& ref,
-                          Context& context,
-                          CommandQueue& queue, 
-                          Program& program,
-                          size_t num_repeats=1) {
-  int M = lhs.Rows(), N = rhs.Cols(), K = lhs.Cols();
-  double total_spent_time = 0.0;
-  float total_error = 0.0f;
+/// Check every micro-kernel of matmul_cpu this CPU supports against
+/// matmul_naive, for all layouts and shapes that are not multiples of the
+/// register or cache blocks
+bool CheckCpuMatmul() {
+  const int shapes[][3] = {
+    {1, 1, 1}, {7, 5, 3}, {33, 17, 300}, {131, 77, 259}, {257, 13, 513}, {5, 4100, 9}
+  };
+  const MatrixLayout layouts[] = { MatrixLayout::kColMajor, MatrixLayout::kRowMajor };
+  bool ok = true;
+  for (const cpu::MicroKernel* kernel : cpu::SupportedKernels()) {
+    float max_err = 0.0f;
+    for (const auto& shape : shapes) {
+      const int M = shape[0], N = shape[1], K = shape[2];
+      for (MatrixLayout lhs_layout : layouts) {
+        for (MatrixLayout rhs_layout : layouts) {
+          for (MatrixLayout result_layout : layouts) {
+            Matrix lhs(M, K, lhs_layout), rhs(K, N, rhs_layout);
+            for (int m = 0; m < M; m++) {
+              for (int k = 0; k < K; k++) {
+                lhs(m, k) = static_cast<float>((m * 7 + k * 3) % 11) - 5.0f;
+              }
+            }
+            for (int k = 0; k < K; k++) {
+              for (int n = 0; n < N; n++) {
+                rhs(k, n) = static_cast<float>((k * 5 + n) % 13) - 6.0f;
+              }
+            }
+            Matrix result(M, N, result_layout), reference(M, N);
+            matmul_cpu(lhs, rhs, result, *kernel);
+            matmul_naive(lhs, rhs, reference);
+            for (int m = 0; m < M; m++) {
+              for (int n = 0; n < N; n++) {
+                max_err = std::max(max_err, std::abs(result(m, n) - reference(m, n)));
+              }
+            }
+          }
+        }
+      }
+    }
+    // Small integers: every path must be exact
+    std::cout << "matmul_cpu (" << kernel->name << ") vs. matmul_naive: max err. " << max_err << std::endl;
+    ok = ok && max_err == 0.0f;
+  }
+  std::cout << std::endl;
+  return ok;
+}
 
-  // Create kernel from program
-  //auto kernel = clCreateKernel(program(), "SimpleKernel", &status);
-  Kernel kernel(program, "matmul_v1");
-  
-  // Run kernel
-  size_t num_threads = 4;
-  size_t local_work_size[2] = { num_threads / 2, num_threads / 2};
-  size_t global_work_offset[2] = { 0, 0 };
-  size_t global_workers[2] = { (size_t)M, (size_t)N };
+/// Check matmul_v3 with its tuned configurations against matmul_naive on
+/// shapes that are not multiples of its tiles, so the edge tiles are loaded
+/// and stored as well
+bool CheckMatmulV3(Context& context, CommandQueue& queue, KernelVariants& variants, MatmulTuner& tuner) {
+  const int shapes[][3] = {
+    {1, 1, 1}, {7, 5, 3}, {33, 17, 300}, {131, 77, 259}, {257, 13, 513}
+  };
+  bool ok = true;
+  for (const auto& shape : shapes) {
+    int M = shape[0], N = shape[1], K = shape[2];
+    Matrix lhs(M, K), rhs(K, N), result(M, N), reference(M, N);
+    for (int m = 0; m < M; m++) {
+      for (int k = 0; k < K; k++) {
+        lhs(m, k) = static_cast<float>((m * 7 + k * 3) % 11) - 5.0f;
+      }
+    }
+    for (int k = 0; k < K; k++) {
+      for (int n = 0; n < N; n++) {
+        rhs(k, n) = static_cast<float>((k * 5 + n) % 13) - 6.0f;
+      }
+    }
+    matmul_naive(lhs, rhs, reference);
 
-  for (int n = 0; n < num_repeats; n++) {
-    std::vector<float> results(M * N, 0);
-    
-    // Create buffer
-    Buffer<float> device_lhs(context, M * K);
-    Buffer<float> device_rhs(context, K * N);
-    Buffer<float> device_result(context, N * N);      
+    const MatmulConfig config = tuner.Get("matmul_v3", M, N, K);
+    Kernel kernel = variants.Get("matmul_v3", config.Params());
+    Buffer<float> device_lhs(context, lhs.NumElmts());
+    Buffer<float> device_rhs(context, rhs.NumElmts());
+    Buffer<float> device_result(context, result.NumElmts());
     device_lhs.CopyFromHost(queue, lhs.RawPtr(), lhs.NumElmts());
     device_rhs.CopyFromHost(queue, rhs.RawPtr(), rhs.NumElmts());
-    
-    auto start = std::chrono::high_resolution_clock::now();
-    kernel.SetArguments(
-      M, N, K,
-      device_lhs(),
-      device_rhs(),
-      device_result()
-    );
-    kernel.Run(
-      queue, 
-      2, 
-      global_work_offset,
-      global_workers,
-      local_work_size
-    );
-    queue.Finish();
-    
-    // Copy output buffer into host memory
-    device_result.CopyFromDevice(queue, results.data(), M * N);
-
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> diff = end - start;
-    double spent_time = diff.count();
-    total_spent_time += spent_time;
+    kernel.SetArguments(M, N, K, device_lhs, device_rhs, device_result);
+    size_t global_work_size[2];
+    config.GlobalWorkSize(M, N, global_work_size);
+    kernel.Run(queue, 2, nullptr, global_work_size, config.local_work_size);
+    device_result.CopyFromDevice(queue, result.RawPtr(), result.NumElmts());
 
-    float err = 0.0f;
-    for (int i = 0; i < M * N; i++) {
-      err += std::abs(results[i] - ref.RawPtr()[i]);
+    float max_err = 0.0f;
+    for (size_t i = 0; i < result.NumElmts(); i++) {
+      max_err = std::max(max_err, std::abs(result.RawPtr()[i] - reference.RawPtr()[i]));
     }
-    total_error += err / static_cast<float>(M * N);
+    // Small integers: the sums are exact
+    std::cout << "matmul_v3 " << M << "x" << N << "x" << K << " vs. matmul_naive: max err. "
+              << max_err << std::endl;
+    ok = ok && max_err == 0.0f;
   }
-
-  std::cout << "<<< Matrix multiplication kernel v1 bench results >>>" << std::endl;
-  std::cout << "spent time: " << total_spent_time << " seconds" << std::endl;
-  std::cout << "err.: " << total_error << std::endl;
   std::cout << std::endl;
+  return ok;
 }
 
-void BenchMatmulKernel_v2(const Matrix& lhs, 
-                          const Matrix& rhs, 
-                          const Matrix& ref,
-                          Context& context,
-                          CommandQueue& queue, 
-                          Program& program,
-                          size_t num_repeats=1) {
+void BenchMatmulKernel(const std::string& title,
+                       const Matrix& lhs, 
+                       const Matrix& rhs, 
+                       const Matrix& ref,
+                       Context& context,
+                       MemoryPool& pool,
+                       CommandQueue& queue, 
+                       Kernel& kernel,
+                       const MatmulConfig& config,
+                       bool zero_copy,
+                       size_t num_repeats=1) {
   int M = lhs.Rows(), N = rhs.Cols(), K = lhs.Cols();
   double total_spent_time = 0.0;
+  double total_transfer_time = 0.0;
+  double total_kernel_time = 0.0;
+  double total_launch_latency = 0.0;
   float total_error = 0.0f;
 
-  // Create kernel from program
-  //auto kernel = clCreateKernel(program(), "SimpleKernel", &status);
-  Kernel kernel(program, "matmul_v2");
-  
-  // Run kernel
-  size_t num_threads = 4;
-  size_t local_work_size[2] = { num_threads / 2, num_threads / 2}; 
+  // Run kernel with the tuned launch configuration
   size_t global_work_offset[2] = { 0, 0 };
-  size_t global_workers[2] = { (size_t)M, (size_t)N };
+  size_t global_workers[2];
+  config.GlobalWorkSize(M, N, global_workers);
 
   for (int n = 0; n < num_repeats; n++) {
-    std::vector<float> results(M * N, 0);
+    Matrix result(M, N);
+    std::vector<Event> transfers;
     
-    // Create buffer
-    Buffer<float> device_lhs(context, M * K);
-    Buffer<float> device_rhs(context, K * N);
-    Buffer<float> device_result(context, N * N);      
-    device_lhs.CopyFromHost(queue, lhs.RawPtr(), lhs.NumElmts());
-    device_rhs.CopyFromHost(queue, rhs.RawPtr(), rhs.NumElmts());
+    // Create buffer: either wrap the host matrices (zero-copy) or copy them
+    // into device storage reused from the previous repeat. The inputs are
+    // only read by the kernel, hence the const_cast.
+    Buffer<float> device_lhs = zero_copy
+      ? Buffer<float>(context, lhs.NumElmts(), BufferMode::kUseHostPtr, const_cast<float*>(lhs.RawPtr()), CL_MEM_READ_ONLY)
+      : Buffer<float>(pool, lhs.NumElmts());
+    Buffer<float> device_rhs = zero_copy
+      ? Buffer<float>(context, rhs.NumElmts(), BufferMode::kUseHostPtr, const_cast<float*>(rhs.RawPtr()), CL_MEM_READ_ONLY)
+      : Buffer<float>(pool, rhs.NumElmts());
+    Buffer<float> device_result = zero_copy
+      ? Buffer<float>(context, result.NumElmts(), BufferMode::kUseHostPtr, result.RawPtr(), CL_MEM_WRITE_ONLY)
+      : Buffer<float>(pool, result.NumElmts());
+    if (!zero_copy) {
+      transfers.push_back(device_lhs.CopyFromHost(queue, lhs.RawPtr(), lhs.NumElmts()));
+      transfers.push_back(device_rhs.CopyFromHost(queue, rhs.RawPtr(), rhs.NumElmts()));
+    }
     
     auto start = std::chrono::high_resolution_clock::now();
     kernel.SetArguments(
@@ -159,35 +188,49 @@ void BenchMatmulKernel_v2(const Matrix& lhs,
       device_rhs(),
       device_result()
     );
-    kernel.Run(
+    Event run = kernel.Run(
       queue, 
       2, 
       global_work_offset,
       global_workers,
-      local_work_size
+      config.local_work_size
     );
     queue.Finish();
     
-    // Copy output buffer into host memory
-    device_result.CopyFromDevice(queue, results.data(), M * N);
+    // Copy output buffer into host memory. With zero-copy the kernel wrote
+    // the host matrix in place and mapping it only synchronizes.
+    if (zero_copy) {
+      MappedView<float> view = device_result.Map(queue, CL_MAP_READ, result.NumElmts());
+    } else {
+      transfers.push_back(device_result.CopyFromDevice(queue, result.RawPtr(), result.NumElmts()));
+    }
 
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diff = end - start;
     double spent_time = diff.count();
     total_spent_time += spent_time;
 
+    // Split the wall-clock time using the device timestamps
+    for (const auto& transfer : transfers) {
+      total_transfer_time += transfer.Duration();
+    }
+    total_kernel_time += run.Duration();
+    total_launch_latency += run.LaunchLatency();
+
     float err = 0.0f;
-    for (int i = 0; i < M * N; i++) {
-      err += std::abs(results[i] - ref.RawPtr()[i]);
+    for (size_t i = 0; i < result.NumElmts(); i++) {
+      err += std::abs(result.RawPtr()[i] - ref.RawPtr()[i]);
     }
-    total_error += err / static_cast<float>(M * N);
+    total_error += err / static_cast<float>(result.NumElmts());
   }
 
-  std::cout << "<<< Matrix multiplication kernel v2 bench results >>>" << std::endl;
+  std::cout << "<<< " << title << (zero_copy ? " (zero-copy)" : "") << " bench results >>>" << std::endl;
   std::cout << "spent time: " << total_spent_time << " seconds" << std::endl;
+  std::cout << "transfer time: " << total_transfer_time << " seconds" << std::endl;
+  std::cout << "kernel time: " << total_kernel_time << " seconds" << std::endl;
+  std::cout << "launch latency: " << total_launch_latency << " seconds" << std::endl;
   std::cout << "err.: " << total_error << std::endl;
   std::cout << std::endl;
-
 }
 
 int main(int argc, char** argv) {
@@ -209,21 +252,23 @@ int main(int argc, char** argv) {
     }
   }
   
+  if (!CheckCpuMatmul()) {
+    std::cerr << "matmul_cpu does not match matmul_naive." << std::endl;
+    return 1;
+  }
+
   // Initialize reference
   Matrix reference(M, N);
-  matmul_naive(lhs, rhs, reference);
+  matmul_cpu(lhs, rhs, reference);
   
-  // Bench naive matrix multiplication kernel
-  BenchNaiveMatmul(lhs, rhs, reference, num_repeats);
+  // Bench the host GEMM as the CPU baseline
+  BenchCpuMatmul(lhs, rhs, reference, num_repeats);
 
   // Bench matmul kernel v1
   std::string source_file_path = std::string(argv[1]);
   std::string source = utils::ReadKernelFileFromDisk(source_file_path);
 
-  std::vector<Platform> all_platforms = GetAllPlatforms();
-  size_t num_platforms = all_platforms.size();
-  
-  Device device(all_platforms[0], 0);
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
 
   cl_int status = 0;
 
@@ -232,29 +277,88 @@ int main(int argc, char** argv) {
   
   // Create command queue
   CommandQueue queue(context, device);
+
+  // Device memory is recycled across repeats instead of reallocated, or
+  // skipped altogether when the device can work on host memory directly
+  MemoryPool pool(context);
+  const bool zero_copy = device.PrefersZeroCopy();
   
-  // Compile & Build program
-  Program program(context, source);
-  program.Build(device, {""});
+  // Compile & Build program, reusing the binary of a previous run if possible
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  Program program = program_cache.Get(device, context, source, {""});
+
+  // Pick the tuned launch configurations, searching only on the first run
+  KernelVariants variants(device, context, source, {}, &program_cache);
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  MatmulTuner tuner(device, context, queue, variants, tuning_db != nullptr ? tuning_db : "matmul_tuning.db");
+  MatmulConfig config_v1 = tuner.Get("matmul_v1", M, N, K);
+  MatmulConfig config_v2 = tuner.Get("matmul_v2", M, N, K);
+  MatmulConfig config_v3 = tuner.Get("matmul_v3", M, N, K);
+  Kernel kernel_v1(program, "matmul_v1");
+
+  // Specialize the tuned matmul_v2 for the problem shape
+  VariantParams params_v2 = config_v2.Params();
+  params_v2["FIXED_M"] = M;
+  params_v2["FIXED_N"] = N;
+  params_v2["FIXED_K"] = K;
+  Kernel kernel_v2 = variants.Get("matmul_v2", params_v2);
+  Kernel kernel_v3 = variants.Get("matmul_v3", config_v3.Params());
+
+  program_cache.PrintStats(std::cout);
+  tuner.PrintStats(std::cout);
+  MatmulTuner::Print(std::cout, config_v1);
+  MatmulTuner::Print(std::cout, config_v2);
+  MatmulTuner::Print(std::cout, config_v3);
+  std::cout << std::endl;
+
+  if (!CheckMatmulV3(context, queue, variants, tuner)) {
+    std::cerr << "matmul_v3 does not match matmul_naive." << std::endl;
+    return 1;
+  }
   
-  BenchMatmulKernel_v1(
+  BenchMatmulKernel(
+    "Matrix multiplication kernel v1",
     lhs,
     rhs,
     reference,
     context,
+    pool,
     queue,
-    program, 
+    kernel_v1,
+    config_v1,
+    zero_copy,
     num_repeats
   );
   
-  BenchMatmulKernel_v2(
+  BenchMatmulKernel(
+    "Matrix multiplication kernel v2",
     lhs,
     rhs,
     reference,
     context,
+    pool,
     queue,
-    program,
+    kernel_v2,
+    config_v2,
+    zero_copy,
     num_repeats
   );
+
+  BenchMatmulKernel(
+    "Matrix multiplication kernel v3",
+    lhs,
+    rhs,
+    reference,
+    context,
+    pool,
+    queue,
+    kernel_v3,
+    config_v3,
+    zero_copy,
+    num_repeats
+  );
+
+  pool.PrintStats(std::cout);
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "ocl/ocl.h"
+
+
+/// @brief Launch configuration of a matmul kernel
+struct MatmulConfig {
+  std::string kernel_name;
+  size_t tile_size = 1;                 // TILE_SIZE of matmul_v2/v3
+  size_t work_per_thread = 1;           // WPT of matmul_v2/v3
+  size_t local_work_size[2] = { 1, 1 };
+  double seconds = 0.0;                 // best measured kernel time
+
+  /// @brief Compile-time parameters of the kernel variant
+  ocl::VariantParams Params() const {
+    if (kernel_name == "matmul_v2" || kernel_name == "matmul_v3") {
+      return {
+        {"TILE_SIZE", static_cast<long>(tile_size)},
+        {"WPT", static_cast<long>(work_per_thread)}
+      };
+    }
+    return {};
+  }
+
+  void GlobalWorkSize(int M, int N, size_t global_work_size[2]) const {
+    if (kernel_name == "matmul_v3") {
+      // One work-item per micro-tile, edge tiles included
+      const size_t num_tiles_m = (static_cast<size_t>(M) + tile_size - 1) / tile_size;
+      const size_t num_tiles_n = (static_cast<size_t>(N) + tile_size - 1) / tile_size;
+      global_work_size[0] = num_tiles_m * local_work_size[0];
+      global_work_size[1] = num_tiles_n * local_work_size[1];
+      return;
+    }
+    global_work_size[0] = static_cast<size_t>(M);
+    global_work_size[1] = static_cast<size_t>(N) / work_per_thread;
+  }
+}; // struct MatmulConfig
+
+
+/// @brief Auto-tuner for the matmul kernels.
+///
+/// Searches tile size, work-group shape and work per thread, prunes the
+/// configurations the device cannot run, and times the rest with profiling
+/// events. Winners are stored per (device, kernel, M/N/K bucket) in a text
+/// file so later runs pick them up without searching again.
+class MatmulTuner {
+public:
+  explicit MatmulTuner(const ocl::Device& device,
+                       const ocl::Context& context,
+                       ocl::CommandQueue& queue,
+                       ocl::KernelVariants& variants,
+                       const std::string& db_path,
+                       size_t num_repeats=3)
+    : device_(device), context_(context), queue_(queue), variants_(variants),
+      db_path_(db_path), num_repeats_(num_repeats) {
+    device_key_ = device_.Name() + "|" + device_.DriverVersion();
+    std::replace(device_key_.begin(), device_key_.end(), ' ', '_');
+    Load();
+  }
+
+  /// @brief Get the tuned configuration, searching only when the database
+  /// has no legal entry for this shape.
+  MatmulConfig Get(const std::string& kernel_name, int M, int N, int K) {
+    const std::string key = Key(kernel_name, M, N, K);
+    auto it = database_.find(key);
+    if (it != database_.end() && IsLegal(it->second, M, N, K)) {
+      num_hits_++;
+      return it->second;
+    }
+
+    MatmulConfig best = Tune(kernel_name, M, N, K);
+    database_[key] = best;
+    tuned_.insert(key);
+    Save();
+    return best;
+  }
+
+  /// @brief Time every legal candidate and return the fastest one
+  MatmulConfig Tune(const std::string& kernel_name, int M, int N, int K) {
+    const size_t lhs_elmts = static_cast<size_t>(M) * K;
+    const size_t rhs_elmts = static_cast<size_t>(K) * N;
+    std::vector<float> zeros(std::max(lhs_elmts, rhs_elmts), 0.0f);
+    ocl::Buffer<float> device_lhs(context_, lhs_elmts);
+    ocl::Buffer<float> device_rhs(context_, rhs_elmts);
+    ocl::Buffer<float> device_result(context_, static_cast<size_t>(M) * N);
+    device_lhs.CopyFromHost(queue_, zeros.data(), lhs_elmts);
+    device_rhs.CopyFromHost(queue_, zeros.data(), rhs_elmts);
+
+    MatmulConfig best;
+    best.seconds = std::numeric_limits<double>::max();
+    for (auto& config : Candidates(kernel_name, M, N, K)) {
+      try {
+        ocl::Kernel kernel = variants_.Get(kernel_name, config.Params());
+        kernel.SetArguments(
+          M, N, K,
+          device_lhs(),
+          device_rhs(),
+          device_result()
+        );
+
+        // One warmup launch, then keep the best of the repeats
+        config.seconds = std::numeric_limits<double>::max();
+        for (size_t n = 0; n < num_repeats_ + 1; n++) {
+          double seconds = TimeLaunch(kernel, config, M, N);
+          if (n > 0) {
+            config.seconds = std::min(config.seconds, seconds);
+          }
+        }
+      } catch (const std::runtime_error&) {
+        // Rejected by the compiler or the runtime (e.g. CL_OUT_OF_RESOURCES)
+        continue;
+      }
+      num_evaluated_++;
+
+      if (config.seconds < best.seconds) {
+        best = config;
+      }
+    }
+
+    if (best.kernel_name.empty()) {
+      throw std::runtime_error("MatmulTuner: no valid configuration for " + kernel_name);
+    }
+    num_tuned_++;
+    return best;
+  }
+
+  /// @brief Configurations that are legal for the shape and the device
+  std::vector<MatmulConfig> Candidates(const std::string& kernel_name, int M, int N, int K) const {
+    const size_t sizes[] = { 1, 2, 4, 8, 16, 32, 64 };
+    std::vector<MatmulConfig> candidates;
+
+    if (kernel_name == "matmul_v1") {
+      for (size_t lx : sizes) {
+        for (size_t ly : sizes) {
+          MatmulConfig config;
+          config.kernel_name = kernel_name;
+          config.local_work_size[0] = lx;
+          config.local_work_size[1] = ly;
+          if (IsLegal(config, M, N, K)) {
+            candidates.push_back(config);
+          }
+        }
+      }
+    } else if (kernel_name == "matmul_v2" || kernel_name == "matmul_v3") {
+      for (size_t tile_size : sizes) {
+        for (size_t wpt : sizes) {
+          if (wpt > tile_size || tile_size % wpt != 0) {
+            continue;
+          }
+          MatmulConfig config;
+          config.kernel_name = kernel_name;
+          config.tile_size = tile_size;
+          config.work_per_thread = wpt;
+          config.local_work_size[0] = kernel_name == "matmul_v2" ? tile_size : tile_size / wpt;
+          config.local_work_size[1] = tile_size / wpt;
+          if (IsLegal(config, M, N, K)) {
+            candidates.push_back(config);
+          }
+        }
+      }
+    } else {
+      throw std::runtime_error("MatmulTuner: unknown kernel " + kernel_name);
+    }
+    return candidates;
+  }
+
+  /// @brief Whether the configuration can run the given shape on the device
+  bool IsLegal(const MatmulConfig& config, int M, int N, int K) const {
+    const size_t lx = config.local_work_size[0];
+    const size_t ly = config.local_work_size[1];
+    if (!device_.IsThreadConfigValid({ lx, ly })) {
+      return false;
+    }
+
+    if (config.kernel_name == "matmul_v3") {
+      // Edge tiles are handled by the kernel, only local memory limits it
+      return device_.IsLocalMemoryValid(LocalMemoryBytes(config));
+    }
+
+    if (M % lx != 0 || (N / config.work_per_thread) % ly != 0) {
+      return false;
+    }
+
+    if (config.kernel_name == "matmul_v2") {
+      const size_t tile_size = config.tile_size;
+      if (M % tile_size != 0 || N % tile_size != 0 || K % tile_size != 0) {
+        return false;
+      }
+      if (!device_.IsLocalMemoryValid(LocalMemoryBytes(config))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// @brief Local memory of one work-group of a matmul_v2/v3 configuration
+  /// whose tiles hold 'element_bytes' wide values (the accumulation type)
+  static size_t LocalMemoryBytes(const MatmulConfig& config, size_t element_bytes=sizeof(float)) {
+    const size_t tile_size = config.tile_size;
+    if (config.kernel_name == "matmul_v3") {
+      return (kTileK * (tile_size + kPadding) + tile_size * (kTileK + kPadding)) * element_bytes;
+    }
+    if (config.kernel_name == "matmul_v2") {
+      return 2 * tile_size * tile_size * element_bytes;
+    }
+    return 0;
+  }
+
+  void PrintStats(std::ostream& os) const {
+    os << "tuner: " << num_hits_ << " database hits, "
+       << num_tuned_ << " shapes tuned, "
+       << num_evaluated_ << " configurations timed" << std::endl;
+  }
+
+  static void Print(std::ostream& os, const MatmulConfig& config) {
+    os << config.kernel_name
+       << ": tile size " << config.tile_size
+       << ", work per thread " << config.work_per_thread
+       << ", local work size (" << config.local_work_size[0]
+       << ", " << config.local_work_size[1] << ")"
+       << ", " << config.seconds << " seconds" << std::endl;
+  }
+
+private:
+  // TILE_K and PADDING defaults of matmul_v3
+  static constexpr size_t kTileK = 16;
+  static constexpr size_t kPadding = 1;
+
+  ocl::Device device_;
+  ocl::Context context_;
+  ocl::CommandQueue& queue_;
+  ocl::KernelVariants& variants_;
+  std::string db_path_;
+  std::string device_key_;
+  size_t num_repeats_;
+  std::map<std::string, MatmulConfig> database_;
+  std::set<std::string> tuned_;   // keys this tuner searched itself
+
+  size_t num_hits_ = 0;
+  size_t num_tuned_ = 0;
+  size_t num_evaluated_ = 0;
+
+  double TimeLaunch(ocl::Kernel& kernel, const MatmulConfig& config, int M, int N) {
+    size_t global_work_size[2];
+    config.GlobalWorkSize(M, N, global_work_size);
+
+    ocl::Event event = kernel.Run(
+      queue_,
+      2,
+      nullptr,
+      global_work_size,
+      config.local_work_size
+    );
+    event.Wait();
+    return event.Duration();
+  }
+
+  // Round up to the next power of two
+  static int Bucket(int size) {
+    int bucket = 1;
+    while (bucket < size) {
+      bucket *= 2;
+    }
+    return bucket;
+  }
+
+  std::string Key(const std::string& kernel_name, int M, int N, int K) const {
+    return device_key_ + " " + kernel_name + " "
+      + std::to_string(Bucket(M)) + " "
+      + std::to_string(Bucket(N)) + " "
+      + std::to_string(Bucket(K));
+  }
+
+  // One entry per line:
+  // <device> <kernel> <M bucket> <N bucket> <K bucket> <tile> <wpt> <lx> <ly> <seconds>
+  void Load() {
+    std::ifstream input_file_stream(db_path_);
+    std::string line;
+    while (std::getline(input_file_stream, line)) {
+      std::istringstream fields(line);
+      std::string device_key, kernel_name, m_bucket, n_bucket, k_bucket;
+      MatmulConfig config;
+      fields >> device_key >> kernel_name >> m_bucket >> n_bucket >> k_bucket
+             >> config.tile_size >> config.work_per_thread
+             >> config.local_work_size[0] >> config.local_work_size[1]
+             >> config.seconds;
+      if (!fields) {
+        continue;
+      }
+      config.kernel_name = kernel_name;
+      const std::string key = device_key + " " + kernel_name + " "
+        + m_bucket + " " + n_bucket + " " + k_bucket;
+      database_[key] = config;
+    }
+  }
+
+  // Merge the entries this tuner searched over the current file, so newer
+  // results another tuner saved meanwhile are kept, and write it through a
+  // temporary file so readers never see a partial database
+  void Save() {
+    std::map<std::string, MatmulConfig> own;
+    for (const auto& key : tuned_) {
+      own[key] = database_[key];
+    }
+    Load();
+    for (auto& entry : own) {
+      database_[entry.first] = entry.second;
+    }
+
+    // Unique per process, so tuners saving at once do not share it
+    const std::string tmp_path = db_path_ + ".tmp." + std::to_string(getpid());
+    {
+      std::ofstream output_file_stream(tmp_path, std::ios::trunc);
+      for (const auto& entry : database_) {
+        const MatmulConfig& config = entry.second;
+        output_file_stream << entry.first << " "
+          << config.tile_size << " " << config.work_per_thread << " "
+          << config.local_work_size[0] << " " << config.local_work_size[1] << " "
+          << config.seconds << "\n";
+      }
+      if (!output_file_stream) {
+        std::remove(tmp_path.c_str());
+        return;
+      }
+    }
+    // The database is only a cache: on failure the old file stays in place
+    if (std::rename(tmp_path.c_str(), db_path_.c_str()) != 0) {
+      std::remove(tmp_path.c_str());
+    }
+  }
+}; // class MatmulTuner
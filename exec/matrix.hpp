@@ -1,42 +1,84 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
+#include "ocl/aligned_allocator.hpp"
+
+
+/// @brief Storage order of a Matrix. The matmul kernels work on
+/// column-major data; row-major input can be converted on the device with
+/// the kernels of memcpy.cl.
+enum class MatrixLayout {
+  kColMajor,
+  kRowMajor
+};
+
 
 class Matrix {
 public:
-  Matrix() : row_(0), col_(0) {}
+  Matrix() : row_(0), col_(0), layout_(MatrixLayout::kColMajor) {}
 
-  Matrix(int rows, int cols) : row_(rows), col_(cols) {
-    data_.resize(row_ * col_);
+  Matrix(int rows, int cols, MatrixLayout layout=MatrixLayout::kColMajor)
+    : row_(rows), col_(cols), layout_(layout) {
+    data_.resize(static_cast<size_t>(row_) * col_);
   }
 
   ~Matrix() {}
 
+  /// @brief Matrix over 'data', owned by someone else (e.g. a memory-mapped
+  /// file) and kept alive by 'owner'. Copies of a view share its storage.
+  static Matrix View(int rows, int cols, MatrixLayout layout, float* data,
+                     std::shared_ptr<const void> owner) {
+    Matrix matrix;
+    matrix.row_ = rows;
+    matrix.col_ = cols;
+    matrix.layout_ = layout;
+    matrix.view_ = data;
+    matrix.owner_ = std::move(owner);
+    return matrix;
+  }
+
+  bool IsView() const { return view_ != nullptr; }
+
   int Rows() const { return row_; }
   int Cols() const { return col_; }
-  int NumElmts() const { return row_ * col_; }
+  size_t NumElmts() const { return static_cast<size_t>(row_) * col_; }
+  MatrixLayout Layout() const { return layout_; }
+
+  /// Distance in elements between consecutive columns (column-major) or
+  /// rows (row-major)
+  int LeadingDimension() const {
+    return layout_ == MatrixLayout::kColMajor ? row_ : col_;
+  }
 
   float& operator() (int i, int j) {
-    int index = GetFlattenedIndex(i, j);
-    return data_[index];
+    size_t index = GetFlattenedIndex(i, j);
+    return RawPtr()[index];
   }
 
   const float operator() (int i, int j) const {
-    int index = GetFlattenedIndex(i, j);
-    return data_[index];
+    size_t index = GetFlattenedIndex(i, j);
+    return RawPtr()[index];
   }
 
-  float* RawPtr() { return data_.data(); }
-  const float* RawPtr() const { return data_.data(); }
+  /// Storage is page aligned and padded, so it can be wrapped by a
+  /// CL_MEM_USE_HOST_PTR buffer without a copy.
+  float* RawPtr() { return view_ != nullptr ? view_ : data_.data(); }
+  const float* RawPtr() const { return view_ != nullptr ? view_ : data_.data(); }
 
 private:
   int row_;
   int col_;
-  std::vector<float> data_;
+  MatrixLayout layout_;
+  std::vector<float, ocl::AlignedAllocator<float>> data_;
+  float* view_ = nullptr;
+  std::shared_ptr<const void> owner_;
 
-  int GetFlattenedIndex(int r, int c) const {
-    //return r * col_ + c;
-    return r + c * row_;
+  size_t GetFlattenedIndex(int r, int c) const {
+    if (layout_ == MatrixLayout::kRowMajor) {
+      return static_cast<size_t>(r) * col_ + c;
+    }
+    return r + static_cast<size_t>(c) * row_;
   }
 }; // class Matrix
\ No newline at end of file
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ocl/ocl.h"
+#include "matrix.hpp"
+
+
+/// @brief Element type of a matrix file
+enum class MatrixDataType : uint32_t {
+  kFloat32 = 0,
+  kFloat16 = 1,
+  kFloat64 = 2
+};
+
+inline size_t DataTypeBytes(MatrixDataType type) {
+  switch (type) {
+    case MatrixDataType::kFloat16: return 2;
+    case MatrixDataType::kFloat64: return 8;
+    default: return 4;
+  }
+}
+
+/// @brief Fixed 64 byte header of a matrix file. The elements follow at
+/// 'data_offset', a multiple of 'alignment', so a mapping of the file
+/// exposes them page aligned.
+struct MatrixFileHeader {
+  char magic[8];            // "OCLMAT\0\0"
+  uint32_t version;
+  uint32_t data_type;       // MatrixDataType
+  uint32_t layout;          // 0 column-major, 1 row-major
+  uint32_t alignment;       // of data_offset, in bytes
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t data_offset;
+  uint8_t reserved[16];
+}; // struct MatrixFileHeader
+
+static_assert(sizeof(MatrixFileHeader) == 64, "MatrixFileHeader must be 64 bytes.");
+
+
+/// @brief Memory mapping of a matrix file.
+///
+/// The elements are read through the page cache: nothing is copied to the
+/// heap, pages are faulted in as they are touched and can be dropped by the
+/// kernel again under memory pressure. The mapping is private, so writes
+/// through a view stay in memory and never reach the file.
+class MatrixFile {
+public:
+  static constexpr uint32_t kVersion = 1;
+  static constexpr size_t kDefaultAlignment = 4096;
+
+  explicit MatrixFile(const std::string& path) : path_(path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("MatrixFile: cannot open " + path + ": " + strerror(errno) + ".");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(MatrixFileHeader)) {
+      close(fd);
+      throw std::runtime_error("MatrixFile: " + path + " is too small to be a matrix file.");
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    void* address = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+      throw std::runtime_error("MatrixFile: cannot map " + path + ": " + strerror(errno) + ".");
+    }
+    mapping_.reset(address, Unmapper{ size_ });
+
+    memcpy(&header_, address, sizeof(header_));
+    Validate();
+    madvise(address, size_, MADV_SEQUENTIAL);
+  }
+
+  int Rows() const { return static_cast<int>(header_.rows); }
+  int Cols() const { return static_cast<int>(header_.cols); }
+  size_t NumElmts() const { return static_cast<size_t>(header_.rows) * header_.cols; }
+  MatrixDataType DataType() const { return static_cast<MatrixDataType>(header_.data_type); }
+  MatrixLayout Layout() const {
+    return header_.layout == 1 ? MatrixLayout::kRowMajor : MatrixLayout::kColMajor;
+  }
+  size_t DataBytes() const { return NumElmts() * DataTypeBytes(DataType()); }
+
+  /// @brief The mapped elements
+  const void* Data() const { return static_cast<const char*>(mapping_.get()) + header_.data_offset; }
+
+  /// @brief Zero-copy Matrix over the mapped elements, valid after this
+  /// MatrixFile is gone. float32 files only.
+  Matrix AsMatrix() const {
+    if (DataType() != MatrixDataType::kFloat32) {
+      throw std::runtime_error("MatrixFile: " + path_ + " does not hold float32 elements.");
+    }
+    return Matrix::View(Rows(), Cols(), Layout(),
+                        static_cast<float*>(const_cast<void*>(Data())), mapping_);
+  }
+
+  /// @brief Upload the elements into 'dst' in chunks of about
+  /// 'chunk_bytes', straight from the mapping. While a chunk is transferred
+  /// the pages of the next one are read ahead, and at most two chunks are
+  /// in flight. Returns the upload of the last chunk; the mapping is kept
+  /// alive until it completes, even if this MatrixFile is destroyed first.
+  template <typename T>
+  ocl::Future Upload(ocl::CommandQueue& queue,
+                     ocl::Buffer<T>& dst,
+                     size_t chunk_bytes=16 << 20,
+                     const std::vector<ocl::Future>& dependencies={}) const {
+    if (sizeof(T) != DataTypeBytes(DataType())) {
+      throw std::runtime_error("MatrixFile: element size of " + path_ + " does not match the buffer.");
+    }
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    chunk_bytes = std::max(page, chunk_bytes / page * page);
+    const char* data = static_cast<const char*>(Data());
+    const size_t total = DataBytes();
+
+    ocl::Future previous, last;
+    if (total > 0) {
+      WillNeed(data, std::min(chunk_bytes, total), page);
+    }
+    for (size_t offset = 0; offset < total; offset += chunk_bytes) {
+      const size_t bytes = std::min(chunk_bytes, total - offset);
+      if (offset + bytes < total) {
+        WillNeed(data + offset + bytes, std::min(chunk_bytes, total - offset - bytes), page);
+      }
+      // The first chunk waits for 'dependencies', the next ones follow it
+      // on the queue
+      last = dst.CopyFromHostAsync(
+        queue, reinterpret_cast<const T*>(data + offset), bytes / sizeof(T), offset / sizeof(T),
+        offset == 0 ? dependencies : std::vector<ocl::Future>()
+      );
+      if (previous.Valid()) {
+        previous.Wait();
+      }
+      previous = last;
+    }
+    // Earlier chunks were waited on, only the last one may still read
+    // the mapping
+    std::shared_ptr<void> mapping = mapping_;
+    last.Then([mapping] {});
+    return last;
+  }
+
+  /// @brief Write a matrix file of 'rows' x 'cols' elements of 'data_type'
+  /// from 'data'. The file is written next to 'path' and renamed into
+  /// place, so readers never see a partial file.
+  static void Write(const std::string& path,
+                    int rows,
+                    int cols,
+                    MatrixLayout layout,
+                    MatrixDataType data_type,
+                    const void* data,
+                    size_t alignment=kDefaultAlignment) {
+    if (rows < 0 || cols < 0) {
+      throw std::runtime_error("MatrixFile: the shape of " + path + " must not be negative.");
+    }
+    if (alignment == 0 || alignment > UINT32_MAX) {
+      throw std::runtime_error("MatrixFile: invalid alignment " + std::to_string(alignment)
+                               + " for " + path + ".");
+    }
+    MatrixFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Magic(), sizeof(header.magic));
+    header.version = kVersion;
+    header.data_type = static_cast<uint32_t>(data_type);
+    header.layout = layout == MatrixLayout::kRowMajor ? 1 : 0;
+    header.alignment = static_cast<uint32_t>(alignment);
+    header.rows = static_cast<uint64_t>(rows);
+    header.cols = static_cast<uint64_t>(cols);
+    header.data_offset = (sizeof(header) + alignment - 1) / alignment * alignment;
+
+    // Unique per process, so concurrent writers do not share a partial file
+    const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    {
+      std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+      if (!out) {
+        throw std::runtime_error("MatrixFile: cannot write " + tmp_path + ".");
+      }
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      const std::vector<char> padding(header.data_offset - sizeof(header), 0);
+      out.write(padding.data(), padding.size());
+      out.write(static_cast<const char*>(data),
+                static_cast<size_t>(rows) * cols * DataTypeBytes(data_type));
+      if (!out) {
+        throw std::runtime_error("MatrixFile: failed writing " + tmp_path + ".");
+      }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+      throw std::runtime_error("MatrixFile: cannot rename " + tmp_path + " to " + path + ".");
+    }
+  }
+
+  static void Write(const std::string& path, const Matrix& matrix, size_t alignment=kDefaultAlignment) {
+    Write(path, matrix.Rows(), matrix.Cols(), matrix.Layout(), MatrixDataType::kFloat32,
+          matrix.RawPtr(), alignment);
+  }
+
+private:
+  /// The 8 magic bytes, NUL padded
+  static const char* Magic() { return "OCLMAT\0"; }
+
+  struct Unmapper {
+    size_t size;
+    void operator()(void* address) const { munmap(address, size); }
+  }; // struct Unmapper
+
+  std::string path_;
+  size_t size_ = 0;
+  std::shared_ptr<void> mapping_;
+  MatrixFileHeader header_;
+
+  void Validate() const {
+    if (memcmp(header_.magic, Magic(), sizeof(header_.magic)) != 0) {
+      throw std::runtime_error("MatrixFile: " + path_ + " is not a matrix file.");
+    }
+    if (header_.version != kVersion) {
+      throw std::runtime_error("MatrixFile: " + path_ + " has unsupported version "
+                               + std::to_string(header_.version) + ".");
+    }
+    if (header_.data_type > static_cast<uint32_t>(MatrixDataType::kFloat64) || header_.layout > 1) {
+      throw std::runtime_error("MatrixFile: " + path_ + " has an unknown data type or layout.");
+    }
+    // Matrix shapes are int; within INT_MAX the element count cannot wrap
+    if (header_.rows > INT_MAX || header_.cols > INT_MAX) {
+      throw std::runtime_error("MatrixFile: " + path_ + " has a shape beyond INT_MAX.");
+    }
+    // The elements are accessed in place, so they must be aligned to their
+    // own size as well, whatever alignment the file claims
+    if (header_.alignment == 0 || header_.data_offset % header_.alignment != 0
+        || header_.data_offset % DataTypeBytes(DataType()) != 0) {
+      throw std::runtime_error("MatrixFile: " + path_ + " has a misaligned data offset.");
+    }
+    // Compared in elements, as the byte count of a forged shape may wrap
+    if (header_.data_offset < sizeof(header_) || header_.data_offset > size_
+        || NumElmts() > (size_ - header_.data_offset) / DataTypeBytes(DataType())) {
+      throw std::runtime_error("MatrixFile: " + path_ + " is truncated.");
+    }
+  }
+
+  /// Start reading the pages of [address, address + bytes) from the file
+  static void WillNeed(const char* address, size_t bytes, size_t page) {
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(address) / page * page;
+    madvise(reinterpret_cast<void*>(begin),
+            reinterpret_cast<uintptr_t>(address) + bytes - begin, MADV_WILLNEED);
+  }
+}; // class MatrixFile
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "data_movement.hpp"
+
+using namespace ocl;
+
+
+// Best kernel time of 'num_repeats' runs of 'enqueue', after one warmup run
+template <typename Function>
+double BestTime(size_t num_repeats, Function enqueue) {
+  double best = std::numeric_limits<double>::max();
+  for (size_t n = 0; n < num_repeats + 1; n++) {
+    Event event = enqueue();
+    event.Wait();
+    if (n > 0) {
+      best = std::min(best, event.Duration());
+    }
+  }
+  return best;
+}
+
+void PrintBandwidth(const std::string& title, double seconds, double bytes, bool ok) {
+  std::cout << std::left << std::setw(28) << title
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << seconds * 1e3
+            << std::setprecision(2)
+            << std::setw(12) << bytes / seconds * 1e-9
+            << std::setw(8) << (ok ? "ok" : "FAILED")
+            << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <kernel dir> [rows] [cols] [repeats]" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+  const int rows = argc > 2 ? std::stoi(argv[2]) : 4096;
+  const int cols = argc > 3 ? std::stoi(argv[3]) : 4096;
+  const size_t num_repeats = argc > 4 ? std::stoul(argv[4]) : 10;
+  const size_t num_elmts = static_cast<size_t>(rows) * cols;
+
+  // A row-major host matrix, as it would come from a row-major producer
+  Matrix host(rows, cols, MatrixLayout::kRowMajor);
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      host(i, j) = static_cast<float>(i * cols + j);
+    }
+  }
+
+  Device device = SelectDevice(DeviceCriteria::FromEnvironment());
+  Context context(device);
+  CommandQueue queue(context, device);
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  ProgramCache program_cache(cache_dir != nullptr ? cache_dir : ".ocl_program_cache");
+  KernelVariants variants(
+    device, context, utils::ReadKernelFileFromDisk(kernel_dir + "/memcpy.cl"), {}, &program_cache
+  );
+  DataMovement data_movement(variants);
+
+  Buffer<float> src(context, num_elmts);
+  Buffer<float> dst(context, num_elmts);
+  src.CopyFromHost(queue, host.RawPtr(), num_elmts);
+  Matrix result(rows, cols);
+
+  // Copies read and write every element once, a fill only writes
+  const double copy_bytes = 2.0 * num_elmts * sizeof(float);
+  const double fill_bytes = 1.0 * num_elmts * sizeof(float);
+
+  std::cout << std::left << std::setw(28) << "operation"
+            << std::right << std::setw(12) << "time(ms)"
+            << std::setw(12) << "GB/s"
+            << std::setw(8) << "check" << std::endl;
+
+  double seconds = BestTime(num_repeats, [&] {
+    return dst.CopyFromBuffer(queue, src, num_elmts);
+  });
+  dst.CopyFromDevice(queue, result.RawPtr(), num_elmts);
+  PrintBandwidth("clEnqueueCopyBuffer", seconds, copy_bytes,
+                 std::equal(result.RawPtr(), result.RawPtr() + num_elmts, host.RawPtr()));
+
+  seconds = BestTime(num_repeats, [&] {
+    return data_movement.Copy(queue, rows, cols, src, dst);
+  });
+  dst.CopyFromDevice(queue, result.RawPtr(), num_elmts);
+  PrintBandwidth("copy_matrix", seconds, copy_bytes,
+                 std::equal(result.RawPtr(), result.RawPtr() + num_elmts, host.RawPtr()));
+
+  // Left half of the columns of a column-major rows x cols matrix
+  const int half = cols / 2;
+  seconds = BestTime(num_repeats, [&] {
+    return data_movement.CopyStrided(queue, rows, half, src, 0, rows, dst, 0, rows);
+  });
+  PrintBandwidth("copy_strided (half)", seconds, copy_bytes / 2, true);
+
+  // Row-major host data to the column-major layout of the matmul kernels
+  seconds = BestTime(num_repeats, [&] {
+    return data_movement.ConvertLayout(
+      queue, rows, cols, MatrixLayout::kRowMajor, MatrixLayout::kColMajor, src, dst
+    );
+  });
+  dst.CopyFromDevice(queue, result.RawPtr(), num_elmts);
+  bool ok = true;
+  for (int i = 0; i < rows && ok; i++) {
+    for (int j = 0; j < cols && ok; j++) {
+      ok = result(i, j) == host(i, j);
+    }
+  }
+  PrintBandwidth("transpose (row->col major)", seconds, copy_bytes, ok);
+
+  seconds = BestTime(num_repeats, [&] {
+    return data_movement.Fill(queue, static_cast<int>(num_elmts), 1.0f, dst);
+  });
+  dst.CopyFromDevice(queue, result.RawPtr(), num_elmts);
+  ok = std::all_of(result.RawPtr(), result.RawPtr() + num_elmts, [](float v) { return v == 1.0f; });
+  PrintBandwidth("fill", seconds, fill_bytes, ok);
+  return 0;
+}
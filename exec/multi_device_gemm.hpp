@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+
+#include "ocl/ocl.h"
+#include "matrix.hpp"
+#include "matmul_tuner.hpp"
+
+
+/// @brief Share of the last MultiDeviceGemm::Run of one device
+struct DeviceShare {
+  std::string name;
+  int first_col = 0;
+  int num_cols = 0;
+  double seconds = 0.0;      // upload start to download end
+  double throughput = 0.0;   // smoothed estimate, columns per second; 0 until measured
+};
+
+
+/// @brief result = lhs * rhs on several OpenCL devices at once.
+///
+/// Each device has its own context, queue, memory pool and tuned matmul_v3.
+/// The columns of the result are split into contiguous blocks (column-major
+/// blocks of rhs and result are contiguous, so every device gets plain
+/// buffers), proportioned by each device's throughput. The first split
+/// uses the devices' shares of the summed compute units times clock; the
+/// first measurement of a device replaces that guess and later ones move
+/// the split towards the measured speeds. Each device tunes matmul_v3 once
+/// per shape, for the full N, and reuses the configuration for every share.
+class MultiDeviceGemm {
+public:
+  /// @param source Source of matmul.cl
+  /// @param smoothing Weight of the latest measurement in the throughput
+  /// estimate, in (0, 1]
+  explicit MultiDeviceGemm(const std::vector<ocl::Device>& devices,
+                           const std::string& source,
+                           ocl::ProgramCache* cache,
+                           const std::string& tuning_db,
+                           double smoothing=0.5)
+    : smoothing_(smoothing) {
+    if (devices.empty()) {
+      throw std::runtime_error("MultiDeviceGemm: no device.");
+    }
+    for (const auto& device : devices) {
+      workers_.emplace_back(new Worker(device, source, cache, tuning_db));
+    }
+  }
+
+  size_t NumDevices() const { return workers_.size(); }
+
+  /// @brief Compute result = lhs * rhs. All three matrices must be
+  /// column-major and the result already M x N.
+  void Run(const Matrix& lhs, const Matrix& rhs, Matrix& result) {
+    if (lhs.Layout() != MatrixLayout::kColMajor
+        || rhs.Layout() != MatrixLayout::kColMajor
+        || result.Layout() != MatrixLayout::kColMajor) {
+      throw std::runtime_error("MultiDeviceGemm: matrices must be column-major.");
+    }
+    const int M = lhs.Rows();
+    const int N = rhs.Cols();
+    const int K = lhs.Cols();
+    for (auto& worker : workers_) {
+      worker->Prepare(M, N, K);
+    }
+    Split(N);
+
+    // Enqueue everything without blocking so the devices run concurrently
+    for (auto& worker : workers_) {
+      if (worker->share.num_cols > 0) {
+        worker->Enqueue(lhs, rhs, result, M, K);
+      }
+    }
+    for (auto& worker : workers_) {
+      if (worker->share.num_cols > 0) {
+        worker->Finish(smoothing_);
+      }
+    }
+  }
+
+  /// @brief Shares of the last Run
+  std::vector<DeviceShare> Shares() const {
+    std::vector<DeviceShare> shares;
+    for (const auto& worker : workers_) {
+      shares.push_back(worker->share);
+    }
+    return shares;
+  }
+
+  void PrintShares(std::ostream& os) const {
+    for (const auto& worker : workers_) {
+      const DeviceShare& share = worker->share;
+      os << std::left << std::setw(40) << share.name
+         << std::right << std::setw(8) << share.num_cols << " cols"
+         << std::fixed << std::setprecision(3)
+         << std::setw(10) << share.seconds * 1e3 << " ms"
+         << std::defaultfloat << std::endl;
+    }
+  }
+
+private:
+  struct Worker {
+    Worker(const ocl::Device& device,
+           const std::string& source,
+           ocl::ProgramCache* cache,
+           const std::string& tuning_db)
+      : device(device), context(device), queue(context, device), pool(context),
+        variants(device, context, source, {}, cache),
+        tuner(device, context, queue, variants, tuning_db) {
+      share.name = device.Name();
+      guess = static_cast<double>(device.ComputeUnits() * std::max<size_t>(1, device.CoreClock()));
+    }
+
+    ocl::Device device;
+    ocl::Context context;
+    ocl::CommandQueue queue;
+    ocl::MemoryPool pool;
+    ocl::KernelVariants variants;
+    MatmulTuner tuner;
+    DeviceShare share;
+    double guess = 0.0;            // compute units x MHz, only for the first split
+    bool measured = false;
+    std::unique_ptr<ocl::Buffer<float>> lhs, rhs, result;
+    ocl::Event upload_lhs, upload_rhs, compute, download;
+    // Tuned for the full shape, so moving the split never re-tunes
+    int shape[3] = { -1, -1, -1 };
+    MatmulConfig config;
+    std::unique_ptr<ocl::Kernel> kernel;
+
+    /// Look up the configuration of an M x N x K product, outside the
+    /// concurrent enqueue loop (a miss tunes and blocks)
+    void Prepare(int M, int N, int K) {
+      if (kernel && shape[0] == M && shape[1] == N && shape[2] == K) {
+        return;
+      }
+      config = tuner.Get("matmul_v3", M, N, K);
+      kernel.reset(new ocl::Kernel(variants.Get(config.kernel_name, config.Params())));
+      shape[0] = M;
+      shape[1] = N;
+      shape[2] = K;
+    }
+
+    void Enqueue(const Matrix& host_lhs, const Matrix& host_rhs, Matrix& host_result, int M, int K) {
+      const int n = share.num_cols;
+      const size_t rhs_offset = static_cast<size_t>(share.first_col) * K;
+      const size_t result_offset = static_cast<size_t>(share.first_col) * M;
+
+      lhs.reset(new ocl::Buffer<float>(pool, static_cast<size_t>(M) * K));
+      rhs.reset(new ocl::Buffer<float>(pool, static_cast<size_t>(K) * n));
+      result.reset(new ocl::Buffer<float>(pool, static_cast<size_t>(M) * n));
+      upload_lhs = lhs->CopyFromHost(queue, host_lhs.RawPtr(), host_lhs.NumElmts(), 0, false);
+      upload_rhs = rhs->CopyFromHost(queue, host_rhs.RawPtr() + rhs_offset, static_cast<size_t>(K) * n, 0, false);
+
+      size_t global_work_size[2];
+      config.GlobalWorkSize(M, n, global_work_size);
+      kernel->SetArguments(M, n, K, (*lhs)(), (*rhs)(), (*result)());
+      compute = kernel->Run(queue, 2, nullptr, global_work_size, config.local_work_size);
+      download = result->CopyFromDevice(
+        queue, host_result.RawPtr() + result_offset, static_cast<size_t>(M) * n, 0, false
+      );
+      queue.Flush();
+    }
+
+    void Finish(double smoothing) {
+      download.Wait();
+      share.seconds = static_cast<double>(download.EndTime() - upload_lhs.StartTime()) * 1e-9;
+      if (share.seconds > 0.0) {
+        const double latest = share.num_cols / share.seconds;
+        share.throughput = measured ? smoothing * latest + (1.0 - smoothing) * share.throughput : latest;
+        measured = true;
+      }
+    }
+  }; // struct Worker
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  double smoothing_;
+
+  // Columns per device proportional to the throughput estimates. Every
+  // device keeps at least one column while there are enough, so its speed
+  // is still measured and it can win work back.
+  void Split(int N) {
+    // Until a device is measured, its estimate is its share of the summed
+    // guesses, scaled to the measured speed of the others (or taken as is
+    // before any measurement), so guesses and columns per second never mix
+    double measured_total = 0.0, measured_guess = 0.0, guess_total = 0.0;
+    for (const auto& worker : workers_) {
+      guess_total += worker->guess;
+      if (worker->measured) {
+        measured_total += worker->share.throughput;
+        measured_guess += worker->guess;
+      }
+    }
+    std::vector<double> estimates;
+    double total = 0.0;
+    for (const auto& worker : workers_) {
+      double estimate = worker->guess / guess_total;
+      if (worker->measured) {
+        estimate = worker->share.throughput;
+      } else if (measured_guess > 0.0) {
+        estimate = worker->guess * measured_total / measured_guess;
+      }
+      estimates.push_back(estimate);
+      total += estimate;
+    }
+
+    const int num_devices = static_cast<int>(workers_.size());
+    const int reserved = std::min(N, num_devices);
+    int first_col = 0;
+    for (int d = 0; d < num_devices; d++) {
+      DeviceShare& share = workers_[d]->share;
+      int num_cols = 0;
+      if (d == num_devices - 1) {
+        num_cols = N - first_col;
+      } else {
+        num_cols = static_cast<int>((N - reserved) * estimates[d] / total) + (d < reserved ? 1 : 0);
+        num_cols = std::min(num_cols, N - first_col);
+      }
+      share.first_col = first_col;
+      share.num_cols = num_cols;
+      first_col += num_cols;
+    }
+  }
+}; // class MultiDeviceGemm
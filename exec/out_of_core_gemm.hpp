@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+#include "ocl/ocl.h"
+#include "matrix.hpp"
+#include "data_movement.hpp"
+#include "matmul_tuner.hpp"
+
+
+/// @brief Counters of the last OutOfCoreGemm::Multiply
+struct OutOfCoreStats {
+  size_t num_tiles = 0;           // result tiles computed
+  size_t num_panel_loads = 0;     // operand panels uploaded
+  size_t num_panel_hits = 0;      // operand panels found resident
+  double uploaded_bytes = 0.0;
+  double downloaded_bytes = 0.0;
+  size_t device_bytes = 0;        // device working set
+  double seconds = 0.0;
+
+  double HitRate() const {
+    const size_t total = num_panel_loads + num_panel_hits;
+    return total > 0 ? static_cast<double>(num_panel_hits) / total : 0.0;
+  }
+
+  void Print(std::ostream& os) const {
+    os << "tiles: " << num_tiles
+       << ", panel uploads: " << num_panel_loads
+       << ", resident hits: " << num_panel_hits << " (" << HitRate() * 100 << "%)" << std::endl;
+    os << "transferred: " << uploaded_bytes * 1e-6 << " MB up, "
+       << downloaded_bytes * 1e-6 << " MB down; device working set: "
+       << device_bytes * 1e-6 << " MB" << std::endl;
+  }
+}; // struct OutOfCoreStats
+
+
+/// @brief GEMM of column-major matrices larger than device memory.
+///
+/// result is split in tile x tile blocks, computed one after the other as
+/// the sum over K of (tile x tile) lhs and rhs panels with matmul_v3, the
+/// first panel product overwriting the device tile and the next ones
+/// accumulating into it. The operand panels go through a fixed pool of
+/// device slots managed as an LRU cache, so panels still resident are not
+/// uploaded again; the K loop runs in alternating directions to start each
+/// tile with the panels the last one ended with.
+///
+/// Uploads and downloads run on their own queue and only wait for the
+/// computes they must, so the next panels upload while the current product
+/// runs. Panels and result tiles move between the host matrices and the
+/// device with rectangular transfers, so the host needs no staging memory.
+class OutOfCoreGemm {
+public:
+  /// @param variants Variants of the matmul.cl program
+  /// @param device_budget Device bytes for the working set; 0 for a quarter
+  /// of the device memory
+  /// @param num_panel_slots Operand panels kept on the device (at least 4:
+  /// the two panels in use and the two being uploaded)
+  explicit OutOfCoreGemm(const ocl::Device& device,
+                         const ocl::Context& context,
+                         ocl::KernelVariants& variants,
+                         MatmulTuner& tuner,
+                         size_t device_budget=0,
+                         size_t num_panel_slots=8)
+    : transfer_queue_(context, device),
+      compute_queue_(context, device) {
+    if (num_panel_slots < 4) {
+      throw std::runtime_error("OutOfCoreGemm: at least 4 panel slots are needed.");
+    }
+    if (device_budget == 0) {
+      device_budget = device.MemorySize() / 4;
+    }
+
+    // Operand slots and two result tiles of tile x tile floats, each within
+    // the largest allocation, with the tile a multiple of 64
+    const size_t num_device_tiles = num_panel_slots + kNumResultSlots;
+    size_t tile_elmts = std::min<size_t>(device_budget / num_device_tiles, device.MaxAllocSize())
+      / sizeof(float);
+    tile_ = static_cast<int>(std::sqrt(static_cast<double>(tile_elmts))) / 64 * 64;
+    if (tile_ < 64) {
+      throw std::runtime_error("OutOfCoreGemm: device budget too small.");
+    }
+    tile_elmts = static_cast<size_t>(tile_) * tile_;
+
+    config_ = tuner.Get("matmul_v3", tile_, tile_, tile_);
+    ocl::VariantParams params = config_.Params();
+    overwrite_kernel_.reset(new ocl::Kernel(variants.Get("matmul_v3", params)));
+    params["ACCUMULATE"] = 1;
+    accumulate_kernel_.reset(new ocl::Kernel(variants.Get("matmul_v3", params)));
+
+    for (size_t i = 0; i < num_panel_slots; i++) {
+      panels_.emplace_back(new PanelSlot(context, tile_elmts));
+    }
+    for (size_t i = 0; i < kNumResultSlots; i++) {
+      results_.emplace_back(new ResultSlot(context, tile_elmts));
+    }
+    stats_.device_bytes = num_device_tiles * tile_elmts * sizeof(float);
+  }
+
+  ~OutOfCoreGemm() {
+    try {
+      transfer_queue_.Finish();
+      compute_queue_.Finish();
+    } catch (const std::runtime_error&) {
+    }
+  }
+
+  int TileSize() const { return tile_; }
+  const OutOfCoreStats& Stats() const { return stats_; }
+
+  /// @brief result = lhs * rhs, all column-major; result is resized.
+  /// Resident panels are forgotten between calls, as the host matrices may
+  /// have changed.
+  void Multiply(const Matrix& lhs, const Matrix& rhs, Matrix& result) {
+    if (lhs.Cols() != rhs.Rows()) {
+      throw std::runtime_error("OutOfCoreGemm: shapes do not match.");
+    }
+    if (lhs.Layout() != MatrixLayout::kColMajor || rhs.Layout() != MatrixLayout::kColMajor) {
+      throw std::runtime_error("OutOfCoreGemm: operands must be column-major.");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    OutOfCoreStats stats;
+    stats.device_bytes = stats_.device_bytes;
+    stats_ = stats;
+    const int M = lhs.Rows(), N = rhs.Cols(), K = lhs.Cols();
+    result = Matrix(M, N);
+    if (K == 0) {
+      return;
+    }
+    for (auto& panel : panels_) {
+      panel->key = PanelKey();
+    }
+
+    const int num_row_tiles = NumTiles(M), num_col_tiles = NumTiles(N), num_k_tiles = NumTiles(K);
+    bool forward = true;
+    for (int i = 0; i < num_row_tiles; i++) {
+      for (int j = 0; j < num_col_tiles; j++) {
+        ResultSlot& slot = *results_[next_result_];
+        next_result_ = (next_result_ + 1) % results_.size();
+
+        const int rows = TileExtent(i, M), cols = TileExtent(j, N);
+        ocl::Future compute;
+        for (int step = 0; step < num_k_tiles; step++) {
+          const int k = forward ? step : num_k_tiles - 1 - step;
+          const int depth = TileExtent(k, K);
+          PanelSlot& a = Acquire({ 0, i, k }, lhs, rows, depth);
+          a.pinned = true;
+          PanelSlot& b = Acquire({ 1, k, j }, rhs, depth, cols);
+          a.pinned = false;
+
+          std::vector<ocl::Future> dependencies = { a.ready, b.ready };
+          // The slot is only overwritten once its previous tile is
+          // downloaded, without stalling the host on it
+          if (step == 0) {
+            dependencies.push_back(slot.download);
+          }
+          ocl::Kernel& kernel = step == 0 ? *overwrite_kernel_ : *accumulate_kernel_;
+          kernel.SetArguments(rows, cols, depth, a.buffer, b.buffer, slot.buffer);
+          size_t global_work_size[2];
+          config_.GlobalWorkSize(rows, cols, global_work_size);
+          compute = kernel.RunAsync(
+            compute_queue_, 2, nullptr, global_work_size, config_.local_work_size, dependencies
+          );
+          a.last_use = compute;
+          b.last_use = compute;
+        }
+        forward = !forward;
+
+        slot.download = DownloadTile(
+          transfer_queue_, slot.buffer, 0, static_cast<size_t>(rows),
+          result, i * tile_, j * tile_, rows, cols, { compute }
+        );
+        stats_.num_tiles++;
+        stats_.downloaded_bytes += static_cast<double>(rows) * cols * sizeof(float);
+      }
+    }
+
+    for (auto& slot : results_) {
+      RetireResult(*slot);
+    }
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+    stats_.seconds = diff.count();
+  }
+
+private:
+  static constexpr size_t kNumResultSlots = 2;
+
+  /// Panel (row_block, col_block) of lhs (matrix 0) or rhs (matrix 1)
+  struct PanelKey {
+    int matrix = -1;
+    int row_block = 0;
+    int col_block = 0;
+
+    bool operator==(const PanelKey& other) const {
+      return matrix == other.matrix && row_block == other.row_block && col_block == other.col_block;
+    }
+  }; // struct PanelKey
+
+  struct PanelSlot {
+    PanelSlot(const ocl::Context& context, size_t num_elmts) : buffer(context, num_elmts) {}
+
+    ocl::Buffer<float> buffer;
+    PanelKey key;
+    ocl::Future ready;      // upload of the current panel
+    ocl::Future last_use;   // last compute reading it
+    size_t last_used = 0;   // LRU clock
+    bool pinned = false;    // in use by the product being enqueued
+  }; // struct PanelSlot
+
+  struct ResultSlot {
+    ResultSlot(const ocl::Context& context, size_t num_elmts) : buffer(context, num_elmts) {}
+
+    ocl::Buffer<float> buffer;
+    ocl::Future download;   // of its last tile into the result matrix
+  }; // struct ResultSlot
+
+  ocl::CommandQueue transfer_queue_;
+  ocl::CommandQueue compute_queue_;
+  int tile_ = 0;
+  MatmulConfig config_;
+  std::unique_ptr<ocl::Kernel> overwrite_kernel_;
+  std::unique_ptr<ocl::Kernel> accumulate_kernel_;
+  std::vector<std::unique_ptr<PanelSlot>> panels_;
+  std::vector<std::unique_ptr<ResultSlot>> results_;
+  size_t next_result_ = 0;
+  size_t clock_ = 0;
+  OutOfCoreStats stats_;
+
+  int NumTiles(int size) const { return (size + tile_ - 1) / tile_; }
+  int TileExtent(int block, int size) const { return std::min(tile_, size - block * tile_); }
+
+  /// The slot holding panel 'key' (rows x cols) of 'matrix', uploading it
+  /// into the least recently used slot if it is not resident
+  PanelSlot& Acquire(const PanelKey& key, const Matrix& matrix, int rows, int cols) {
+    clock_++;
+    PanelSlot* victim = nullptr;
+    for (auto& slot : panels_) {
+      if (slot->key == key) {
+        slot->last_used = clock_;
+        stats_.num_panel_hits++;
+        return *slot;
+      }
+      if (!slot->pinned && (victim == nullptr || slot->last_used < victim->last_used)) {
+        victim = slot.get();
+      }
+    }
+
+    // The slot is overwritten once the computes reading its old panel are done
+    std::vector<ocl::Future> dependencies;
+    if (victim->last_use.Valid()) {
+      dependencies.push_back(victim->last_use);
+    }
+    const size_t num_elmts = static_cast<size_t>(rows) * cols;
+    victim->ready = UploadTile(
+      transfer_queue_, matrix, key.row_block * tile_, key.col_block * tile_, rows, cols,
+      victim->buffer, 0, static_cast<size_t>(rows), dependencies
+    );
+    victim->key = key;
+    victim->last_used = clock_;
+    stats_.num_panel_loads++;
+    stats_.uploaded_bytes += static_cast<double>(num_elmts) * sizeof(float);
+    return *victim;
+  }
+
+  /// Wait for the download of the last tile computed in 'slot'
+  void RetireResult(ResultSlot& slot) {
+    if (slot.download.Valid()) {
+      slot.download.Wait();
+      slot.download = ocl::Future();
+    }
+  }
+}; // class OutOfCoreGemm
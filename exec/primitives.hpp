@@ -0,0 +1,212 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+
+#include "ocl/ocl.h"
+
+
+/// @brief Operation of DevicePrimitives::Reduce
+enum class ReduceOp {
+  kSum,
+  kMax,
+  kMin
+};
+
+/// @brief Difference of two buffers, from DevicePrimitives::Compare
+struct CompareResult {
+  double mean_abs_error = 0.0;
+  double max_abs_error = 0.0;
+};
+
+
+/// @brief Reductions, prefix scans and buffer comparison on the device, with
+/// the kernels of primitives.cl, for float and int buffers.
+///
+/// Reduce and Compare return host scalars and wait for their result; only
+/// the final scalars are read back. Scan only enqueues its work.
+class DevicePrimitives {
+public:
+  /// @param variants Variants of the primitives.cl program
+  /// @param max_groups Work-groups of the first reduction stage; each group
+  /// strides over the input, so this bounds the partials, not the input
+  explicit DevicePrimitives(const ocl::Context& context,
+                            ocl::KernelVariants& variants,
+                            size_t group_size=256,
+                            size_t max_groups=256)
+    : context_(context),
+      variants_(variants),
+      group_size_(group_size),
+      max_groups_(max_groups) {}
+
+  /// @brief Work-group size of the kernels, and elements per scan block
+  size_t GroupSize() const { return group_size_; }
+
+  /// @brief op over the first n elements of src (0, or the lowest / highest
+  /// value, for n = 0)
+  template <typename T>
+  T Reduce(ocl::CommandQueue& queue, ReduceOp op, int n, const ocl::Buffer<T>& src) {
+    Kernels<T>& kernels = KernelsOf<T>();
+    ocl::Kernel& kernel = op == ReduceOp::kSum ? kernels.reduce_sum
+                        : op == ReduceOp::kMax ? kernels.reduce_max
+                        : kernels.reduce_min;
+
+    int num_groups = static_cast<int>(NumGroups(n));
+    ReduceStage(queue, kernel, n, src, *kernels.partial, static_cast<size_t>(num_groups));
+    ReduceStage(queue, kernel, num_groups, *kernels.partial, *kernels.total, 1);
+    T result = T();
+    kernels.total->CopyFromDevice(queue, &result, 1);
+    return result;
+  }
+
+  /// @brief Mean and maximum of |a[i] - b[i]| over the first n elements,
+  /// in one pass over both buffers
+  CompareResult Compare(ocl::CommandQueue& queue,
+                        int n,
+                        const ocl::Buffer<float>& a,
+                        const ocl::Buffer<float>& b) {
+    Kernels<float>& kernels = KernelsOf<float>();
+    if (!kernels.compare) {
+      kernels.compare.reset(new ocl::Kernel(variants_.Get("compare_reduce", Params<float>())));
+      kernels.partial_max.reset(new ocl::Buffer<float>(context_, max_groups_));
+      kernels.total_max.reset(new ocl::Buffer<float>(context_, 1));
+    }
+
+    int num_groups = static_cast<int>(NumGroups(n));
+    kernels.compare->SetArguments(n, a, b, *kernels.partial, *kernels.partial_max);
+    size_t global_work_size[1] = { num_groups * group_size_ };
+    size_t local_work_size[1] = { group_size_ };
+    kernels.compare->Run(queue, 1, nullptr, global_work_size, local_work_size);
+    ReduceStage(queue, kernels.reduce_sum, num_groups, *kernels.partial, *kernels.total, 1);
+    ReduceStage(queue, kernels.reduce_max, num_groups, *kernels.partial_max, *kernels.total_max, 1);
+
+    float sum = 0.0f, max_diff = 0.0f;
+    kernels.total->CopyFromDevice(queue, &sum, 1);
+    kernels.total_max->CopyFromDevice(queue, &max_diff, 1);
+    CompareResult result;
+    result.mean_abs_error = n > 0 ? static_cast<double>(sum) / n : 0.0;
+    result.max_abs_error = max_diff;
+    return result;
+  }
+
+  /// @brief dst = inclusive (or exclusive) prefix sum of the first n
+  /// elements of src. Blocks of group_size elements are scanned, then the
+  /// scanned block sums are added back, recursing over as many levels as
+  /// needed. src and dst may be the same buffer.
+  template <typename T>
+  ocl::Event Scan(ocl::CommandQueue& queue,
+                  int n,
+                  const ocl::Buffer<T>& src,
+                  ocl::Buffer<T>& dst,
+                  bool exclusive=false) {
+    return ScanLevel(queue, n, src, dst, exclusive, 0);
+  }
+
+private:
+  /// Kernels and scratch buffers of one element type
+  template <typename T>
+  struct Kernels {
+    Kernels(const ocl::Context& context, ocl::KernelVariants& variants,
+            const ocl::VariantParams& params, size_t max_groups)
+      : reduce_sum(variants.Get("reduce_sum", params)),
+        reduce_max(variants.Get("reduce_max", params)),
+        reduce_min(variants.Get("reduce_min", params)),
+        scan_blocks(variants.Get("scan_blocks", params)),
+        scan_add_offsets(variants.Get("scan_add_offsets", params)),
+        partial(new ocl::Buffer<T>(context, max_groups)),
+        total(new ocl::Buffer<T>(context, 1)) {}
+
+    ocl::Kernel reduce_sum;
+    ocl::Kernel reduce_max;
+    ocl::Kernel reduce_min;
+    ocl::Kernel scan_blocks;
+    ocl::Kernel scan_add_offsets;
+    std::unique_ptr<ocl::Buffer<T>> partial;
+    std::unique_ptr<ocl::Buffer<T>> total;
+    // Block sums of each scan level, with their sizes; grown on demand
+    std::vector<std::unique_ptr<ocl::Buffer<T>>> scan_levels;
+    std::vector<size_t> scan_level_sizes;
+    // compare_reduce, float only, created on first use
+    std::unique_ptr<ocl::Kernel> compare;
+    std::unique_ptr<ocl::Buffer<T>> partial_max;
+    std::unique_ptr<ocl::Buffer<T>> total_max;
+  }; // struct Kernels
+
+  ocl::Context context_;
+  ocl::KernelVariants& variants_;
+  size_t group_size_;
+  size_t max_groups_;
+  std::unique_ptr<Kernels<float>> float_kernels_;
+  std::unique_ptr<Kernels<int>> int_kernels_;
+
+  template <typename T>
+  ocl::VariantParams Params() const {
+    return {
+      {"REDUCE_GROUP_SIZE", static_cast<long>(group_size_)},
+      {"SCAN_GROUP_SIZE", static_cast<long>(group_size_)},
+      {"PRIMITIVE_INT", std::is_same<T, int>::value ? 1L : 0L}
+    };
+  }
+
+  /// The programs of a type are only built when it is first used
+  template <typename T>
+  Kernels<T>& KernelsOf() {
+    static_assert(std::is_same<T, float>::value || std::is_same<T, int>::value,
+                  "DevicePrimitives: only float and int buffers are supported.");
+    std::unique_ptr<Kernels<T>>& kernels = KernelsSlot(static_cast<T*>(nullptr));
+    if (!kernels) {
+      kernels.reset(new Kernels<T>(context_, variants_, Params<T>(), max_groups_));
+    }
+    return *kernels;
+  }
+
+  std::unique_ptr<Kernels<float>>& KernelsSlot(float*) { return float_kernels_; }
+  std::unique_ptr<Kernels<int>>& KernelsSlot(int*) { return int_kernels_; }
+
+  size_t NumGroups(int n) const {
+    const size_t groups = (static_cast<size_t>(std::max(n, 0)) + group_size_ - 1) / group_size_;
+    return std::max<size_t>(1, std::min(groups, max_groups_));
+  }
+
+  template <typename T>
+  void ReduceStage(ocl::CommandQueue& queue, ocl::Kernel& kernel, int n,
+                   const ocl::Buffer<T>& src, ocl::Buffer<T>& dst, size_t num_groups) {
+    kernel.SetArguments(n, src, dst);
+    size_t global_work_size[1] = { num_groups * group_size_ };
+    size_t local_work_size[1] = { group_size_ };
+    kernel.Run(queue, 1, nullptr, global_work_size, local_work_size);
+  }
+
+  template <typename T>
+  ocl::Event ScanLevel(ocl::CommandQueue& queue, int n,
+                       const ocl::Buffer<T>& src, ocl::Buffer<T>& dst,
+                       bool exclusive, size_t level) {
+    Kernels<T>& kernels = KernelsOf<T>();
+    const size_t num_blocks = std::max<size_t>(1, (static_cast<size_t>(std::max(n, 0)) + group_size_ - 1) / group_size_);
+    if (kernels.scan_levels.size() <= level) {
+      kernels.scan_levels.resize(level + 1);
+      kernels.scan_level_sizes.resize(level + 1, 0);
+    }
+    if (kernels.scan_level_sizes[level] < num_blocks) {
+      kernels.scan_levels[level].reset(new ocl::Buffer<T>(context_, num_blocks));
+      kernels.scan_level_sizes[level] = num_blocks;
+    }
+    ocl::Buffer<T>& block_sums = *kernels.scan_levels[level];
+
+    int exclusive_flag = exclusive ? 1 : 0;
+    kernels.scan_blocks.SetArguments(n, exclusive_flag, src, dst, block_sums);
+    size_t global_work_size[1] = { num_blocks * group_size_ };
+    size_t local_work_size[1] = { group_size_ };
+    ocl::Event event = kernels.scan_blocks.Run(queue, 1, nullptr, global_work_size, local_work_size);
+    if (num_blocks == 1) {
+      return event;
+    }
+
+    // Block offsets: exclusive scan of the block sums, in place; the
+    // in-order queue orders the levels
+    int num_sums = static_cast<int>(num_blocks);
+    ScanLevel(queue, num_sums, block_sums, block_sums, true, level + 1);
+    kernels.scan_add_offsets.SetArguments(n, block_sums, dst);
+    return kernels.scan_add_offsets.Run(queue, 1, nullptr, global_work_size, local_work_size);
+  }
+}; // class DevicePrimitives
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "benchmark.hpp"
+#include "primitives.hpp"
+
+using namespace ocl;
+
+
+/// Small integers, so that float sums are exact and must match bit for bit
+template <typename T>
+std::vector<T> RandomElements(int n, std::mt19937& generator) {
+  std::uniform_int_distribution<int> distribution(-8, 8);
+  std::vector<T> elements(n);
+  for (T& element : elements) {
+    element = static_cast<T>(distribution(generator));
+  }
+  return elements;
+}
+
+/// Check Reduce (sum, max, min) and Scan (inclusive, exclusive) on T
+/// against std::accumulate, std::max_element / std::min_element and
+/// std::partial_sum
+template <typename T>
+bool CheckPrimitives(bench::Environment& env, const std::string& type_name) {
+  DevicePrimitives& primitives = env.Primitives();
+  // Sizes around a block, not multiples of it, and beyond group_size^2 so
+  // that the scan recurses over three levels
+  const size_t group_size = primitives.GroupSize();
+  const int sizes[] = {
+    1, 7, static_cast<int>(group_size) - 1, static_cast<int>(group_size) + 1, 1000,
+    static_cast<int>(group_size * group_size) + 3, static_cast<int>(group_size * group_size * 4) + 11
+  };
+  std::mt19937 generator(1);
+  bool ok = true;
+  for (int n : sizes) {
+    const std::vector<T> src = RandomElements<T>(n, generator);
+    Buffer<T> device_src(env.context, src.size());
+    Buffer<T> device_dst(env.context, src.size());
+    device_src.CopyFromHost(env.queue, src.data(), src.size());
+
+    const T sum = primitives.Reduce(env.queue, ReduceOp::kSum, n, device_src);
+    const T max = primitives.Reduce(env.queue, ReduceOp::kMax, n, device_src);
+    const T min = primitives.Reduce(env.queue, ReduceOp::kMin, n, device_src);
+    const bool reduce_ok = sum == std::accumulate(src.begin(), src.end(), T())
+                        && max == *std::max_element(src.begin(), src.end())
+                        && min == *std::min_element(src.begin(), src.end());
+
+    std::vector<T> inclusive(src.size()), exclusive(src.size(), T()), scanned(src.size());
+    std::partial_sum(src.begin(), src.end(), inclusive.begin());
+    std::copy(inclusive.begin(), inclusive.end() - 1, exclusive.begin() + 1);
+    primitives.Scan(env.queue, n, device_src, device_dst).Wait();
+    device_dst.CopyFromDevice(env.queue, scanned.data(), scanned.size());
+    bool scan_ok = scanned == inclusive;
+    // In place, as the block sums of the upper levels are scanned
+    primitives.Scan(env.queue, n, device_src, device_src, true).Wait();
+    device_src.CopyFromDevice(env.queue, scanned.data(), scanned.size());
+    scan_ok = scan_ok && scanned == exclusive;
+
+    std::cout << "n=" << n << " (" << type_name << "): reduce " << (reduce_ok ? "ok" : "FAILED")
+              << ", scan " << (scan_ok ? "ok" : "FAILED") << std::endl;
+    ok = ok && reduce_ok && scan_ok;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <kernel dir>" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  bench::Environment env(
+    SelectDevice(DeviceCriteria::FromEnvironment()),
+    kernel_dir,
+    cache_dir != nullptr ? cache_dir : ".ocl_program_cache",
+    tuning_db != nullptr ? tuning_db : "matmul_tuning.db"
+  );
+  std::cout << "Device: " << env.device.Name() << std::endl << std::endl;
+
+  bool ok = CheckPrimitives<int>(env, "int");
+  ok = CheckPrimitives<float>(env, "float") && ok;
+  std::cout << std::endl << (ok ? "All checks passed." : "Some checks FAILED.") << std::endl;
+  return ok ? 0 : 1;
+}
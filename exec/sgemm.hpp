@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "ocl/ocl.h"
+#include "matmul_tuner.hpp"
+
+
+/// @brief Whether a GEMM operand is used as stored or transposed
+enum class Transpose {
+  kNo,
+  kYes
+};
+
+
+/// @brief BLAS-style GEMM on column-major float buffers, with the kernel of
+/// sgemm.cl.
+///
+/// Sgemm computes C = alpha * op(A) * op(B) + beta * C in place, reading
+/// transposed operands where they are and honouring leading dimensions, so
+/// callers never materialize transposes, scaled copies or packed
+/// sub-matrices (a sub-matrix that does not start at element 0 can be
+/// passed as a sub-buffer view). Each combination of transposes and of the
+/// alpha == 1 / beta == 0 / beta == 1 special cases is its own kernel
+/// variant, built on first use; with beta == 0, C is not read at all.
+class Blas {
+public:
+  /// @param variants Variants of the sgemm.cl program
+  /// @param tuner Tuner of matmul.cl, whose matmul_v3 configurations set the
+  /// tiling of sgemm
+  explicit Blas(ocl::KernelVariants& variants, MatmulTuner& tuner)
+    : variants_(variants), tuner_(tuner) {}
+
+  /// @brief C = alpha * op(A) * op(B) + beta * C, with op(A) M x K, op(B)
+  /// K x N and C M x N. Only enqueues the work, after 'dependencies'.
+  /// As in BLAS, A and B are not read when alpha == 0 or K == 0, and C
+  /// is not read when beta == 0. Throws if a buffer is smaller than the
+  /// matrix it is read or written as.
+  ocl::Future Sgemm(ocl::CommandQueue& queue,
+                    Transpose trans_a,
+                    Transpose trans_b,
+                    int M, int N, int K,
+                    float alpha,
+                    const ocl::Buffer<float>& A, int lda,
+                    const ocl::Buffer<float>& B, int ldb,
+                    float beta,
+                    ocl::Buffer<float>& C, int ldc,
+                    const std::vector<ocl::Future>& dependencies={}) {
+    const bool transposed_a = trans_a == Transpose::kYes;
+    const bool transposed_b = trans_b == Transpose::kYes;
+    if (M < 0 || N < 0 || K < 0) {
+      throw std::runtime_error("Sgemm: M, N and K must not be negative.");
+    }
+    CheckLeadingDimension("lda", lda, transposed_a ? K : M);
+    CheckLeadingDimension("ldb", ldb, transposed_b ? N : K);
+    CheckLeadingDimension("ldc", ldc, M);
+
+    // Nothing to compute: C is left as is
+    if (M == 0 || N == 0 || ((alpha == 0.0f || K == 0) && beta == 1.0f)) {
+      return ocl::WhenAll(queue, dependencies);
+    }
+    // Only C = beta * C remains; the K loop is skipped
+    if (alpha == 0.0f) {
+      K = 0;
+    }
+    // Every buffer the kernel reads or writes must hold its stored matrix
+    if (K > 0) {
+      CheckExtent("A", A, transposed_a ? K : M, transposed_a ? M : K, lda);
+      CheckExtent("B", B, transposed_b ? N : K, transposed_b ? K : N, ldb);
+    }
+    CheckExtent("C", C, M, N, ldc);
+
+    const MatmulConfig& config = Config(M, N, K);
+    ocl::VariantParams params = config.Params();
+    params["TRANS_A"] = transposed_a ? 1 : 0;
+    params["TRANS_B"] = transposed_b ? 1 : 0;
+    params["ALPHA_ONE"] = alpha == 1.0f ? 1 : 0;
+    params["BETA_MODE"] = beta == 0.0f ? 0 : beta == 1.0f ? 1 : 2;
+    ocl::Kernel& kernel = KernelOf(params);
+
+    kernel.SetArguments(M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+    size_t global_work_size[2];
+    config.GlobalWorkSize(M, N, global_work_size);
+    return kernel.RunAsync(queue, 2, nullptr, global_work_size, config.local_work_size, dependencies);
+  }
+
+private:
+  ocl::KernelVariants& variants_;
+  MatmulTuner& tuner_;
+  MatmulConfig config_;
+  int config_shape_[3] = { -1, -1, -1 };
+  std::map<ocl::VariantParams, std::unique_ptr<ocl::Kernel>> kernels_;
+
+  /// Tuned matmul_v3 configuration of the last shape; the tuner buckets
+  /// shapes, so repeated calls of one shape do not look it up again
+  const MatmulConfig& Config(int M, int N, int K) {
+    // K == 0 (C = beta * C) tiles like any other depth
+    K = std::max(K, 1);
+    if (config_shape_[0] != M || config_shape_[1] != N || config_shape_[2] != K) {
+      config_ = tuner_.Get("matmul_v3", M, N, K);
+      config_shape_[0] = M;
+      config_shape_[1] = N;
+      config_shape_[2] = K;
+    }
+    return config_;
+  }
+
+  ocl::Kernel& KernelOf(const ocl::VariantParams& params) {
+    auto it = kernels_.find(params);
+    if (it == kernels_.end()) {
+      std::unique_ptr<ocl::Kernel> kernel(new ocl::Kernel(variants_.Get("sgemm", params)));
+      it = kernels_.emplace(params, std::move(kernel)).first;
+    }
+    return *it->second;
+  }
+
+  static void CheckLeadingDimension(const char* name, int ld, int rows) {
+    if (ld < std::max(1, rows)) {
+      throw std::runtime_error(std::string("Sgemm: ") + name + " must be at least "
+                               + std::to_string(std::max(1, rows)) + ".");
+    }
+  }
+
+  /// A rows x cols matrix with leading dimension ld ends at element
+  /// ld * (cols - 1) + rows of its buffer
+  static void CheckExtent(const char* name, const ocl::Buffer<float>& buffer,
+                          int rows, int cols, int ld) {
+    const size_t extent = static_cast<size_t>(ld) * (cols - 1) + rows;
+    if (extent > buffer.NumElmts()) {
+      throw std::runtime_error(std::string("Sgemm: ") + name + " needs " + std::to_string(extent)
+                               + " elements, its buffer holds " + std::to_string(buffer.NumElmts()) + ".");
+    }
+  }
+}; // class Blas
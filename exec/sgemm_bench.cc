@@ -0,0 +1,181 @@
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "matmul_cpu.hpp"
+#include "benchmark.hpp"
+#include "sgemm.hpp"
+
+using namespace ocl;
+
+
+/// rows x cols matrix stored with leading dimension ld >= rows, random
+/// elements in the rows and NaNs in the padding, which must never be read
+std::vector<float> RandomPadded(int rows, int cols, int ld, std::mt19937& generator) {
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  std::vector<float> data(static_cast<size_t>(ld) * cols, std::numeric_limits<float>::quiet_NaN());
+  for (int c = 0; c < cols; c++) {
+    for (int r = 0; r < rows; r++) {
+      data[r + static_cast<size_t>(c) * ld] = distribution(generator);
+    }
+  }
+  return data;
+}
+
+/// op(X) as a packed column-major Matrix
+Matrix Operand(const std::vector<float>& data, int rows, int cols, int ld, bool transposed) {
+  Matrix matrix(transposed ? cols : rows, transposed ? rows : cols);
+  for (int c = 0; c < cols; c++) {
+    for (int r = 0; r < rows; r++) {
+      const float value = data[r + static_cast<size_t>(c) * ld];
+      if (transposed) {
+        matrix(c, r) = value;
+      } else {
+        matrix(r, c) = value;
+      }
+    }
+  }
+  return matrix;
+}
+
+/// Time and check every transpose and scaling of Blas::Sgemm for one
+/// shape; false if a result is off or the padding of C was written
+bool RunShape(bench::Environment& env, Blas& blas, int M, int N, int K, size_t num_repeats) {
+  // Stored shapes cover every transpose; the NaN padding checks the
+  // leading dimensions, and C is padded as well
+  std::mt19937 generator(1);
+  const int max_dim = std::max(M, K);
+  const int lda = max_dim + 16, ldb = std::max(K, N) + 16, ldc = M + 8;
+  const std::vector<float> a = RandomPadded(max_dim, max_dim, lda, generator);
+  const std::vector<float> b = RandomPadded(std::max(K, N), std::max(K, N), ldb, generator);
+  const std::vector<float> c0 = RandomPadded(M, N, ldc, generator);
+  // With beta == 0, C is never read: its NaNs must not reach the result
+  const std::vector<float> nan_c(c0.size(), std::numeric_limits<float>::quiet_NaN());
+
+  Buffer<float> device_a(env.context, a.size());
+  Buffer<float> device_b(env.context, b.size());
+  Buffer<float> device_c(env.context, c0.size());
+  device_a.CopyFromHost(env.queue, a.data(), a.size());
+  device_b.CopyFromHost(env.queue, b.data(), b.size());
+
+  std::cout << "M=" << M << " N=" << N << " K=" << K << std::endl
+            << std::left << std::setw(8) << "op"
+            << std::setw(16) << "alpha, beta"
+            << std::right << std::setw(12) << "time(ms)"
+            << std::setw(11) << "GFLOP/s"
+            << std::setw(12) << "err." << std::endl;
+
+  // The last ones take the early outs: alpha == 0 or K == 0 leave C
+  // (scaled by beta) without reading A and B, and with beta == 1 nothing
+  // is enqueued at all
+  struct Scaling {
+    float alpha;
+    float beta;
+    bool empty;  // K = 0
+  };
+  const Scaling scalings[] = {
+    {1.0f, 0.0f, false}, {1.0f, 1.0f, false}, {-0.5f, 0.0f, false}, {0.5f, 2.0f, false},
+    {0.0f, 1.0f, false}, {0.0f, 0.5f, false}, {0.0f, 0.0f, false}, {1.0f, 1.0f, true}, {1.0f, 2.0f, true}
+  };
+  bool ok = true;
+  std::vector<float> c(c0.size());
+  for (Transpose trans_a : { Transpose::kNo, Transpose::kYes }) {
+    for (Transpose trans_b : { Transpose::kNo, Transpose::kYes }) {
+      const bool ta = trans_a == Transpose::kYes, tb = trans_b == Transpose::kYes;
+      Matrix product(M, N);
+      matmul_cpu(Operand(a, ta ? K : M, ta ? M : K, lda, ta),
+                 Operand(b, tb ? N : K, tb ? K : N, ldb, tb), product);
+
+      for (const Scaling& scaling : scalings) {
+        const float alpha = scaling.alpha, beta = scaling.beta;
+        const int depth = scaling.empty ? 0 : K;
+        const bool multiplies = alpha != 0.0f && depth > 0;
+        const std::vector<float>& initial = beta != 0.0f ? c0 : nan_c;
+
+        // Each run starts from the initial C, so the check sees a single update
+        double best = std::numeric_limits<double>::max();
+        for (size_t n = 0; n < num_repeats + 1; n++) {
+          device_c.CopyFromHost(env.queue, initial.data(), initial.size());
+          Future run = blas.Sgemm(env.queue, trans_a, trans_b, M, N, depth,
+                                  alpha, device_a, lda, device_b, ldb, beta, device_c, ldc);
+          run.Wait();
+          if (n > 0) {
+            best = std::min(best, run.GetEvent().Duration());
+          }
+        }
+
+        // The M x N result against the host, and the padding of C untouched
+        device_c.CopyFromDevice(env.queue, c.data(), c.size());
+        double error = 0.0;
+        bool padding_kept = true;
+        for (int col = 0; col < N; col++) {
+          for (int row = 0; row < ldc; row++) {
+            const size_t index = row + static_cast<size_t>(col) * ldc;
+            if (row >= M) {
+              padding_kept = padding_kept && std::isnan(c[index]);
+              continue;
+            }
+            const float expected = (multiplies ? alpha * product(row, col) : 0.0f)
+                                 + (beta != 0.0f ? beta * c0[index] : 0.0f);
+            error += std::abs(c[index] - expected);
+          }
+        }
+        error /= static_cast<double>(M) * N;
+        // Rounding of float sums grows with their length
+        const bool passed = padding_kept && error <= 1e-6 * (depth + 1);
+        ok = ok && passed;
+
+        const double flops = multiplies ? 2.0 * M * N * depth : 0.0;
+        std::ostringstream op, scaling_name;
+        op << (ta ? "T" : "N") << (tb ? "T" : "N");
+        scaling_name << alpha << ", " << beta << (scaling.empty ? " (K=0)" : "");
+        std::cout << std::left << std::setw(8) << op.str()
+                  << std::setw(16) << scaling_name.str()
+                  << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << best * 1e3
+                  << std::setprecision(2)
+                  << std::setw(11) << (best > 0.0 ? flops / best * 1e-9 : 0.0)
+                  << std::scientific << std::setprecision(2)
+                  << std::setw(12) << error
+                  << std::defaultfloat
+                  << (passed ? "" : padding_kept ? "  FAILED" : "  FAILED, padding of C overwritten")
+                  << std::endl;
+      }
+    }
+  }
+  std::cout << std::endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <kernel dir> [M] [N] [K] [repeats]" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+  const int M = argc > 2 ? std::stoi(argv[2]) : 1024;
+  const int N = argc > 3 ? std::stoi(argv[3]) : 1024;
+  const int K = argc > 4 ? std::stoi(argv[4]) : 1024;
+  const size_t num_repeats = argc > 5 ? std::stoul(argv[5]) : 10;
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  bench::Environment env(
+    SelectDevice(DeviceCriteria::FromEnvironment()),
+    kernel_dir,
+    cache_dir != nullptr ? cache_dir : ".ocl_program_cache",
+    tuning_db != nullptr ? tuning_db : "matmul_tuning.db"
+  );
+  Blas blas(env.Variants("sgemm.cl"), env.Tuner());
+  std::cout << "Device: " << env.device.Name() << std::endl << std::endl;
+
+  bool ok = RunShape(env, blas, M, N, K, num_repeats);
+  // Not a multiple of any tile: the edge tiles and store guards run too
+  ok = RunShape(env, blas, 131, 77, 259, num_repeats) && ok;
+  return ok ? 0 : 1;
+}
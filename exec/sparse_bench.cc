@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include "ocl/ocl.h"
+#include "utils.hpp"
+#include "matrix.hpp"
+#include "benchmark.hpp"
+#include "sparse_gemm.hpp"
+
+using namespace ocl;
+
+
+// Best kernel time of 'num_repeats' runs of 'enqueue', after one warmup run.
+// 'enqueue' returns an Event or a SparseLaunch, which spans every kernel of
+// the product (the merge pass and its fixup)
+template <typename Function>
+double BestTime(size_t num_repeats, Function enqueue) {
+  double best = std::numeric_limits<double>::max();
+  for (size_t n = 0; n < num_repeats + 1; n++) {
+    const auto run = enqueue();
+    run.Wait();
+    if (n > 0) {
+      best = std::min(best, run.Duration());
+    }
+  }
+  return best;
+}
+
+void PrintRow(const std::string& matrix, const std::string& kernel, double seconds,
+              double flops, double error, bool chosen) {
+  std::cout << std::left << std::setw(22) << matrix
+            << std::setw(14) << kernel
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << seconds * 1e3
+            << std::setprecision(2)
+            << std::setw(11) << flops / seconds * 1e-9
+            << std::scientific << std::setprecision(2)
+            << std::setw(12) << error
+            << (chosen ? "  <- auto" : "")
+            << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <kernel dir> [size] [columns] [repeats]" << std::endl;
+    return 1;
+  }
+  const std::string kernel_dir = argv[1];
+  const int size = argc > 2 ? std::stoi(argv[2]) : 2048;
+  const int n = argc > 3 ? std::stoi(argv[3]) : 1;
+  const size_t num_repeats = argc > 4 ? std::stoul(argv[4]) : 10;
+  const int ell_slice_size = 32;
+
+  const char* cache_dir = getenv("OCL_PROGRAM_CACHE_DIR");
+  const char* tuning_db = getenv("OCL_TUNING_DB");
+  bench::Environment env(
+    SelectDevice(DeviceCriteria::FromEnvironment()),
+    kernel_dir,
+    cache_dir != nullptr ? cache_dir : ".ocl_program_cache",
+    tuning_db != nullptr ? tuning_db : "matmul_tuning.db"
+  );
+  SparseGemm sparse_gemm(env.context, env.Variants("sparse.cl"));
+  std::cout << "Device: " << env.device.Name() << ", " << size << "x" << size
+            << " times " << size << "x" << n << std::endl << std::endl;
+
+  Matrix x(size, n);
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  for (size_t i = 0; i < x.NumElmts(); i++) {
+    x.RawPtr()[i] = distribution(generator);
+  }
+  Buffer<float> device_x(env.context, x.NumElmts());
+  Buffer<float> device_y(env.context, static_cast<size_t>(size) * n);
+  Buffer<float> device_reference(env.context, static_cast<size_t>(size) * n);
+  device_x.CopyFromHost(env.queue, x.RawPtr(), x.NumElmts());
+
+  // The dense path: tuned matmul_v3 on the densified matrix
+  const MatmulConfig dense_config = env.Tuner().Get("matmul_v3", size, n, size);
+  Kernel dense_kernel = env.Variants("matmul.cl").Get("matmul_v3", dense_config.Params());
+  Buffer<float> device_dense(env.context, static_cast<size_t>(size) * size);
+
+  std::cout << std::left << std::setw(22) << "matrix"
+            << std::setw(14) << "kernel"
+            << std::right << std::setw(12) << "time(ms)"
+            << std::setw(11) << "GFLOP/s"
+            << std::setw(12) << "err." << std::endl;
+
+  const SparseKernel kernels[] = {
+    SparseKernel::kCsrScalar, SparseKernel::kCsrVector, SparseKernel::kCsrMerge, SparseKernel::kEll
+  };
+  for (double density : { 0.001, 0.01, 0.05, 0.2 }) {
+    for (bool power_law : { false, true }) {
+      const CsrMatrix csr = CsrMatrix::Random(size, size, density, power_law);
+      std::ostringstream name;
+      name << std::setprecision(3) << csr.Density() * 100 << "% " << (power_law ? "power-law" : "uniform");
+
+      Matrix reference;
+      csr.Multiply(x, reference);
+      device_reference.CopyFromHost(env.queue, reference.RawPtr(), reference.NumElmts());
+      auto error = [&]() {
+        return env.Primitives().Compare(env.queue, reference.NumElmts(), device_y, device_reference)
+          .mean_abs_error;
+      };
+
+      // Useful work only: padding and the zeros of the dense path are not counted
+      const double flops = 2.0 * csr.NumNonZeros() * n;
+      const SparseKernel chosen = ChooseSparseKernel(csr, ell_slice_size);
+      DeviceSparseMatrix a(env.context, env.queue, csr, BufferMode::kDevice, ell_slice_size);
+      for (SparseKernel kernel : kernels) {
+        const double seconds = BestTime(num_repeats, [&] {
+          return sparse_gemm.Multiply(env.queue, a, n, device_x, device_y, kernel);
+        });
+        PrintRow(name.str(), SparseKernelName(kernel), seconds, flops, error(), kernel == chosen);
+      }
+
+      const Matrix dense = csr.ToDense();
+      device_dense.CopyFromHost(env.queue, dense.RawPtr(), dense.NumElmts());
+      int M = size, N = n, K = size;
+      dense_kernel.SetArguments(M, N, K, device_dense, device_x, device_y);
+      size_t global_work_size[2];
+      dense_config.GlobalWorkSize(M, N, global_work_size);
+      const double seconds = BestTime(num_repeats, [&] {
+        return dense_kernel.Run(env.queue, 2, nullptr, global_work_size, dense_config.local_work_size);
+      });
+      PrintRow(name.str(), "dense_v3", seconds, flops, error(), false);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <memory>
+
+#include "ocl/ocl.h"
+#include "sparse_matrix.hpp"
+
+
+/// @brief Kernels of sparse.cl
+enum class SparseKernel {
+  kCsrScalar,   // one work-item per row
+  kCsrVector,   // VECTOR_SIZE work-items per row
+  kCsrMerge,    // merge path, even work per work-item
+  kEll          // sliced ELLPACK, one work-item per row
+};
+
+inline const char* SparseKernelName(SparseKernel kernel) {
+  switch (kernel) {
+    case SparseKernel::kCsrVector: return "csr_vector";
+    case SparseKernel::kCsrMerge: return "csr_merge";
+    case SparseKernel::kEll: return "ell";
+    default: return "csr_scalar";
+  }
+}
+
+/// @brief Pick the kernel from the row length distribution.
+///
+/// Skewed rows (coefficient of variation above 1, or a row 16 times the
+/// mean) leave most work-items of the row-based kernels idle, so they go
+/// to the merge path. Long even rows are split over the lanes of
+/// csr_vector. Short even rows go to ELL when its padding is small
+/// ('ell_efficiency', non-zeros over stored entries), else to csr_scalar.
+inline SparseKernel ChooseSparseKernel(const RowStatistics& stats, double ell_efficiency) {
+  if (stats.Variation() > 1.0 || stats.max_length > 16.0 * std::max(1.0, stats.mean_length)) {
+    return SparseKernel::kCsrMerge;
+  }
+  if (stats.mean_length >= 16.0) {
+    return SparseKernel::kCsrVector;
+  }
+  if (ell_efficiency >= 0.7) {
+    return SparseKernel::kEll;
+  }
+  return SparseKernel::kCsrScalar;
+}
+
+inline SparseKernel ChooseSparseKernel(const CsrMatrix& csr, int ell_slice_size=32) {
+  const RowStatistics stats = csr.Statistics();
+  if (stats.Variation() > 1.0 || stats.mean_length >= 16.0) {
+    // ELL is not a candidate, skip building it
+    return ChooseSparseKernel(stats, 0.0);
+  }
+  return ChooseSparseKernel(stats, EllMatrix::FromCsr(csr, ell_slice_size).Efficiency());
+}
+
+
+/// @brief A CsrMatrix on the device, and its sliced ELL copy if asked for.
+///
+/// With BufferMode::kUseHostPtr the CSR buffers wrap the (page aligned)
+/// arrays of the host matrix instead of copying them, which is free on CPU
+/// and integrated GPU devices; the host matrix must then outlive this one.
+class DeviceSparseMatrix {
+public:
+  explicit DeviceSparseMatrix(const ocl::Context& context,
+                              ocl::CommandQueue& queue,
+                              const CsrMatrix& csr,
+                              ocl::BufferMode mode=ocl::BufferMode::kDevice,
+                              int ell_slice_size=0)
+    : rows_(csr.Rows()), cols_(csr.Cols()), num_non_zeros_(csr.NumNonZeros()),
+      stats_(csr.Statistics()) {
+    row_offsets_ = Upload(context, queue, csr.RowOffsets(), mode);
+    col_indices_ = Upload(context, queue, csr.ColIndices(), mode);
+    values_ = Upload(context, queue, csr.Values(), mode);
+    if (ell_slice_size > 0) {
+      // The ELL arrays are built here, so they are always copied
+      EllMatrix ell = EllMatrix::FromCsr(csr, ell_slice_size);
+      ell_slice_size_ = ell_slice_size;
+      ell_efficiency_ = ell.Efficiency();
+      ell_slice_offsets_ = Upload(context, queue, ell.SliceOffsets(), ocl::BufferMode::kDevice);
+      ell_col_indices_ = Upload(context, queue, ell.ColIndices(), ocl::BufferMode::kDevice);
+      ell_values_ = Upload(context, queue, ell.Values(), ocl::BufferMode::kDevice);
+    }
+  }
+
+  int Rows() const { return rows_; }
+  int Cols() const { return cols_; }
+  int NumNonZeros() const { return num_non_zeros_; }
+  const RowStatistics& Statistics() const { return stats_; }
+  bool HasEll() const { return ell_slice_size_ > 0; }
+  int EllSliceSize() const { return ell_slice_size_; }
+  double EllEfficiency() const { return ell_efficiency_; }
+
+  const ocl::Buffer<int>& RowOffsets() const { return *row_offsets_; }
+  const ocl::Buffer<int>& ColIndices() const { return *col_indices_; }
+  const ocl::Buffer<float>& Values() const { return *values_; }
+  const ocl::Buffer<int>& EllSliceOffsets() const { return *ell_slice_offsets_; }
+  const ocl::Buffer<int>& EllColIndices() const { return *ell_col_indices_; }
+  const ocl::Buffer<float>& EllValues() const { return *ell_values_; }
+
+private:
+  int rows_;
+  int cols_;
+  int num_non_zeros_;
+  RowStatistics stats_;
+  int ell_slice_size_ = 0;
+  double ell_efficiency_ = 1.0;
+  std::unique_ptr<ocl::Buffer<int>> row_offsets_;
+  std::unique_ptr<ocl::Buffer<int>> col_indices_;
+  std::unique_ptr<ocl::Buffer<float>> values_;
+  std::unique_ptr<ocl::Buffer<int>> ell_slice_offsets_;
+  std::unique_ptr<ocl::Buffer<int>> ell_col_indices_;
+  std::unique_ptr<ocl::Buffer<float>> ell_values_;
+
+  template <typename T>
+  static std::unique_ptr<ocl::Buffer<T>> Upload(const ocl::Context& context,
+                                                ocl::CommandQueue& queue,
+                                                const CsrMatrix::Array<T>& array,
+                                                ocl::BufferMode mode) {
+    // Zero sized buffers are invalid; an empty matrix still gets one element
+    const size_t num_elmts = std::max<size_t>(1, array.size());
+    if (mode == ocl::BufferMode::kUseHostPtr && !array.empty()) {
+      // Read-only to the kernels, so wrapping const host data is safe
+      return std::unique_ptr<ocl::Buffer<T>>(new ocl::Buffer<T>(
+        context, array.size(), mode, const_cast<T*>(array.data()), CL_MEM_READ_ONLY
+      ));
+    }
+    std::unique_ptr<ocl::Buffer<T>> buffer(new ocl::Buffer<T>(
+      context, num_elmts, mode == ocl::BufferMode::kAllocHostPtr ? mode : ocl::BufferMode::kDevice
+    ));
+    if (!array.empty()) {
+      buffer->CopyFromHost(queue, array.data(), array.size());
+    }
+    return buffer;
+  }
+}; // class DeviceSparseMatrix
+
+
+/// @brief Kernels one SparseGemm::Multiply enqueued on an in-order queue:
+/// a single launch, or the merge pass followed by its fixup
+struct SparseLaunch {
+  ocl::Event first;
+  ocl::Event last;
+
+  explicit SparseLaunch(ocl::Event event) : first(event), last(event) {}
+  SparseLaunch(ocl::Event first, ocl::Event last) : first(first), last(last) {}
+
+  /// @brief Block until every kernel of the product has completed
+  void Wait() const { last.Wait(); }
+
+  /// @brief Device time from the start of the first kernel to the end of
+  /// the last one, in seconds
+  double Duration() const {
+    const cl_ulong start = first.StartTime(), end = last.EndTime();
+    return end > start ? static_cast<double>(end - start) * 1e-9 : 0.0;
+  }
+}; // struct SparseLaunch
+
+
+/// @brief Sparse times dense products Y = A * X with the kernels of
+/// sparse.cl. X (A.Cols() x n) and Y (A.Rows() x n) are column-major; SpMV
+/// is n = 1. Every call only enqueues work; wait on the returned launch.
+class SparseGemm {
+public:
+  /// @param variants Variants of the sparse.cl program
+  explicit SparseGemm(const ocl::Context& context,
+                      ocl::KernelVariants& variants,
+                      size_t vector_size=8,
+                      size_t vector_group_size=128,
+                      size_t items_per_thread=16)
+    : context_(context),
+      vector_size_(vector_size),
+      vector_group_size_(vector_group_size),
+      items_per_thread_(items_per_thread) {
+    const ocl::VariantParams params = {
+      {"VECTOR_SIZE", static_cast<long>(vector_size)},
+      {"VECTOR_GROUP_SIZE", static_cast<long>(vector_group_size)},
+      {"ITEMS_PER_THREAD", static_cast<long>(items_per_thread)}
+    };
+    scalar_.reset(new ocl::Kernel(variants.Get("spmm_csr_scalar", params)));
+    vector_.reset(new ocl::Kernel(variants.Get("spmm_csr_vector", params)));
+    merge_.reset(new ocl::Kernel(variants.Get("spmm_csr_merge", params)));
+    fixup_.reset(new ocl::Kernel(variants.Get("spmm_merge_fixup", params)));
+    ell_.reset(new ocl::Kernel(variants.Get("spmm_ell", params)));
+  }
+
+  /// @brief y = a * x with the kernel ChooseSparseKernel picks for 'a'
+  SparseLaunch Multiply(ocl::CommandQueue& queue,
+                        const DeviceSparseMatrix& a,
+                        int n,
+                        const ocl::Buffer<float>& x,
+                        ocl::Buffer<float>& y) {
+    const double ell_efficiency = a.HasEll() ? a.EllEfficiency() : 0.0;
+    return Multiply(queue, a, n, x, y, ChooseSparseKernel(a.Statistics(), ell_efficiency));
+  }
+
+  /// @brief y = a * x with 'kernel'; kEll needs a matrix uploaded with an
+  /// ELL copy
+  SparseLaunch Multiply(ocl::CommandQueue& queue,
+                        const DeviceSparseMatrix& a,
+                        int n,
+                        const ocl::Buffer<float>& x,
+                        ocl::Buffer<float>& y,
+                        SparseKernel kernel) {
+    int rows = a.Rows();
+    int cols = a.Cols();
+    const size_t num_cols = static_cast<size_t>(n);
+
+    switch (kernel) {
+      case SparseKernel::kCsrVector: {
+        vector_->SetArguments(rows, cols, n, a.RowOffsets(), a.ColIndices(), a.Values(), x, y);
+        size_t global_work_size[2] = { RoundUp(rows * vector_size_, vector_group_size_), num_cols };
+        size_t local_work_size[2] = { vector_group_size_, 1 };
+        return SparseLaunch(vector_->Run(queue, 2, nullptr, global_work_size, local_work_size));
+      }
+      case SparseKernel::kCsrMerge: {
+        int num_threads = static_cast<int>(
+          RoundUp(static_cast<size_t>(rows) + a.NumNonZeros(), items_per_thread_) / items_per_thread_
+        );
+        num_threads = std::max(num_threads, 1);
+        ReserveCarries(static_cast<size_t>(num_threads) * num_cols);
+        merge_->SetArguments(
+          rows, cols, n, a.RowOffsets(), a.ColIndices(), a.Values(), x, y,
+          num_threads, *carry_rows_, *carry_values_
+        );
+        size_t global_work_size[2] = { static_cast<size_t>(num_threads), num_cols };
+        ocl::Event merge = merge_->Run(queue, 2, nullptr, global_work_size, nullptr);
+        // The in-order queue runs the fixup after the merge pass
+        fixup_->SetArguments(rows, n, num_threads, *carry_rows_, *carry_values_, y);
+        return SparseLaunch(merge, fixup_->Run(queue, 2, nullptr, global_work_size, nullptr));
+      }
+      case SparseKernel::kEll: {
+        if (!a.HasEll()) {
+          throw std::runtime_error("SparseGemm: the matrix was uploaded without an ELL copy.");
+        }
+        int slice_size = a.EllSliceSize();
+        ell_->SetArguments(
+          rows, cols, n, slice_size, a.EllSliceOffsets(), a.EllColIndices(), a.EllValues(), x, y
+        );
+        size_t global_work_size[2] = { static_cast<size_t>(rows), num_cols };
+        return SparseLaunch(ell_->Run(queue, 2, nullptr, global_work_size, nullptr));
+      }
+      default: {
+        scalar_->SetArguments(rows, cols, n, a.RowOffsets(), a.ColIndices(), a.Values(), x, y);
+        size_t global_work_size[2] = { static_cast<size_t>(rows), num_cols };
+        return SparseLaunch(scalar_->Run(queue, 2, nullptr, global_work_size, nullptr));
+      }
+    }
+  }
+
+private:
+  ocl::Context context_;
+  size_t vector_size_;
+  size_t vector_group_size_;
+  size_t items_per_thread_;
+  std::unique_ptr<ocl::Kernel> scalar_;
+  std::unique_ptr<ocl::Kernel> vector_;
+  std::unique_ptr<ocl::Kernel> merge_;
+  std::unique_ptr<ocl::Kernel> fixup_;
+  std::unique_ptr<ocl::Kernel> ell_;
+  // Carries of the merge pass, grown on demand
+  size_t num_carries_ = 0;
+  std::unique_ptr<ocl::Buffer<int>> carry_rows_;
+  std::unique_ptr<ocl::Buffer<float>> carry_values_;
+
+  void ReserveCarries(size_t num_carries) {
+    if (num_carries > num_carries_) {
+      carry_rows_.reset(new ocl::Buffer<int>(context_, num_carries));
+      carry_values_.reset(new ocl::Buffer<float>(context_, num_carries));
+      num_carries_ = num_carries;
+    }
+  }
+
+  static size_t RoundUp(size_t size, size_t multiple) {
+    return (size + multiple - 1) / multiple * multiple;
+  }
+}; // class SparseGemm
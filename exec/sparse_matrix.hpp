@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "ocl/aligned_allocator.hpp"
+#include "matrix.hpp"
+
+
+/// @brief Distribution of the non-zeros over the rows of a sparse matrix
+struct RowStatistics {
+  int min_length = 0;
+  int max_length = 0;
+  double mean_length = 0.0;
+  double stddev = 0.0;
+
+  /// @brief Coefficient of variation of the row lengths; 0 for even rows,
+  /// above 1 for power-law like distributions
+  double Variation() const {
+    return mean_length > 0.0 ? stddev / mean_length : 0.0;
+  }
+}; // struct RowStatistics
+
+
+/// @brief Sparse matrix in compressed sparse row (CSR) format.
+///
+/// The arrays are page aligned, so DeviceSparseMatrix can wrap them with
+/// CL_MEM_USE_HOST_PTR instead of copying them.
+class CsrMatrix {
+public:
+  template <typename T>
+  using Array = std::vector<T, ocl::AlignedAllocator<T>>;
+
+  CsrMatrix() : rows_(0), cols_(0), row_offsets_(1, 0) {}
+
+  /// @brief Take the three CSR arrays; 'row_offsets' has rows + 1 entries
+  CsrMatrix(int rows, int cols, Array<int> row_offsets, Array<int> col_indices, Array<float> values)
+    : rows_(rows), cols_(cols),
+      row_offsets_(std::move(row_offsets)),
+      col_indices_(std::move(col_indices)),
+      values_(std::move(values)) {
+    if (row_offsets_.size() != static_cast<size_t>(rows_) + 1
+        || col_indices_.size() != values_.size()
+        || row_offsets_.back() != static_cast<int>(values_.size())) {
+      throw std::runtime_error("CsrMatrix: inconsistent CSR arrays.");
+    }
+  }
+
+  /// @brief The entries of 'dense' whose magnitude is above 'threshold'
+  static CsrMatrix FromDense(const Matrix& dense, float threshold=0.0f) {
+    Array<int> row_offsets(1, 0);
+    Array<int> col_indices;
+    Array<float> values;
+    for (int i = 0; i < dense.Rows(); i++) {
+      for (int j = 0; j < dense.Cols(); j++) {
+        if (std::abs(dense(i, j)) > threshold) {
+          col_indices.push_back(j);
+          values.push_back(dense(i, j));
+        }
+      }
+      row_offsets.push_back(static_cast<int>(values.size()));
+    }
+    return CsrMatrix(dense.Rows(), dense.Cols(),
+                     std::move(row_offsets), std::move(col_indices), std::move(values));
+  }
+
+  /// @brief Random matrix with about density * rows * cols non-zeros in
+  /// [-1, 1]. With 'power_law' the row lengths follow a Zipf-like
+  /// distribution (a few very long rows), otherwise they are even.
+  static CsrMatrix Random(int rows, int cols, double density, bool power_law=false, unsigned seed=0) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> value_distribution(-1.0f, 1.0f);
+
+    const double mean_length = density * cols;
+    std::vector<int> lengths(rows);
+    if (power_law) {
+      // Weights 1 / (rank + 1) scaled to the same total non-zeros
+      double harmonic = 0.0;
+      for (int i = 0; i < rows; i++) {
+        harmonic += 1.0 / (i + 1);
+      }
+      std::vector<int> ranks(rows);
+      for (int i = 0; i < rows; i++) {
+        ranks[i] = i;
+      }
+      std::shuffle(ranks.begin(), ranks.end(), generator);
+      for (int i = 0; i < rows; i++) {
+        const double length = mean_length * rows / (harmonic * (ranks[i] + 1));
+        lengths[i] = std::min(cols, static_cast<int>(std::lround(length)));
+      }
+    } else {
+      std::poisson_distribution<int> length_distribution(mean_length);
+      for (int i = 0; i < rows; i++) {
+        lengths[i] = std::min(cols, length_distribution(generator));
+      }
+    }
+
+    Array<int> row_offsets(1, 0);
+    Array<int> col_indices;
+    Array<float> values;
+    std::vector<int> columns(cols);
+    for (int j = 0; j < cols; j++) {
+      columns[j] = j;
+    }
+    for (int i = 0; i < rows; i++) {
+      // Partial Fisher-Yates: the first lengths[i] columns are a random subset
+      for (int k = 0; k < lengths[i]; k++) {
+        std::uniform_int_distribution<int> pick(k, cols - 1);
+        std::swap(columns[k], columns[pick(generator)]);
+      }
+      std::sort(columns.begin(), columns.begin() + lengths[i]);
+      for (int k = 0; k < lengths[i]; k++) {
+        col_indices.push_back(columns[k]);
+        values.push_back(value_distribution(generator));
+      }
+      row_offsets.push_back(static_cast<int>(values.size()));
+    }
+    return CsrMatrix(rows, cols, std::move(row_offsets), std::move(col_indices), std::move(values));
+  }
+
+  int Rows() const { return rows_; }
+  int Cols() const { return cols_; }
+  int NumNonZeros() const { return static_cast<int>(values_.size()); }
+  double Density() const {
+    return rows_ > 0 && cols_ > 0 ? static_cast<double>(NumNonZeros()) / rows_ / cols_ : 0.0;
+  }
+  int RowLength(int i) const { return row_offsets_[i + 1] - row_offsets_[i]; }
+
+  const Array<int>& RowOffsets() const { return row_offsets_; }
+  const Array<int>& ColIndices() const { return col_indices_; }
+  const Array<float>& Values() const { return values_; }
+
+  RowStatistics Statistics() const {
+    RowStatistics stats;
+    if (rows_ == 0) {
+      return stats;
+    }
+    stats.min_length = RowLength(0);
+    double sum_squares = 0.0;
+    for (int i = 0; i < rows_; i++) {
+      const int length = RowLength(i);
+      stats.min_length = std::min(stats.min_length, length);
+      stats.max_length = std::max(stats.max_length, length);
+      sum_squares += static_cast<double>(length) * length;
+    }
+    stats.mean_length = static_cast<double>(NumNonZeros()) / rows_;
+    stats.stddev = std::sqrt(std::max(0.0, sum_squares / rows_ - stats.mean_length * stats.mean_length));
+    return stats;
+  }
+
+  /// @brief Column-major dense copy
+  Matrix ToDense() const {
+    Matrix dense(rows_, cols_);
+    for (int i = 0; i < rows_; i++) {
+      for (int k = row_offsets_[i]; k < row_offsets_[i + 1]; k++) {
+        dense(i, col_indices_[k]) = values_[k];
+      }
+    }
+    return dense;
+  }
+
+  /// @brief Host reference of result = this * rhs
+  void Multiply(const Matrix& rhs, Matrix& result) const {
+    if (rhs.Rows() != cols_) {
+      throw std::runtime_error("CsrMatrix: shapes do not match.");
+    }
+    result = Matrix(rows_, rhs.Cols());
+    for (int j = 0; j < rhs.Cols(); j++) {
+      for (int i = 0; i < rows_; i++) {
+        float sum = 0.0f;
+        for (int k = row_offsets_[i]; k < row_offsets_[i + 1]; k++) {
+          sum += values_[k] * rhs(col_indices_[k], j);
+        }
+        result(i, j) = sum;
+      }
+    }
+  }
+
+private:
+  int rows_;
+  int cols_;
+  Array<int> row_offsets_;
+  Array<int> col_indices_;
+  Array<float> values_;
+}; // class CsrMatrix
+
+
+/// @brief Sparse matrix in sliced ELLPACK format: rows are grouped in
+/// slices of 'slice_size' rows, each slice padded to its longest row and
+/// stored column by column. Padding has the column index -1.
+class EllMatrix {
+public:
+  template <typename T>
+  using Array = CsrMatrix::Array<T>;
+
+  static EllMatrix FromCsr(const CsrMatrix& csr, int slice_size=32) {
+    EllMatrix ell;
+    ell.rows_ = csr.Rows();
+    ell.cols_ = csr.Cols();
+    ell.slice_size_ = slice_size;
+    ell.num_non_zeros_ = csr.NumNonZeros();
+
+    const int num_slices = (csr.Rows() + slice_size - 1) / slice_size;
+    ell.slice_offsets_.assign(1, 0);
+    for (int s = 0; s < num_slices; s++) {
+      int width = 0;
+      for (int i = s * slice_size; i < std::min(csr.Rows(), (s + 1) * slice_size); i++) {
+        width = std::max(width, csr.RowLength(i));
+      }
+      ell.slice_offsets_.push_back(ell.slice_offsets_.back() + width * slice_size);
+    }
+
+    ell.col_indices_.assign(ell.slice_offsets_.back(), -1);
+    ell.values_.assign(ell.slice_offsets_.back(), 0.0f);
+    for (int i = 0; i < csr.Rows(); i++) {
+      const int start = ell.slice_offsets_[i / slice_size] + i % slice_size;
+      for (int k = 0; k < csr.RowLength(i); k++) {
+        const int csr_index = csr.RowOffsets()[i] + k;
+        ell.col_indices_[start + k * slice_size] = csr.ColIndices()[csr_index];
+        ell.values_[start + k * slice_size] = csr.Values()[csr_index];
+      }
+    }
+    return ell;
+  }
+
+  int Rows() const { return rows_; }
+  int Cols() const { return cols_; }
+  int SliceSize() const { return slice_size_; }
+  int NumSlices() const { return static_cast<int>(slice_offsets_.size()) - 1; }
+  int NumStored() const { return static_cast<int>(values_.size()); }
+
+  /// @brief Non-zeros over stored entries: 1 without padding
+  double Efficiency() const {
+    return NumStored() > 0 ? static_cast<double>(num_non_zeros_) / NumStored() : 1.0;
+  }
+
+  const Array<int>& SliceOffsets() const { return slice_offsets_; }
+  const Array<int>& ColIndices() const { return col_indices_; }
+  const Array<float>& Values() const { return values_; }
+
+private:
+  int rows_ = 0;
+  int cols_ = 0;
+  int slice_size_ = 1;
+  int num_non_zeros_ = 0;
+  Array<int> slice_offsets_;
+  Array<int> col_indices_;
+  Array<float> values_;
+}; // class EllMatrix
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/// @brief Fixed set of worker threads for data-parallel loops.
+///
+/// ParallelFor hands out loop indices dynamically, so uneven iterations
+/// balance out; the calling thread works as thread 0. Tasks must not throw.
+class ThreadPool {
+public:
+  /// @brief Task of one loop index: (index, thread id in [0, NumThreads()))
+  typedef std::function<void(size_t, size_t)> Task;
+
+  /// @param num_threads Total number of threads including the caller; 0
+  /// uses one per hardware thread
+  explicit ThreadPool(size_t num_threads=0) {
+    if (num_threads == 0) {
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t id = 1; id < num_threads; id++) {
+      workers_.emplace_back([this, id] { WorkerLoop(id); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator= (const ThreadPool&) = delete;
+
+  size_t NumThreads() const { return workers_.size() + 1; }
+
+  /// @brief Run task(i, thread id) for every i in [0, count) and wait
+  void ParallelFor(size_t count, const Task& task) {
+    if (count == 0) {
+      return;
+    }
+    if (workers_.empty() || count == 1) {
+      for (size_t i = 0; i < count; i++) {
+        task(i, 0);
+      }
+      return;
+    }
+
+    std::lock_guard<std::mutex> call_lock(call_mutex_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &task;
+      count_ = count;
+      next_.store(0);
+      num_active_ = workers_.size();
+      generation_++;
+    }
+    start_cv_.notify_all();
+    Work(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return num_active_ == 0; });
+    task_ = nullptr;
+  }
+
+  /// @brief Process-wide pool with one thread per hardware thread
+  static ThreadPool& Default() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+private:
+  std::vector<std::thread> workers_;
+  std::mutex call_mutex_;   // one ParallelFor at a time
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const Task* task_ = nullptr;
+  size_t count_ = 0;
+  std::atomic<size_t> next_{0};
+  size_t num_active_ = 0;
+  size_t generation_ = 0;
+  bool stop_ = false;
+
+  void WorkerLoop(size_t id) {
+    size_t seen_generation = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+        if (stop_) {
+          return;
+        }
+        seen_generation = generation_;
+      }
+      Work(id);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--num_active_ == 0) {
+          done_cv_.notify_one();
+        }
+      }
+    }
+  }
+
+  void Work(size_t id) {
+    for (size_t i = next_.fetch_add(1); i < count_; i = next_.fetch_add(1)) {
+      (*task_)(i, id);
+    }
+  }
+}; // class ThreadPool
@@ -5,7 +5,7 @@
 
 namespace utils {
 
-  std::string ReadKernelFileFromDisk(const std::string& file_path) {
+  inline std::string ReadKernelFileFromDisk(const std::string& file_path) {
     // Get size of file
     std::ifstream input_file_stream(file_path);
     input_file_stream.seekg(0, std::ios::end);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include <cstddef>
+#include <new>
+
+
+namespace ocl {
+
+  /// @brief Page alignment that lets the runtimes wrap host memory with
+  /// CL_MEM_USE_HOST_PTR without a copy (Intel requires 4096 bytes)
+  constexpr size_t kZeroCopyAlignment = 4096;
+
+  /// @brief Allocator returning 'Alignment'-aligned storage whose size is
+  /// padded to a multiple of 64 bytes (a cache line), as the zero-copy
+  /// paths of the CPU and integrated-GPU runtimes expect.
+  template <typename T, size_t Alignment=kZeroCopyAlignment>
+  class AlignedAllocator {
+  public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() noexcept {}
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(size_t n) {
+      const size_t bytes = (n * sizeof(T) + 63) / 64 * 64;
+      void* ptr = nullptr;
+      if (posix_memalign(&ptr, Alignment, bytes == 0 ? 64 : bytes) != 0) {
+        throw std::bad_alloc();
+      }
+      return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t) noexcept {
+      free(ptr);
+    }
+
+    template <typename U>
+    bool operator== (const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!= (const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+  }; // class AlignedAllocator
+
+} // namespace cl
@@ -1,10 +1,75 @@
 #pragma once
 
+#include <algorithm>
+
 #include "ocl/common.h"
 
 
 namespace ocl {
 
+  /// @brief Where the storage of a buffer lives
+  enum class BufferMode {
+    kDevice,       // device storage, filled with CopyFromHost
+    kUseHostPtr,   // CL_MEM_USE_HOST_PTR: wraps caller-owned host memory
+    kAllocHostPtr  // CL_MEM_ALLOC_HOST_PTR: host-accessible storage from the runtime
+  };
+
+
+  /// @brief RAII view of a mapped buffer region. The region is unmapped
+  /// (and the unmap waited for) when the view is destroyed.
+  template <typename T>
+  class MappedView {
+  public:
+    MappedView(cl_command_queue queue, cl_mem mem, T* ptr, size_t num_elmts)
+      : queue_(queue), mem_(mem), ptr_(ptr), num_elmts_(num_elmts) {
+      CL_CHECK_ERROR(clRetainMemObject(mem_));
+    }
+
+    MappedView(MappedView&& rhs)
+      : queue_(rhs.queue_), mem_(rhs.mem_), ptr_(rhs.ptr_), num_elmts_(rhs.num_elmts_) {
+      rhs.mem_ = nullptr;
+      rhs.ptr_ = nullptr;
+    }
+
+    MappedView(const MappedView&) = delete;
+    MappedView& operator= (const MappedView&) = delete;
+
+    ~MappedView() {
+      if (ptr_ != nullptr) {
+        try {
+          Unmap().Wait();
+        } catch (const std::runtime_error&) {
+        }
+      }
+      if (mem_ != nullptr) {
+        clReleaseMemObject(mem_);
+      }
+    }
+
+    /// @brief Unmap the region early; the view must not be used afterwards
+    Event Unmap() {
+      cl_event event = nullptr;
+      T* ptr = ptr_;
+      ptr_ = nullptr;
+      CL_CHECK_ERROR(clEnqueueUnmapMemObject(queue_, mem_, ptr, 0, nullptr, &event));
+      return Event(event);
+    }
+
+    T* data() { return ptr_; }
+    const T* data() const { return ptr_; }
+    size_t size() const { return num_elmts_; }
+
+    T& operator[] (size_t i) { return ptr_[i]; }
+    const T& operator[] (size_t i) const { return ptr_[i]; }
+
+  private:
+    cl_command_queue queue_;
+    cl_mem mem_;
+    T* ptr_;
+    size_t num_elmts_;
+  }; // class MappedView
+
+
   template <typename T>
   class Buffer : public ObjectBase<cl_mem> {
   public:
@@ -22,55 +87,387 @@ namespace ocl {
       }
     }
 
+    /// @brief Create a buffer with host-side storage.
+    /// @param host_ptr Host memory to wrap with BufferMode::kUseHostPtr; it
+    /// must outlive the buffer and should be allocated with AlignedAllocator.
+    /// Ignored by the other modes.
+    explicit Buffer(const Context& context, 
+                    size_t num_elmts, 
+                    BufferMode mode, 
+                    T* host_ptr=nullptr,
+                    cl_mem_flags access=CL_MEM_READ_WRITE) {
+      cl_mem_flags flags = access;
+      void* ptr = nullptr;
+      if (mode == BufferMode::kUseHostPtr) {
+        if (host_ptr == nullptr) {
+          throw std::runtime_error("Buffer: kUseHostPtr requires a host pointer.");
+        }
+        flags |= CL_MEM_USE_HOST_PTR;
+        ptr = static_cast<void*>(host_ptr);
+      } else if (mode == BufferMode::kAllocHostPtr) {
+        flags |= CL_MEM_ALLOC_HOST_PTR;
+      }
+
+      cl_int status = 0;
+      object_ = clCreateBuffer(
+        context(),
+        flags,
+        num_elmts * sizeof(T),
+        ptr,
+        &status
+      );
+      if (status != CL_SUCCESS) {
+        throw std::runtime_error("Failed to create memory.");
+      }
+    }
+
+    /// @brief Take the storage from a caching memory pool. The storage goes
+    /// back to the pool when the last copy of this buffer is destroyed.
+    explicit Buffer(MemoryPool& pool, size_t num_elmts) 
+      : block_(pool.Allocate(num_elmts * sizeof(T))) {
+      object_ = block_->Memory();
+      Retain();
+    }
+
+    /// @brief View of 'num_elmts' elements of 'parent' from element
+    /// 'offset' (clCreateSubBuffer), sharing and keeping alive the parent's
+    /// storage. Views of views are taken on the root buffer. The byte offset
+    /// from the root must be a multiple of SubBufferAlignment() elements.
+    explicit Buffer(const Buffer<T>& parent,
+                    size_t offset,
+                    size_t num_elmts,
+                    cl_mem_flags access=CL_MEM_READ_WRITE)
+      : block_(parent.block_),
+        root_(parent.root_ ? parent.root_ : std::make_shared<Buffer<T>>(parent)),
+        origin_(parent.origin_ + offset) {
+      const size_t alignment = root_->SubBufferAlignment();
+      if (origin_ % alignment != 0) {
+        throw std::runtime_error(
+          "Sub-buffer offset " + std::to_string(origin_) + " is not a multiple of the "
+          + std::to_string(alignment) + " element base address alignment."
+        );
+      }
+      cl_buffer_region region = { origin_ * sizeof(T), num_elmts * sizeof(T) };
+      cl_int status = 0;
+      object_ = clCreateSubBuffer(
+        (*root_)(),
+        access,
+        CL_BUFFER_CREATE_TYPE_REGION,
+        &region,
+        &status
+      );
+      if (status != CL_SUCCESS) {
+        throw std::runtime_error("Failed to create sub-buffer with status: " + std::to_string(status) + ".");
+      }
+    }
+
     virtual ~Buffer() {
 
     }
 
-    void CopyFromHost(CommandQueue& queue,
-                     const T* src, 
-                     size_t num_elmts, 
-                     size_t offset=0,
-                     bool blocking=true,
-                     cl_uint num_events_in_wait_list=0,
-                     const cl_event* event_wait_list=nullptr,
-                     cl_event* event=nullptr) {
+    /// @brief Number of elements, from CL_MEM_SIZE
+    size_t NumElmts() const {
+      size_t bytes = 0;
+      CL_CHECK_ERROR(clGetMemObjectInfo(object_, CL_MEM_SIZE, sizeof(bytes), &bytes, nullptr));
+      return bytes / sizeof(T);
+    }
+
+    /// @brief Offset in elements from the root buffer; 0 unless a view
+    size_t Origin() const { return origin_; }
+
+    /// @brief Granularity in elements of sub-buffer offsets: the largest
+    /// CL_DEVICE_MEM_BASE_ADDR_ALIGN of the devices of the buffer's context
+    size_t SubBufferAlignment() const {
+      cl_context context = nullptr;
+      CL_CHECK_ERROR(clGetMemObjectInfo(object_, CL_MEM_CONTEXT, sizeof(context), &context, nullptr));
+      size_t devices_size = 0;
+      CL_CHECK_ERROR(clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, nullptr, &devices_size));
+      std::vector<cl_device_id> devices(devices_size / sizeof(cl_device_id));
+      CL_CHECK_ERROR(clGetContextInfo(context, CL_CONTEXT_DEVICES, devices_size, devices.data(), nullptr));
+
+      cl_uint align_bits = 8;
+      for (cl_device_id device : devices) {
+        cl_uint bits = 0;
+        CL_CHECK_ERROR(clGetDeviceInfo(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(bits), &bits, nullptr));
+        align_bits = std::max(align_bits, bits);
+      }
+      return std::max<size_t>(1, align_bits / 8 / sizeof(T));
+    }
+
+    /// @brief Largest offset not above 'offset' at which a view can start
+    size_t AlignSubBufferOffset(size_t offset) const {
+      const size_t alignment = SubBufferAlignment();
+      return (origin_ + offset) / alignment * alignment - origin_;
+    }
+
+    /// @brief Write 'num_elmts' elements from 'src' at element 'offset'
+    /// of the buffer
+    Event CopyFromHost(CommandQueue& queue,
+                       const T* src, 
+                       size_t num_elmts, 
+                       size_t offset=0,
+                       bool blocking=true,
+                       cl_uint num_events_in_wait_list=0,
+                       const cl_event* event_wait_list=nullptr) {
+      cl_event event = nullptr;
       CL_CHECK_ERROR(
         clEnqueueWriteBuffer(
           queue(), 
           object_, 
           blocking ? CL_TRUE : CL_FALSE, 
-          offset, 
+          offset * sizeof(T), 
           num_elmts * sizeof(T), 
           static_cast<const void*>(src),
           num_events_in_wait_list,
           event_wait_list,
-          event
+          &event
         )
       );
+      return Event(event);
     }
 
-    void CopyFromDevice(CommandQueue& queue,
-                        T* dst, 
-                        size_t num_elmts, 
-                        size_t offset=0,
-                        bool blocking=true,
-                        cl_uint num_events_in_wait_list=0,
-                        const cl_event* event_wait_list=nullptr,
-                        cl_event* event=nullptr) {
+    /// @brief Read 'num_elmts' elements from element 'offset' of the
+    /// buffer into 'dst'
+    Event CopyFromDevice(CommandQueue& queue,
+                         T* dst, 
+                         size_t num_elmts, 
+                         size_t offset=0,
+                         bool blocking=true,
+                         cl_uint num_events_in_wait_list=0,
+                         const cl_event* event_wait_list=nullptr) {
+      cl_event event = nullptr;
       CL_CHECK_ERROR(
         clEnqueueReadBuffer(
           queue(), 
           object_, 
           blocking ? CL_TRUE : CL_FALSE, 
-          offset, 
+          offset * sizeof(T), 
           num_elmts * sizeof(T), 
           static_cast<void*>(dst),
           num_events_in_wait_list,
           event_wait_list,
-          event
+          &event
+        )
+      );
+      return Event(event);
+    }
+
+    /// @brief Non-blocking CopyFromHost after 'dependencies'. 'src' must
+    /// stay valid and unmodified until the future is ready.
+    Future CopyFromHostAsync(CommandQueue& queue,
+                             const T* src,
+                             size_t num_elmts,
+                             size_t offset=0,
+                             const std::vector<Future>& dependencies={}) {
+      auto wait_list = Future::Events(dependencies);
+      Event event = CopyFromHost(
+        queue, src, num_elmts, offset, false,
+        static_cast<cl_uint>(wait_list.size()),
+        wait_list.empty() ? nullptr : wait_list.data()
+      );
+      queue.Flush();
+      return Future(event);
+    }
+
+    /// @brief Non-blocking CopyFromDevice after 'dependencies'. 'dst' holds
+    /// the data once the future is ready.
+    Future CopyFromDeviceAsync(CommandQueue& queue,
+                               T* dst,
+                               size_t num_elmts,
+                               size_t offset=0,
+                               const std::vector<Future>& dependencies={}) {
+      auto wait_list = Future::Events(dependencies);
+      Event event = CopyFromDevice(
+        queue, dst, num_elmts, offset, false,
+        static_cast<cl_uint>(wait_list.size()),
+        wait_list.empty() ? nullptr : wait_list.data()
+      );
+      queue.Flush();
+      return Future(event);
+    }
+
+    /// @brief Write a rows x cols column-major tile from host memory with
+    /// leading dimension 'src_ld' into this buffer at element 'dst_offset'
+    /// with leading dimension 'dst_ld' (clEnqueueWriteBufferRect), so a tile
+    /// of a larger matrix moves without packing. Leading dimensions are in
+    /// elements.
+    Event CopyRectFromHost(CommandQueue& queue,
+                           const T* src,
+                           size_t src_ld,
+                           size_t rows,
+                           size_t cols,
+                           size_t dst_offset,
+                           size_t dst_ld,
+                           bool blocking=true,
+                           cl_uint num_events_in_wait_list=0,
+                           const cl_event* event_wait_list=nullptr) {
+      RectLayout layout(rows, cols, dst_offset, dst_ld);
+      cl_event event = nullptr;
+      CL_CHECK_ERROR(
+        clEnqueueWriteBufferRect(
+          queue(),
+          object_,
+          blocking ? CL_TRUE : CL_FALSE,
+          layout.buffer_origin,
+          layout.host_origin,
+          layout.region,
+          dst_ld * sizeof(T),
+          0,
+          src_ld * sizeof(T),
+          0,
+          static_cast<const void*>(src),
+          num_events_in_wait_list,
+          event_wait_list,
+          &event
+        )
+      );
+      return Event(event);
+    }
+
+    /// @brief Read a rows x cols column-major tile at element 'src_offset'
+    /// with leading dimension 'src_ld' into host memory with leading
+    /// dimension 'dst_ld' (clEnqueueReadBufferRect)
+    Event CopyRectFromDevice(CommandQueue& queue,
+                             T* dst,
+                             size_t dst_ld,
+                             size_t rows,
+                             size_t cols,
+                             size_t src_offset,
+                             size_t src_ld,
+                             bool blocking=true,
+                             cl_uint num_events_in_wait_list=0,
+                             const cl_event* event_wait_list=nullptr) {
+      RectLayout layout(rows, cols, src_offset, src_ld);
+      cl_event event = nullptr;
+      CL_CHECK_ERROR(
+        clEnqueueReadBufferRect(
+          queue(),
+          object_,
+          blocking ? CL_TRUE : CL_FALSE,
+          layout.buffer_origin,
+          layout.host_origin,
+          layout.region,
+          src_ld * sizeof(T),
+          0,
+          dst_ld * sizeof(T),
+          0,
+          static_cast<void*>(dst),
+          num_events_in_wait_list,
+          event_wait_list,
+          &event
+        )
+      );
+      return Event(event);
+    }
+
+    /// @brief Non-blocking CopyRectFromHost after 'dependencies'
+    Future CopyRectFromHostAsync(CommandQueue& queue,
+                                 const T* src,
+                                 size_t src_ld,
+                                 size_t rows,
+                                 size_t cols,
+                                 size_t dst_offset,
+                                 size_t dst_ld,
+                                 const std::vector<Future>& dependencies={}) {
+      auto wait_list = Future::Events(dependencies);
+      Event event = CopyRectFromHost(
+        queue, src, src_ld, rows, cols, dst_offset, dst_ld, false,
+        static_cast<cl_uint>(wait_list.size()),
+        wait_list.empty() ? nullptr : wait_list.data()
+      );
+      queue.Flush();
+      return Future(event);
+    }
+
+    /// @brief Non-blocking CopyRectFromDevice after 'dependencies'
+    Future CopyRectFromDeviceAsync(CommandQueue& queue,
+                                   T* dst,
+                                   size_t dst_ld,
+                                   size_t rows,
+                                   size_t cols,
+                                   size_t src_offset,
+                                   size_t src_ld,
+                                   const std::vector<Future>& dependencies={}) {
+      auto wait_list = Future::Events(dependencies);
+      Event event = CopyRectFromDevice(
+        queue, dst, dst_ld, rows, cols, src_offset, src_ld, false,
+        static_cast<cl_uint>(wait_list.size()),
+        wait_list.empty() ? nullptr : wait_list.data()
+      );
+      queue.Flush();
+      return Future(event);
+    }
+
+    /// @brief Device-side copy of 'num_elmts' elements of 'src' with
+    /// clEnqueueCopyBuffer. Offsets are in elements.
+    Event CopyFromBuffer(CommandQueue& queue,
+                         const Buffer<T>& src,
+                         size_t num_elmts,
+                         size_t src_offset=0,
+                         size_t dst_offset=0,
+                         cl_uint num_events_in_wait_list=0,
+                         const cl_event* event_wait_list=nullptr) {
+      cl_event event = nullptr;
+      CL_CHECK_ERROR(
+        clEnqueueCopyBuffer(
+          queue(),
+          src(),
+          object_,
+          src_offset * sizeof(T),
+          dst_offset * sizeof(T),
+          num_elmts * sizeof(T),
+          num_events_in_wait_list,
+          event_wait_list,
+          &event
         )
       );
+      return Event(event);
     }
+
+    /// @brief Map 'num_elmts' elements starting at element 'offset' into
+    /// host memory (blocking). For kUseHostPtr and kAllocHostPtr buffers on
+    /// CPU and integrated devices this does not copy.
+    /// @param flags CL_MAP_READ, CL_MAP_WRITE or CL_MAP_WRITE_INVALIDATE_REGION
+    MappedView<T> Map(CommandQueue& queue, 
+                      cl_map_flags flags, 
+                      size_t num_elmts, 
+                      size_t offset=0) {
+      cl_int status = 0;
+      void* ptr = clEnqueueMapBuffer(
+        queue(),
+        object_,
+        CL_TRUE,
+        flags,
+        offset * sizeof(T),
+        num_elmts * sizeof(T),
+        0,
+        nullptr,
+        nullptr,
+        &status
+      );
+      if (status != CL_SUCCESS) {
+        throw std::runtime_error("Failed to map memory with status: " + std::to_string(status) + ".");
+      }
+      return MappedView<T>(queue(), object_, static_cast<T*>(ptr), num_elmts);
+    }
+
+  private:
+    std::shared_ptr<MemoryPool::Block> block_;
+    std::shared_ptr<Buffer<T>> root_;   // buffer a view was taken from
+    size_t origin_ = 0;
+
+    // Origins and region of a column-major tile, the buffer side starting
+    // at element 'offset' of a matrix with leading dimension 'ld'
+    struct RectLayout {
+      RectLayout(size_t rows, size_t cols, size_t offset, size_t ld)
+        : buffer_origin{ (offset % ld) * sizeof(T), offset / ld, 0 },
+          host_origin{ 0, 0, 0 },
+          region{ rows * sizeof(T), cols, 1 } {}
+
+      size_t buffer_origin[3];
+      size_t host_origin[3];
+      size_t region[3];
+    }; // struct RectLayout
   }; // class Buffer
 
 } // namespace cl
@@ -6,10 +6,15 @@ namespace ocl {
 
   class CommandQueue : public ObjectBase<cl_command_queue> {
   public:
-    explicit CommandQueue(const Context& context, const Device& device) {
+    /// @param properties e.g. CL_QUEUE_PROFILING_ENABLE |
+    /// CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE (see
+    /// Device::SupportsOutOfOrderQueue)
+    explicit CommandQueue(const Context& context,
+                          const Device& device,
+                          cl_command_queue_properties properties=CL_QUEUE_PROFILING_ENABLE) {
       cl_int status = 0;
       object_ = clCreateCommandQueue(
-        context(), device(), CL_QUEUE_PROFILING_ENABLE, &status
+        context(), device(), properties, &status
       );
       if (status != CL_SUCCESS) {
         throw std::runtime_error("Failed to create command queue.");
@@ -21,6 +26,11 @@ namespace ocl {
     void Finish() const {
       clFinish(object_);
     }
+
+    /// @brief Submit the enqueued commands to the device without waiting
+    void Flush() const {
+      clFlush(object_);
+    }
   }; // class CommandQueue
 
 } // namespace cl
@@ -56,8 +56,8 @@ namespace ocl {
     }
 
     /// @brief Move constructor
-    ObjectBase(ObjectBase&& rhs) : object_(std::move(rhs.object_)) {
-      
+    ObjectBase(ObjectBase&& rhs) : object_(rhs.object_) {
+      rhs.object_ = nullptr;
     }
 
     virtual ~ObjectBase() {
@@ -93,7 +93,9 @@ namespace ocl {
     _Object object_;
 
     void Retain() const {
-      RawObjectHandler<_Object>::Retain(object_);
+      if (object_ != nullptr) {
+        RawObjectHandler<_Object>::Retain(object_);
+      }
     }
 
     void Release() {
@@ -126,6 +128,16 @@ namespace ocl {
     } 
   };
   
+  template <> struct RawObjectHandler<cl_command_queue> {
+    static void Retain(cl_command_queue queue) {
+      CL_CHECK_ERROR(clRetainCommandQueue(queue));
+    }
+
+    static void Release(cl_command_queue queue) {
+      CL_CHECK_ERROR(clReleaseCommandQueue(queue));
+    }
+  };
+
   template <> struct RawObjectHandler<cl_program> {
     static void Retain(cl_program program) {
       CL_CHECK_ERROR(clRetainProgram(program));
@@ -155,4 +167,14 @@ namespace ocl {
       CL_CHECK_ERROR(clReleaseMemObject(mem));
     }
   };
+
+  template <> struct RawObjectHandler<cl_event> {
+    static void Retain(cl_event event) {
+      CL_CHECK_ERROR(clRetainEvent(event));
+    }
+
+    static void Release(cl_event event) {
+      CL_CHECK_ERROR(clReleaseEvent(event));
+    }
+  };
 } // namespace cl
\ No newline at end of file
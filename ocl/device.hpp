@@ -1,10 +1,47 @@
 #pragma once
 
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+
 #include "ocl/common.h"
 
 
 namespace ocl {
 
+  /// @brief Snapshot of the device properties the wrappers, tuners and
+  /// validity checks use, queried once per device instead of with two
+  /// clGetDeviceInfo calls on every access
+  struct DeviceProperties {
+    cl_platform_id platform = nullptr;
+    std::string name;
+    std::string vendor;
+    std::string version;
+    std::string driver_version;
+    cl_device_type type = 0;
+    size_t max_work_group_size = 0;
+    size_t max_work_item_dimensions = 0;
+    std::vector<size_t> max_work_item_sizes;
+    cl_ulong local_mem_size = 0;
+    cl_ulong global_mem_size = 0;
+    cl_ulong max_alloc_size = 0;
+    size_t compute_units = 0;
+    size_t core_clock = 0;                    // MHz
+    cl_uint mem_base_addr_align = 0;          // bits
+    bool host_unified_memory = false;
+    cl_command_queue_properties queue_properties = 0;
+    std::string extensions;
+    std::set<std::string> extension_set;
+    bool supports_fp16 = false;
+    bool supports_fp64 = false;
+
+    bool HasExtension(const std::string &extension) const {
+      return extension_set.count(extension) != 0;
+    }
+  }; // struct DeviceProperties
+
+
   // C++11 version of 'cl_device_id'
   class Device : public ObjectBase<cl_device_id> {
   public:
@@ -31,16 +68,20 @@ namespace ocl {
         clReleaseDevice(devices[n]);
         devices[n] = nullptr;
       }
+      properties_ = GetProperties(object_);
     }
 
     virtual ~Device() {
 
     }
 
+    /// @brief Properties snapshot, shared by every Device of this cl_device_id
+    const DeviceProperties& Properties() const { return *properties_; }
+
     // Methods to retrieve device information
-    cl_platform_id PlatformID() const { return GetInfo<cl_platform_id>(CL_DEVICE_PLATFORM); }
+    cl_platform_id PlatformID() const { return properties_->platform; }
 
-    std::string Version() const { return GetInfoString(CL_DEVICE_VERSION); }
+    std::string Version() const { return properties_->version; }
 
     size_t VersionNumber() const
     {
@@ -51,69 +92,67 @@ namespace ocl {
       size_t version = (size_t) (100.0 * std::stod(version_string.substr(0, next_whitespace)));
       return version;
     }
-    std::string Vendor() const { return GetInfoString(CL_DEVICE_VENDOR); }
-    std::string Name() const { return GetInfoString(CL_DEVICE_NAME); }
+    std::string DriverVersion() const { return properties_->driver_version; }
+    std::string Vendor() const { return properties_->vendor; }
+    std::string Name() const { return properties_->name; }
     std::string Type() const {
-      auto type = GetInfo<cl_device_type>(CL_DEVICE_TYPE);
-      switch(type) {
+      switch(properties_->type) {
         case CL_DEVICE_TYPE_CPU: return "CPU";
         case CL_DEVICE_TYPE_GPU: return "GPU";
         case CL_DEVICE_TYPE_ACCELERATOR: return "accelerator";
         default: return "default";
       }
     }
-    size_t MaxWorkGroupSize() const { return GetInfo<size_t>(CL_DEVICE_MAX_WORK_GROUP_SIZE); }
-    size_t MaxWorkItemDimensions() const {
-      return static_cast<size_t>(GetInfo<cl_uint>(CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS));
-    }
-    std::vector<size_t> MaxWorkItemSizes() const {
-      return GetInfoVector<size_t>(CL_DEVICE_MAX_WORK_ITEM_SIZES);
-    }
+    size_t MaxWorkGroupSize() const { return properties_->max_work_group_size; }
+    size_t MaxWorkItemDimensions() const { return properties_->max_work_item_dimensions; }
+    std::vector<size_t> MaxWorkItemSizes() const { return properties_->max_work_item_sizes; }
     unsigned long LocalMemSize() const {
-      return static_cast<unsigned long>(GetInfo<cl_ulong>(CL_DEVICE_LOCAL_MEM_SIZE));
+      return static_cast<unsigned long>(properties_->local_mem_size);
     }
 
-    std::string Capabilities() const { return GetInfoString(CL_DEVICE_EXTENSIONS); }
+    std::string Capabilities() const { return properties_->extensions; }
     bool HasExtension(const std::string &extension) const {
-      const auto extensions = Capabilities();
-      return extensions.find(extension) != std::string::npos;
-    }
-    bool SupportsFP64() const {
-      return HasExtension("cl_khr_fp64");
-    }
-    bool SupportsFP16() const {
-      if (Name() == "Mali-T628") { return true; } // supports fp16 but not cl_khr_fp16 officially
-      return HasExtension("cl_khr_fp16");
+      return properties_->HasExtension(extension);
     }
+    bool SupportsFP64() const { return properties_->supports_fp64; }
+    bool SupportsFP16() const { return properties_->supports_fp16; }
 
-    size_t CoreClock() const {
-      return static_cast<size_t>(GetInfo<cl_uint>(CL_DEVICE_MAX_CLOCK_FREQUENCY));
-    }
-    size_t ComputeUnits() const {
-      return static_cast<size_t>(GetInfo<cl_uint>(CL_DEVICE_MAX_COMPUTE_UNITS));
-    }
+    size_t CoreClock() const { return properties_->core_clock; }
+    size_t ComputeUnits() const { return properties_->compute_units; }
     unsigned long MemorySize() const {
-      return static_cast<unsigned long>(GetInfo<cl_ulong>(CL_DEVICE_GLOBAL_MEM_SIZE));
+      return static_cast<unsigned long>(properties_->global_mem_size);
     }
     unsigned long MaxAllocSize() const {
-      return static_cast<unsigned long>(GetInfo<cl_ulong>(CL_DEVICE_MAX_MEM_ALLOC_SIZE));
+      return static_cast<unsigned long>(properties_->max_alloc_size);
+    }
+    /// @brief Alignment in bytes of the origin of sub-buffers
+    size_t MemBaseAddrAlign() const { return properties_->mem_base_addr_align / 8; }
+    bool HostUnifiedMemory() const { return properties_->host_unified_memory; }
+    /// @brief Whether the device reads host memory directly (CPU devices and
+    /// integrated GPUs), so wrapping host memory beats copying it
+    bool PrefersZeroCopy() const {
+      return properties_->type == CL_DEVICE_TYPE_CPU || properties_->host_unified_memory;
+    }
+    /// @brief Whether command queues of the device may run commands out of order
+    bool SupportsOutOfOrderQueue() const {
+      return (properties_->queue_properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
     }
     size_t MemoryClock() const { return 0; } // Not exposed in OpenCL
     size_t MemoryBusWidth() const { return 0; } // Not exposed in OpenCL
 
     // Configuration-validity checks
     bool IsLocalMemoryValid(const cl_ulong local_mem_usage) const {
-      return (local_mem_usage <= LocalMemSize());
+      return (local_mem_usage <= properties_->local_mem_size);
     }
     bool IsThreadConfigValid(const std::vector<size_t> &local) const {
+      const auto &max_sizes = properties_->max_work_item_sizes;
+      if (local.size() > properties_->max_work_item_dimensions || local.size() > max_sizes.size()) { return false; }
       auto local_size = size_t{1};
-      for (const auto &item: local) { local_size *= item; }
       for (auto i=size_t{0}; i<local.size(); ++i) {
-        if (local[i] > MaxWorkItemSizes()[i]) { return false; }
+        if (local[i] > max_sizes[i]) { return false; }
+        local_size *= local[i];
       }
-      if (local_size > MaxWorkGroupSize()) { return false; }
-      if (local.size() > MaxWorkItemDimensions()) { return false; }
-      return true;
+      return local_size <= properties_->max_work_group_size;
     }
   /*
     // Query for a specific type of device or brand
@@ -174,29 +213,77 @@ namespace ocl {
   */
 
   private:
+    std::shared_ptr<const DeviceProperties> properties_;
+
+    // The snapshot of 'device', queried on first use of the device
+    static std::shared_ptr<const DeviceProperties> GetProperties(cl_device_id device) {
+      static std::mutex mutex;
+      static std::map<cl_device_id, std::shared_ptr<const DeviceProperties>> snapshots;
+      std::lock_guard<std::mutex> lock(mutex);
+      auto &properties = snapshots[device];
+      if (!properties) {
+        properties = QueryProperties(device);
+      }
+      return properties;
+    }
+
+    static std::shared_ptr<const DeviceProperties> QueryProperties(cl_device_id device) {
+      auto properties = std::make_shared<DeviceProperties>();
+      properties->platform = GetInfo<cl_platform_id>(device, CL_DEVICE_PLATFORM);
+      properties->name = GetInfoString(device, CL_DEVICE_NAME);
+      properties->vendor = GetInfoString(device, CL_DEVICE_VENDOR);
+      properties->version = GetInfoString(device, CL_DEVICE_VERSION);
+      properties->driver_version = GetInfoString(device, CL_DRIVER_VERSION);
+      properties->type = GetInfo<cl_device_type>(device, CL_DEVICE_TYPE);
+      properties->max_work_group_size = GetInfo<size_t>(device, CL_DEVICE_MAX_WORK_GROUP_SIZE);
+      properties->max_work_item_dimensions = static_cast<size_t>(
+        GetInfo<cl_uint>(device, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS)
+      );
+      properties->max_work_item_sizes = GetInfoVector<size_t>(device, CL_DEVICE_MAX_WORK_ITEM_SIZES);
+      properties->local_mem_size = GetInfo<cl_ulong>(device, CL_DEVICE_LOCAL_MEM_SIZE);
+      properties->global_mem_size = GetInfo<cl_ulong>(device, CL_DEVICE_GLOBAL_MEM_SIZE);
+      properties->max_alloc_size = GetInfo<cl_ulong>(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE);
+      properties->compute_units = static_cast<size_t>(GetInfo<cl_uint>(device, CL_DEVICE_MAX_COMPUTE_UNITS));
+      properties->core_clock = static_cast<size_t>(GetInfo<cl_uint>(device, CL_DEVICE_MAX_CLOCK_FREQUENCY));
+      properties->mem_base_addr_align = GetInfo<cl_uint>(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN);
+      properties->host_unified_memory = GetInfo<cl_bool>(device, CL_DEVICE_HOST_UNIFIED_MEMORY) == CL_TRUE;
+      properties->queue_properties = GetInfo<cl_command_queue_properties>(device, CL_DEVICE_QUEUE_PROPERTIES);
+
+      properties->extensions = GetInfoString(device, CL_DEVICE_EXTENSIONS);
+      std::istringstream extensions(properties->extensions);
+      std::string extension;
+      while (extensions >> extension) {
+        properties->extension_set.insert(extension);
+      }
+      properties->supports_fp64 = properties->HasExtension("cl_khr_fp64");
+      // Mali-T628 supports fp16 but not cl_khr_fp16 officially
+      properties->supports_fp16 = properties->HasExtension("cl_khr_fp16") || properties->name == "Mali-T628";
+      return properties;
+    }
+
     // Private helper functions
     template <typename T>
-    T GetInfo(const cl_device_info info) const {
+    static T GetInfo(cl_device_id device, const cl_device_info info) {
       auto bytes = size_t{0};
-      CL_CHECK_ERROR(clGetDeviceInfo(object_, info, 0, nullptr, &bytes));
+      CL_CHECK_ERROR(clGetDeviceInfo(device, info, 0, nullptr, &bytes));
       auto result = T(0);
-      CL_CHECK_ERROR(clGetDeviceInfo(object_, info, bytes, &result, nullptr));
+      CL_CHECK_ERROR(clGetDeviceInfo(device, info, bytes, &result, nullptr));
       return result;
     }
     template <typename T>
-    std::vector<T> GetInfoVector(const cl_device_info info) const {
+    static std::vector<T> GetInfoVector(cl_device_id device, const cl_device_info info) {
       auto bytes = size_t{0};
-      CL_CHECK_ERROR(clGetDeviceInfo(object_, info, 0, nullptr, &bytes));
+      CL_CHECK_ERROR(clGetDeviceInfo(device, info, 0, nullptr, &bytes));
       auto result = std::vector<T>(bytes/sizeof(T));
-      CL_CHECK_ERROR(clGetDeviceInfo(object_, info, bytes, result.data(), nullptr));
+      CL_CHECK_ERROR(clGetDeviceInfo(device, info, bytes, result.data(), nullptr));
       return result;
     }
-    std::string GetInfoString(const cl_device_info info) const {
+    static std::string GetInfoString(cl_device_id device, const cl_device_info info) {
       auto bytes = size_t{0};
-      CL_CHECK_ERROR(clGetDeviceInfo(object_, info, 0, nullptr, &bytes));
+      CL_CHECK_ERROR(clGetDeviceInfo(device, info, 0, nullptr, &bytes));
       auto result = std::string{};
       result.resize(bytes);
-      CL_CHECK_ERROR(clGetDeviceInfo(object_, info, bytes, &result[0], nullptr));
+      CL_CHECK_ERROR(clGetDeviceInfo(device, info, bytes, &result[0], nullptr));
       result.resize(strlen(result.c_str())); // Removes any trailing '\0'-characters
       return result;
     }
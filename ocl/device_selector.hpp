@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief Every device of every platform
+  inline std::vector<Device> GetAllDevices() {
+    std::vector<Device> devices;
+    for (const auto& platform : GetAllPlatforms()) {
+      for (size_t i = 0; i < platform.GetNumDevices(); i++) {
+        devices.emplace_back(platform, i);
+      }
+    }
+    return devices;
+  }
+
+
+  /// @brief Requirements of SelectDevice / SelectDevices; the defaults
+  /// accept any device
+  struct DeviceCriteria {
+    cl_device_type type = CL_DEVICE_TYPE_ALL;   // e.g. CL_DEVICE_TYPE_GPU
+    std::string name;                           // substring of the device name
+    size_t min_compute_units = 0;
+    cl_ulong min_global_mem_size = 0;           // bytes
+    cl_ulong min_alloc_size = 0;                // bytes
+    std::vector<std::string> required_extensions;
+
+    /// @brief Criteria from the environment: OCL_DEVICE_TYPE (CPU, GPU or
+    /// ACCELERATOR) and OCL_DEVICE (substring of the device name)
+    static DeviceCriteria FromEnvironment() {
+      DeviceCriteria criteria;
+      const char* type = getenv("OCL_DEVICE_TYPE");
+      if (type != nullptr) {
+        const std::string type_name = type;
+        if (type_name == "CPU") { criteria.type = CL_DEVICE_TYPE_CPU; }
+        else if (type_name == "GPU") { criteria.type = CL_DEVICE_TYPE_GPU; }
+        else if (type_name == "ACCELERATOR") { criteria.type = CL_DEVICE_TYPE_ACCELERATOR; }
+        else if (!type_name.empty()) {
+          throw std::runtime_error("Unknown OCL_DEVICE_TYPE '" + type_name + "'.");
+        }
+      }
+      const char* name = getenv("OCL_DEVICE");
+      if (name != nullptr) {
+        criteria.name = name;
+      }
+      return criteria;
+    }
+
+    bool Accepts(const DeviceProperties& properties) const {
+      if ((properties.type & type) == 0
+          || properties.name.find(name) == std::string::npos
+          || properties.compute_units < min_compute_units
+          || properties.global_mem_size < min_global_mem_size
+          || properties.max_alloc_size < min_alloc_size) {
+        return false;
+      }
+      for (const auto& extension : required_extensions) {
+        if (!properties.HasExtension(extension)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }; // struct DeviceCriteria
+
+
+  /// @brief Rough compute throughput used to rank devices: GPUs and
+  /// accelerators before CPUs, then compute units times clock, then memory
+  inline bool IsFasterDevice(const DeviceProperties& lhs, const DeviceProperties& rhs) {
+    const bool lhs_cpu = (lhs.type & CL_DEVICE_TYPE_CPU) != 0;
+    const bool rhs_cpu = (rhs.type & CL_DEVICE_TYPE_CPU) != 0;
+    if (lhs_cpu != rhs_cpu) {
+      return rhs_cpu;
+    }
+    const size_t lhs_throughput = lhs.compute_units * std::max<size_t>(1, lhs.core_clock);
+    const size_t rhs_throughput = rhs.compute_units * std::max<size_t>(1, rhs.core_clock);
+    if (lhs_throughput != rhs_throughput) {
+      return lhs_throughput > rhs_throughput;
+    }
+    return lhs.global_mem_size > rhs.global_mem_size;
+  }
+
+  /// @brief Every device meeting 'criteria', fastest first
+  inline std::vector<Device> SelectDevices(const DeviceCriteria& criteria=DeviceCriteria()) {
+    std::vector<Device> devices;
+    for (const auto& device : GetAllDevices()) {
+      if (criteria.Accepts(device.Properties())) {
+        devices.push_back(device);
+      }
+    }
+    std::stable_sort(devices.begin(), devices.end(), [](const Device& lhs, const Device& rhs) {
+      return IsFasterDevice(lhs.Properties(), rhs.Properties());
+    });
+    return devices;
+  }
+
+  /// @brief The fastest device meeting 'criteria'. Throws if there is none.
+  inline Device SelectDevice(const DeviceCriteria& criteria=DeviceCriteria()) {
+    auto devices = SelectDevices(criteria);
+    if (devices.empty()) {
+      throw std::runtime_error("No OpenCL device meets the criteria.");
+    }
+    return devices.front();
+  }
+
+} // namespace cl
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief C++ 11 supported cl_event
+  ///
+  /// Returned by the enqueue calls. The timestamps are only available for
+  /// commands submitted to a queue created with CL_QUEUE_PROFILING_ENABLE,
+  /// once the command has completed.
+  class Event : public ObjectBase<cl_event> {
+  public:
+    typedef ObjectBase<cl_event> Base;
+
+    Event() : Base() {}
+
+    /// @brief Take ownership of an event returned by an enqueue call.
+    /// Note that, unlike the other wrappers, this does not retain the event.
+    explicit Event(cl_event event) {
+      object_ = event;
+    }
+
+    virtual ~Event() {}
+
+    /// @brief Block until the command has completed
+    void Wait() const {
+      CL_CHECK_ERROR(clWaitForEvents(1, &object_));
+    }
+
+    /// @brief Execution status (CL_QUEUED, CL_SUBMITTED, CL_RUNNING, CL_COMPLETE
+    /// or a negative error code)
+    cl_int Status() const {
+      cl_int status = 0;
+      CL_CHECK_ERROR(
+        clGetEventInfo(
+          object_,
+          CL_EVENT_COMMAND_EXECUTION_STATUS,
+          sizeof(cl_int),
+          &status,
+          nullptr
+        )
+      );
+      return status;
+    }
+
+    // Device timestamps in nanoseconds
+    cl_ulong QueuedTime() const { return GetProfilingInfo(CL_PROFILING_COMMAND_QUEUED); }
+    cl_ulong SubmitTime() const { return GetProfilingInfo(CL_PROFILING_COMMAND_SUBMIT); }
+    cl_ulong StartTime() const { return GetProfilingInfo(CL_PROFILING_COMMAND_START); }
+    cl_ulong EndTime() const { return GetProfilingInfo(CL_PROFILING_COMMAND_END); }
+
+    // Durations in seconds
+    /// @brief Time the command waited in the host queue before submission
+    double QueuedDuration() const { return Seconds(QueuedTime(), SubmitTime()); }
+    /// @brief Time between submission to the device and the start of execution
+    double SubmitDuration() const { return Seconds(SubmitTime(), StartTime()); }
+    /// @brief Launch latency: from enqueue to the start of execution
+    double LaunchLatency() const { return Seconds(QueuedTime(), StartTime()); }
+    /// @brief Execution time on the device
+    double Duration() const { return Seconds(StartTime(), EndTime()); }
+
+  private:
+    cl_ulong GetProfilingInfo(const cl_profiling_info info) const {
+      cl_ulong time = 0;
+      CL_CHECK_ERROR(clGetEventProfilingInfo(object_, info, sizeof(cl_ulong), &time, nullptr));
+      return time;
+    }
+
+    static double Seconds(cl_ulong begin, cl_ulong end) {
+      return end > begin ? static_cast<double>(end - begin) * 1e-9 : 0.0;
+    }
+  }; // class Event
+
+
+  /// @brief Raw handles of a list of events, e.g. for an event wait list
+  inline std::vector<cl_event> GetRawEvents(const std::vector<Event>& events) {
+    std::vector<cl_event> raw_events;
+    raw_events.reserve(events.size());
+    for (const auto& event : events) {
+      raw_events.push_back(event());
+    }
+    return raw_events;
+  }
+
+  /// @brief Block until all events have completed
+  inline void WaitForEvents(const std::vector<Event>& events) {
+    if (events.empty()) {
+      return;
+    }
+    auto raw_events = GetRawEvents(events);
+    CL_CHECK_ERROR(clWaitForEvents(static_cast<cl_uint>(raw_events.size()), raw_events.data()));
+  }
+
+} // namespace cl
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief Handle of an enqueued command that can be waited on, polled,
+  /// used as a dependency of later enqueues, or given continuations.
+  ///
+  /// Completion is tracked with clSetEventCallback, so the host never has
+  /// to block on CommandQueue::Finish(). Continuations run on the thread of
+  /// the OpenCL runtime that delivers the callback: they must be short, must
+  /// not throw and must not block on OpenCL calls (e.g. wait on a future).
+  class Future {
+  public:
+    Future() {}
+
+    /// @brief Track the completion of 'event'
+    explicit Future(Event event)
+      : event_(std::move(event)), state_(std::make_shared<State>()) {
+      // Owned by OnComplete once the callback is registered
+      std::unique_ptr<std::shared_ptr<State>> holder(new std::shared_ptr<State>(state_));
+      CL_CHECK_ERROR(
+        clSetEventCallback(
+          event_(),
+          CL_COMPLETE,
+          &Future::OnComplete,
+          holder.get()
+        )
+      );
+      holder.release();
+    }
+
+    /// @brief False for a default-constructed future, which stands for no
+    /// work: it is always ready and waiting on it returns at once
+    bool Valid() const { return state_ != nullptr; }
+
+    /// @brief Whether the command has finished and its continuations ran
+    bool Ready() const {
+      if (!Valid()) {
+        return true;
+      }
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      return state_->done;
+    }
+
+    /// @brief CL_COMPLETE on success, a negative error code on failure, or
+    /// CL_QUEUED while not done
+    cl_int Status() const {
+      if (!Valid()) {
+        return CL_COMPLETE;
+      }
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      return state_->done ? state_->status : CL_QUEUED;
+    }
+
+    /// @brief Block until the command has finished and its continuations
+    /// ran. Throws if the command failed.
+    void Wait() const {
+      if (!Valid()) {
+        return;
+      }
+      // Waiting on the event also flushes its queue
+      cl_event event = event_();
+      clWaitForEvents(1, &event);
+
+      std::unique_lock<std::mutex> lock(state_->mutex);
+      state_->done_cv.wait(lock, [this] { return state_->done; });
+      if (state_->status < 0) {
+        throw std::runtime_error("Command failed with status: " + std::to_string(state_->status) + ".");
+      }
+    }
+
+    /// @brief Run 'continuation' once the command has completed successfully.
+    /// The returned future completes after the continuation, so enqueues
+    /// depending on it also wait for the host work. It fails with the
+    /// status of this future, or with CL_INVALID_OPERATION if the
+    /// continuation throws. On a future that is not Valid, the continuation
+    /// runs right away on the calling thread and no work is returned.
+    Future Then(std::function<void()> continuation) const {
+      if (!Valid()) {
+        continuation();
+        return Future();
+      }
+      cl_context context = nullptr;
+      CL_CHECK_ERROR(clGetEventInfo(event_(), CL_EVENT_CONTEXT, sizeof(cl_context), &context, nullptr));
+      cl_int status = 0;
+      cl_event user_event = clCreateUserEvent(context, &status);
+      if (status != CL_SUCCESS) {
+        throw std::runtime_error("Failed to create user event.");
+      }
+      Future next{Event(user_event)};
+
+      // The continuation holds its own reference until it sets the status
+      CL_CHECK_ERROR(clRetainEvent(user_event));
+      AddContinuation([continuation, user_event](cl_int status) {
+        if (status >= 0) {
+          try {
+            continuation();
+            status = CL_COMPLETE;
+          } catch (...) {
+            status = CL_INVALID_OPERATION;
+          }
+        }
+        clSetUserEventStatus(user_event, status);
+        clReleaseEvent(user_event);
+      });
+      return next;
+    }
+
+    const Event& GetEvent() const { return event_; }
+
+    /// @brief Raw events of a list of futures, for an event wait list.
+    /// Futures that are not Valid stand for no work and are left out.
+    static std::vector<cl_event> Events(const std::vector<Future>& futures) {
+      std::vector<cl_event> events;
+      events.reserve(futures.size());
+      for (const auto& future : futures) {
+        if (future.Valid()) {
+          events.push_back(future.event_());
+        }
+      }
+      return events;
+    }
+
+  private:
+    struct State {
+      std::mutex mutex;
+      std::condition_variable done_cv;
+      bool done = false;
+      bool completed = false;   // callback delivered, continuations may be running
+      cl_int status = CL_QUEUED;
+      std::vector<std::function<void(cl_int)>> continuations;
+    }; // struct State
+
+    Event event_;
+    std::shared_ptr<State> state_;
+
+    // Run 'continuation' with the command status, right away when the
+    // command has already completed
+    void AddContinuation(std::function<void(cl_int)> continuation) const {
+      cl_int status = CL_QUEUED;
+      {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->completed) {
+          state_->continuations.push_back(std::move(continuation));
+          return;
+        }
+        status = state_->status;
+      }
+      continuation(status);
+    }
+
+    static void CL_CALLBACK OnComplete(cl_event, cl_int status, void* user_data) {
+      std::unique_ptr<std::shared_ptr<State>> holder(static_cast<std::shared_ptr<State>*>(user_data));
+      State& state = **holder;
+
+      std::vector<std::function<void(cl_int)>> continuations;
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.completed = true;
+        state.status = status;
+        continuations.swap(state.continuations);
+      }
+      for (auto& continuation : continuations) {
+        continuation(status);
+      }
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.done = true;
+      }
+      state.done_cv.notify_all();
+    }
+  }; // class Future
+
+
+  /// @brief Future completing when all 'futures' have, e.g. to join several
+  /// streams of work before one enqueue or one continuation
+  inline Future WhenAll(CommandQueue& queue, const std::vector<Future>& futures) {
+    auto events = Future::Events(futures);
+    cl_event event = nullptr;
+    CL_CHECK_ERROR(
+      clEnqueueMarkerWithWaitList(
+        queue(),
+        static_cast<cl_uint>(events.size()),
+        events.empty() ? nullptr : events.data(),
+        &event
+      )
+    );
+    queue.Flush();
+    return Future(Event(event));
+  }
+
+} // namespace cl
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string.h>
+
+#include <cstddef>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define OCL_HALF_X86
+#endif
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief IEEE 754 binary16 bits of 'value', rounded to nearest even;
+  /// overflow gives infinity and NaNs stay NaNs
+  inline cl_half FloatToHalf(float value) {
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t abs_bits = bits & 0x7fffffffu;
+
+    if (abs_bits >= 0x7f800000u) {
+      // Inf or NaN, keeping NaNs quiet
+      return static_cast<cl_half>(sign | 0x7c00u | (abs_bits > 0x7f800000u ? 0x0200u : 0u));
+    }
+    if (abs_bits >= 0x477ff000u) {
+      // Rounds to 65520 or more
+      return static_cast<cl_half>(sign | 0x7c00u);
+    }
+    if (abs_bits < 0x38800000u) {
+      // Subnormal half (or zero): align the mantissa and round
+      if (abs_bits < 0x33000000u) {
+        return static_cast<cl_half>(sign);
+      }
+      const uint32_t exponent = abs_bits >> 23;
+      const uint32_t mantissa = (abs_bits & 0x7fffffu) | 0x800000u;
+      const uint32_t shift = 126 - exponent;
+      uint32_t half = mantissa >> shift;
+      const uint32_t remainder = mantissa & ((1u << shift) - 1);
+      const uint32_t halfway = 1u << (shift - 1);
+      if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+        half++;
+      }
+      return static_cast<cl_half>(sign | half);
+    }
+    // Normal: rebias the exponent and round the mantissa to 10 bits
+    uint32_t half = ((abs_bits - 0x38000000u) >> 13);
+    const uint32_t remainder = abs_bits & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+      half++;
+    }
+    return static_cast<cl_half>(sign | half);
+  }
+
+  /// @brief Float value of the binary16 bits 'value' (exact)
+  inline float HalfToFloat(cl_half value) {
+    const uint32_t sign = (static_cast<uint32_t>(value) & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1fu;
+    uint32_t mantissa = value & 0x3ffu;
+    uint32_t bits = 0;
+    if (exponent == 0x1fu) {
+      bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+      bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+      // Subnormal half: normalize
+      exponent = 113;
+      while ((mantissa & 0x400u) == 0) {
+        mantissa <<= 1;
+        exponent--;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+    } else {
+      bits = sign;
+    }
+    float result = 0.0f;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+
+#ifdef OCL_HALF_X86
+  __attribute__((target("avx,f16c")))
+  inline size_t FloatToHalfF16c(const float* src, cl_half* dst, size_t num_elmts) {
+    size_t i = 0;
+    for (; i + 8 <= num_elmts; i += 8) {
+      const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), half);
+    }
+    return i;
+  }
+
+  __attribute__((target("avx,f16c")))
+  inline size_t HalfToFloatF16c(const cl_half* src, float* dst, size_t num_elmts) {
+    size_t i = 0;
+    for (; i + 8 <= num_elmts; i += 8) {
+      const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+    }
+    return i;
+  }
+
+  inline bool HasF16c() {
+    static const bool has_f16c = []() {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    }();
+    return has_f16c;
+  }
+#endif
+
+  /// @brief Convert 'num_elmts' floats to half, 8 at a time with F16C when
+  /// the CPU has it; same rounding as the scalar FloatToHalf
+  inline void FloatToHalf(const float* src, cl_half* dst, size_t num_elmts) {
+    size_t i = 0;
+#ifdef OCL_HALF_X86
+    if (HasF16c()) {
+      i = FloatToHalfF16c(src, dst, num_elmts);
+    }
+#endif
+    for (; i < num_elmts; i++) {
+      dst[i] = FloatToHalf(src[i]);
+    }
+  }
+
+  /// @brief Convert 'num_elmts' halfs to float, 8 at a time with F16C when
+  /// the CPU has it
+  inline void HalfToFloat(const cl_half* src, float* dst, size_t num_elmts) {
+    size_t i = 0;
+#ifdef OCL_HALF_X86
+    if (HasF16c()) {
+      i = HalfToFloatF16c(src, dst, num_elmts);
+    }
+#endif
+    for (; i < num_elmts; i++) {
+      dst[i] = HalfToFloat(src[i]);
+    }
+  }
+
+} // namespace cl
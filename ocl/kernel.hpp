@@ -19,14 +19,14 @@ namespace ocl {
       
     }
 
-    void Run(CommandQueue& queue, 
-             cl_uint work_dim, 
-             const size_t *global_work_offset, 
-             const size_t *global_work_size, 
-             const size_t *local_work_size, 
-             cl_uint num_events_in_wait_list=0, 
-             const cl_event *event_wait_list=nullptr, 
-             cl_event *event=nullptr) {
+    Event Run(CommandQueue& queue, 
+              cl_uint work_dim, 
+              const size_t *global_work_offset, 
+              const size_t *global_work_size, 
+              const size_t *local_work_size, 
+              cl_uint num_events_in_wait_list=0, 
+              const cl_event *event_wait_list=nullptr) {
+      cl_event event = nullptr;
       CL_CHECK_ERROR(clEnqueueNDRangeKernel(
           queue(), 
           object_, 
@@ -36,9 +36,31 @@ namespace ocl {
           local_work_size,
           num_events_in_wait_list,
           event_wait_list,
-          event
+          &event
         )
       );
+      return Event(event);
+    }
+
+    /// @brief Enqueue the kernel after 'dependencies' without blocking
+    Future RunAsync(CommandQueue& queue,
+                    cl_uint work_dim,
+                    const size_t *global_work_offset,
+                    const size_t *global_work_size,
+                    const size_t *local_work_size,
+                    const std::vector<Future>& dependencies={}) {
+      auto wait_list = Future::Events(dependencies);
+      Event event = Run(
+        queue,
+        work_dim,
+        global_work_offset,
+        global_work_size,
+        local_work_size,
+        static_cast<cl_uint>(wait_list.size()),
+        wait_list.empty() ? nullptr : wait_list.data()
+      );
+      queue.Flush();
+      return Future(event);
     }
 
     // Sets all arguments in one go using parameter packs. 
@@ -0,0 +1,94 @@
+/// Micro-kernels measuring what a device can do at most, used by
+/// 'cl_info --characterize'.
+
+/// Floating-point precision of peak_flops in bits: 16, 32 or 64
+#ifndef PRECISION
+#define PRECISION 32
+#endif
+
+/// Multiply-add iterations per work-item of peak_flops
+#ifndef FLOPS_ITERATIONS
+#define FLOPS_ITERATIONS 256
+#endif
+
+/// Work-group size of local_bandwidth, a power of two
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 256
+#endif
+
+#if PRECISION == 16
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+typedef half real;
+typedef half4 real4;
+#elif PRECISION == 64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real;
+typedef double4 real4;
+#else
+typedef float real;
+typedef float4 real4;
+#endif
+
+
+/// No work at all: its launches time the runtime and scheduling overhead
+__kernel void empty() {}
+
+/// 8 independent chains of 4-wide multiply-adds, enough instruction-level
+/// parallelism to keep the arithmetic units busy without touching memory.
+/// Every work-item does FLOPS_ITERATIONS * 8 * 4 multiply-adds, i.e. twice
+/// as many floating-point operations. The sum is stored so the compiler
+/// cannot drop the chains; with a = 0.5 and b = 0.5 they converge to 1.
+/// Global work size: any
+__kernel void peak_flops(__global real* result, const float a, const float b) {
+  const real4 va = (real4)((real)a);
+  const real4 vb = (real4)((real)b);
+  real4 x0 = (real4)((real)get_local_id(0));
+  real4 x1 = x0 + (real)1;
+  real4 x2 = x0 + (real)2;
+  real4 x3 = x0 + (real)3;
+  real4 x4 = x0 + (real)4;
+  real4 x5 = x0 + (real)5;
+  real4 x6 = x0 + (real)6;
+  real4 x7 = x0 + (real)7;
+
+  for (int i = 0; i < FLOPS_ITERATIONS; i++) {
+    x0 = mad(x0, va, vb);
+    x1 = mad(x1, va, vb);
+    x2 = mad(x2, va, vb);
+    x3 = mad(x3, va, vb);
+    x4 = mad(x4, va, vb);
+    x5 = mad(x5, va, vb);
+    x6 = mad(x6, va, vb);
+    x7 = mad(x7, va, vb);
+  }
+
+  const real4 sum = ((x0 + x1) + (x2 + x3)) + ((x4 + x5) + (x6 + x7));
+  result[get_global_id(0)] = (sum.x + sum.y) + (sum.z + sum.w);
+}
+
+/// Every work-item reads 'iterations' * 4 float4 values of a local tile,
+/// each at a different offset so neither the loads nor the loop can be
+/// hoisted; consecutive work-items read consecutive elements, free of bank
+/// conflicts.
+/// Work-group: {LOCAL_SIZE}
+/// Global work size: a multiple of LOCAL_SIZE
+__kernel void local_bandwidth(__global float* result, const int iterations) {
+  __local float4 tile[LOCAL_SIZE];
+  const int lid = get_local_id(0);
+  tile[lid] = (float4)((float)lid);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  float4 sum0 = 0.0f;
+  float4 sum1 = 0.0f;
+  float4 sum2 = 0.0f;
+  float4 sum3 = 0.0f;
+  for (int i = 0; i < iterations; i++) {
+    sum0 += tile[(lid + i) & (LOCAL_SIZE - 1)];
+    sum1 += tile[(lid + i + LOCAL_SIZE / 4) & (LOCAL_SIZE - 1)];
+    sum2 += tile[(lid + i + LOCAL_SIZE / 2) & (LOCAL_SIZE - 1)];
+    sum3 += tile[(lid + i + 3 * LOCAL_SIZE / 4) & (LOCAL_SIZE - 1)];
+  }
+
+  const float4 sum = (sum0 + sum1) + (sum2 + sum3);
+  result[get_global_id(0)] = (sum.x + sum.y) + (sum.z + sum.w);
+}
@@ -4,32 +4,133 @@
 /// Note that this function is based on col-major
 #define get_2d_index(i, j, num_rows, num_cols) ((i) + (j) * (num_rows))
 
+/// Compile-time parameters, overridable with e.g. '-DTILE_SIZE=16'.
+#ifndef TILE_SIZE
 #define TILE_SIZE 2
+#endif
+/// Work per thread: number of result columns computed by each work-item of
+/// matmul_v2, and edge of the WPT x WPT micro-tile of matmul_v3. Must divide
+/// TILE_SIZE.
+#ifndef WPT
+#define WPT 1
+#endif
+#define RTS (TILE_SIZE / WPT)
+/// Depth of the local-memory tiles of matmul_v3 along K
+#ifndef TILE_K
+#define TILE_K 16
+#endif
+/// Extra elements per local-memory row of matmul_v3, so work-items reading
+/// down a column of a tile hit different banks
+#ifndef PADDING
+#define PADDING 1
+#endif
+/// matmul_v3 loads tiles 4 elements at a time when both tile edges allow it
+#if (TILE_SIZE % 4 == 0) && (TILE_K % 4 == 0)
+#define VECTOR_LOADS
+#endif
+
+/// Precision of lhs, rhs and results in bits: 16, 32 or 64, and of the
+/// accumulation (defaults to the same). PRECISION=16 with ACC_PRECISION=32
+/// stores half but computes in float through vload_half / vstore_half,
+/// which every device has; arithmetic in half needs cl_khr_fp16 and in
+/// double cl_khr_fp64.
+#ifndef PRECISION
+#define PRECISION 32
+#endif
+#ifndef ACC_PRECISION
+#define ACC_PRECISION PRECISION
+#endif
+
+#if ACC_PRECISION == 16
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+#endif
+#if PRECISION == 64 || ACC_PRECISION == 64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#if PRECISION == 16
+typedef half real;
+#elif PRECISION == 64
+typedef double real;
+#else
+typedef float real;
+#endif
+
+#if ACC_PRECISION == 16
+typedef half acc_t;
+typedef half4 acc4_t;
+#elif ACC_PRECISION == 64
+typedef double acc_t;
+typedef double4 acc4_t;
+#else
+typedef float acc_t;
+typedef float4 acc4_t;
+#endif
+
+/// Element 'index' of 'ptr' as acc_t, and back
+#if PRECISION == 16 && ACC_PRECISION != 16
+#define LOAD(ptr, index) ((acc_t)vload_half((index), (ptr)))
+#define LOAD4(ptr) convert_acc4(vload_half4(0, (ptr)))
+#define STORE(value, ptr, index) vstore_half((float)(value), (index), (ptr))
+#else
+#define LOAD(ptr, index) ((acc_t)(ptr)[index])
+#define LOAD4(ptr) convert_acc4(vload4(0, (ptr)))
+#define STORE(value, ptr, index) ((ptr)[index] = (real)(value))
+#endif
+
+#if ACC_PRECISION == 64
+#define convert_acc4(value) convert_double4(value)
+#elif ACC_PRECISION == 16
+#define convert_acc4(value) convert_half4(value)
+#else
+#define convert_acc4(value) convert_float4(value)
+#endif
+
+/// Problem sizes fixed at compile time with '-DFIXED_M=...' etc. replace the
+/// runtime arguments, so loop bounds become constants the compiler can unroll.
+#ifdef FIXED_M
+#define DIM_M FIXED_M
+#else
+#define DIM_M M
+#endif
+#ifdef FIXED_N
+#define DIM_N FIXED_N
+#else
+#define DIM_N N
+#endif
+#ifdef FIXED_K
+#define DIM_K FIXED_K
+#else
+#define DIM_K K
+#endif
 
 
 __kernel void matmul_v1(const int M, const int N, const int K,
-                        const __global float* lhs,
-                        const __global float* rhs,
-                        __global float* results) {
+                        const __global real* lhs,
+                        const __global real* rhs,
+                        __global real* results) {
   // Identify threads
   const int global_row = get_global_id(0);
   const int global_col = get_global_id(1);
 
-  float acc = 0.0f;
-  for (int k = 0; k < K; k++) {
-    int lhs_index = get_2d_index(global_row, k, M, K);
-    int rhs_index = get_2d_index(k, global_col, K, N);
-    acc += lhs[lhs_index] * rhs[rhs_index];
+  acc_t acc = 0;
+  for (int k = 0; k < DIM_K; k++) {
+    int lhs_index = get_2d_index(global_row, k, DIM_M, DIM_K);
+    int rhs_index = get_2d_index(k, global_col, DIM_K, DIM_N);
+    acc += LOAD(lhs, lhs_index) * LOAD(rhs, rhs_index);
   }
 
-  int result_index = get_2d_index(global_row, global_col, M, N);
-  results[result_index] = acc;
+  int result_index = get_2d_index(global_row, global_col, DIM_M, DIM_N);
+  STORE(acc, results, result_index);
 }
 
+/// Work-group: {TILE_SIZE, TILE_SIZE / WPT}
+/// Global work size: {M, N / WPT}
+/// M, N and K must be multiples of TILE_SIZE.
 __kernel void matmul_v2(const int M, const int N, const int K,
-                        const __global float* lhs,
-                        const __global float* rhs,
-                        __global float* results) {
+                        const __global real* lhs,
+                        const __global real* rhs,
+                        __global real* results) {
   
   // Identify threads
   const int row = get_local_id(0);
@@ -38,29 +139,167 @@ __kernel void matmul_v2(const int M, const int N, const int K,
   const int global_col = TILE_SIZE * get_group_id(1) + col; // col id of results, (0 ... N)
 
   // Prepare local memory to fit a tile of TS*TS elements of A and B
-  __local float local_lhs[TILE_SIZE][TILE_SIZE];
-  __local float local_rhs[TILE_SIZE][TILE_SIZE];
+  __local acc_t local_lhs[TILE_SIZE][TILE_SIZE];
+  __local acc_t local_rhs[TILE_SIZE][TILE_SIZE];
+
+  acc_t acc[WPT];
+  for (int w = 0; w < WPT; w++) {
+    acc[w] = 0;
+  }
 
-  float acc = 0.0f;
-  const int num_tiles = K / TILE_SIZE;
+  const int num_tiles = DIM_K / TILE_SIZE;
   for (int t = 0; t < num_tiles; t++) {
     // Load one tile of lhs & rhs into local memory
     const int tile_offset = t * TILE_SIZE;
-    //local_lhs[col][row] = lhs[tile_col * M + global_row];
-    int lhs_index = get_2d_index(global_row, tile_offset + col, M, K);
-    local_lhs[col][row] = lhs[lhs_index];
-    //local_rhs[col][row] = rhs[global_col * K + tile_row];
-    int rhs_index = get_2d_index(tile_offset + row, global_col, K, N);
-    local_rhs[col][row] = rhs[rhs_index];
+    for (int w = 0; w < WPT; w++) {
+      int lhs_index = get_2d_index(global_row, tile_offset + col + w * RTS, DIM_M, DIM_K);
+      local_lhs[col + w * RTS][row] = LOAD(lhs, lhs_index);
+      int rhs_index = get_2d_index(tile_offset + row, global_col + w * RTS, DIM_K, DIM_N);
+      local_rhs[col + w * RTS][row] = LOAD(rhs, rhs_index);
+    }
     barrier(CLK_LOCAL_MEM_FENCE);
 
     // perform the computation for a single tile
     for (int k = 0; k < TILE_SIZE; k++) {
-      acc += local_lhs[k][row] * local_rhs[col][k];
+      for (int w = 0; w < WPT; w++) {
+        acc[w] += local_lhs[k][row] * local_rhs[col + w * RTS][k];
+      }
     }
     barrier(CLK_LOCAL_MEM_FENCE);
   }
 
-  int result_index = get_2d_index(global_row, global_col, M, N);
-  results[result_index] = acc;
-} 
+  for (int w = 0; w < WPT; w++) {
+    int result_index = get_2d_index(global_row, global_col + w * RTS, DIM_M, DIM_N);
+    STORE(acc[w], results, result_index);
+  }
+}
+
+/// Load 4 consecutive elements of a column, starting at (row, col), as
+/// zeros where they fall outside the num_rows x num_cols matrix
+acc4_t load_column4(const __global real* matrix,
+                    const int row, const int col,
+                    const int num_rows, const int num_cols) {
+  if (col >= num_cols) {
+    return (acc4_t)(0);
+  }
+  const __global real* column = matrix + get_2d_index(row, col, num_rows, num_cols);
+  if (row + 3 < num_rows) {
+    return LOAD4(column);
+  }
+  return (acc4_t)(row < num_rows ? LOAD(column, 0) : (acc_t)0,
+                  row + 1 < num_rows ? LOAD(column, 1) : (acc_t)0,
+                  row + 2 < num_rows ? LOAD(column, 2) : (acc_t)0,
+                  (acc_t)0);
+}
+
+/// Register-blocked matmul for any M, N and K.
+///
+/// Each work-group computes a TILE_SIZE x TILE_SIZE tile of results and each
+/// work-item a WPT x WPT micro-tile of it, with rows and columns strided by
+/// RTS so neighbouring work-items read neighbouring local memory. lhs and
+/// rhs go through padded TILE_K deep local tiles; elements past the edges
+/// of the matrices are loaded as zeros and the results outside are skipped.
+/// With '-DACCUMULATE' the product is added to 'results' instead of
+/// overwriting them.
+///
+/// Work-group: {TILE_SIZE / WPT, TILE_SIZE / WPT}
+/// Global work size: {ceil(M / TILE_SIZE) * RTS, ceil(N / TILE_SIZE) * RTS}
+__kernel void matmul_v3(const int M, const int N, const int K,
+                        const __global real* lhs,
+                        const __global real* rhs,
+                        __global real* results) {
+
+  // Identify threads
+  const int row = get_local_id(0);
+  const int col = get_local_id(1);
+  const int tile_row = TILE_SIZE * get_group_id(0); // first row of the result tile
+  const int tile_col = TILE_SIZE * get_group_id(1); // first col of the result tile
+  const int local_id = row + col * RTS;
+
+  // lhs tile stored as [k][m] and rhs tile as [n][k], both contiguous along
+  // the direction the global matrices are
+  __local acc_t local_lhs[TILE_K][TILE_SIZE + PADDING];
+  __local acc_t local_rhs[TILE_SIZE][TILE_K + PADDING];
+
+  acc_t acc[WPT][WPT];
+  for (int wm = 0; wm < WPT; wm++) {
+    for (int wn = 0; wn < WPT; wn++) {
+      acc[wm][wn] = 0;
+    }
+  }
+
+  const int num_tiles = (DIM_K + TILE_K - 1) / TILE_K;
+  for (int t = 0; t < num_tiles; t++) {
+    const int tile_offset = t * TILE_K;
+
+#ifdef VECTOR_LOADS
+    // Load both tiles with float4 along the columns
+    for (int v = local_id; v < TILE_SIZE * TILE_K / 4; v += RTS * RTS) {
+      const int m = (v % (TILE_SIZE / 4)) * 4;
+      const int k = v / (TILE_SIZE / 4);
+      const acc4_t value = load_column4(lhs, tile_row + m, tile_offset + k, DIM_M, DIM_K);
+      local_lhs[k][m] = value.x;
+      local_lhs[k][m + 1] = value.y;
+      local_lhs[k][m + 2] = value.z;
+      local_lhs[k][m + 3] = value.w;
+    }
+    for (int v = local_id; v < TILE_K * TILE_SIZE / 4; v += RTS * RTS) {
+      const int k = (v % (TILE_K / 4)) * 4;
+      const int n = v / (TILE_K / 4);
+      const acc4_t value = load_column4(rhs, tile_offset + k, tile_col + n, DIM_K, DIM_N);
+      local_rhs[n][k] = value.x;
+      local_rhs[n][k + 1] = value.y;
+      local_rhs[n][k + 2] = value.z;
+      local_rhs[n][k + 3] = value.w;
+    }
+#else
+    for (int i = local_id; i < TILE_SIZE * TILE_K; i += RTS * RTS) {
+      const int m = i % TILE_SIZE;
+      const int k = i / TILE_SIZE;
+      const int global_row = tile_row + m;
+      const int global_k = tile_offset + k;
+      local_lhs[k][m] = global_row < DIM_M && global_k < DIM_K
+        ? LOAD(lhs, get_2d_index(global_row, global_k, DIM_M, DIM_K)) : (acc_t)0;
+    }
+    for (int i = local_id; i < TILE_K * TILE_SIZE; i += RTS * RTS) {
+      const int k = i % TILE_K;
+      const int n = i / TILE_K;
+      const int global_k = tile_offset + k;
+      const int global_col = tile_col + n;
+      local_rhs[n][k] = global_k < DIM_K && global_col < DIM_N
+        ? LOAD(rhs, get_2d_index(global_k, global_col, DIM_K, DIM_N)) : (acc_t)0;
+    }
+#endif
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Accumulate the micro-tile from registers
+    for (int k = 0; k < TILE_K; k++) {
+      acc_t lhs_reg[WPT];
+      acc_t rhs_reg[WPT];
+      for (int w = 0; w < WPT; w++) {
+        lhs_reg[w] = local_lhs[k][row + w * RTS];
+        rhs_reg[w] = local_rhs[col + w * RTS][k];
+      }
+      for (int wm = 0; wm < WPT; wm++) {
+        for (int wn = 0; wn < WPT; wn++) {
+          acc[wm][wn] += lhs_reg[wm] * rhs_reg[wn];
+        }
+      }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  for (int wm = 0; wm < WPT; wm++) {
+    const int global_row = tile_row + row + wm * RTS;
+    for (int wn = 0; wn < WPT; wn++) {
+      const int global_col = tile_col + col + wn * RTS;
+      if (global_row < DIM_M && global_col < DIM_N) {
+        const int result_index = get_2d_index(global_row, global_col, DIM_M, DIM_N);
+#ifdef ACCUMULATE
+        acc[wm][wn] += LOAD(results, result_index);
+#endif
+        STORE(acc[wm][wn], results, result_index);
+      }
+    }
+  }
+}
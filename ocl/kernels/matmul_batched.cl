@@ -0,0 +1,61 @@
+/// Get index of matrix.
+/// Note that this function is based on col-major
+#define get_2d_index(i, j, num_rows, num_cols) ((i) + (j) * (num_rows))
+
+
+/// Computes one element of one product per work-item, so a work-group of
+/// {local_size(0), local_size(1)} covers local_size(1) small matrices.
+/// Global work size: {M * N rounded up to local_size(0), batch_count rounded
+/// up to local_size(1)}
+void matmul_batched_element(const int M, const int N, const int K,
+                            const __global float* lhs,
+                            const __global float* rhs,
+                            __global float* results) {
+  const int index = get_global_id(0);
+  const int row = index % M;
+  const int col = index / M;
+
+  float acc = 0.0f;
+  for (int k = 0; k < K; k++) {
+    acc += lhs[get_2d_index(row, k, M, K)] * rhs[get_2d_index(k, col, K, N)];
+  }
+  results[get_2d_index(row, col, M, N)] = acc;
+}
+
+/// Product b reads lhs + b * lhs_stride and rhs + b * rhs_stride, and
+/// writes results + b * result_stride.
+__kernel void matmul_batched_strided(const int M, const int N, const int K,
+                                     const int batch_count,
+                                     const __global float* lhs, const int lhs_stride,
+                                     const __global float* rhs, const int rhs_stride,
+                                     __global float* results, const int result_stride) {
+  const int batch = get_global_id(1);
+  if (get_global_id(0) >= M * N || batch >= batch_count) {
+    return;
+  }
+  matmul_batched_element(
+    M, N, K,
+    lhs + batch * lhs_stride,
+    rhs + batch * rhs_stride,
+    results + batch * result_stride
+  );
+}
+
+/// Pointer-array batch: product b reads its operands at the element offsets
+/// lhs_offsets[b] and rhs_offsets[b], and writes at result_offsets[b].
+__kernel void matmul_batched_indexed(const int M, const int N, const int K,
+                                     const int batch_count,
+                                     const __global float* lhs, const __global int* lhs_offsets,
+                                     const __global float* rhs, const __global int* rhs_offsets,
+                                     __global float* results, const __global int* result_offsets) {
+  const int batch = get_global_id(1);
+  if (get_global_id(0) >= M * N || batch >= batch_count) {
+    return;
+  }
+  matmul_batched_element(
+    M, N, K,
+    lhs + lhs_offsets[batch],
+    rhs + rhs_offsets[batch],
+    results + result_offsets[batch]
+  );
+}
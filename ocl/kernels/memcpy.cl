@@ -1,22 +1,86 @@
 /// Get index of matrix.
-/// Note that this function is based on row-major
-#define get_2d_index(i, j, num_rows, num_cols) ((i) * (num_cols) + (j))
+/// Note that this function is based on col-major
+#define get_2d_index(i, j, num_rows, num_cols) ((i) + (j) * (num_rows))
 
-/// num_threads := 4
-/// blocks: {num_threads, num_threads}
-/// groups: {row_size/blocks[0], col_size/blocks[1]}
-__kernel void copy_matrix(int row_size, int col_size, 
+/// Edge of the square local-memory tile of transpose, overridable with
+/// e.g. '-DTRANSPOSE_TILE=32'
+#ifndef TRANSPOSE_TILE
+#define TRANSPOSE_TILE 16
+#endif
+
+
+/// tgt = src for a rows x cols matrix.
+/// Global work size: {rows, cols}, any work-group
+__kernel void copy_matrix(const int rows, const int cols,
                           const __global float* src,
                           __global float* tgt) {
-  int row_offset = get_group_id(0) * get_local_size(0);
-  int col_offset = get_group_id(1) * get_local_size(1);
-
-  int i = get_local_id(0) + get_local_size(1);
-  int j = get_local_id(1);  
-  
-  if (row_offset + i < row_size && col_offset + j < col_size) {
-    int index = get_2d_index(
-      row_offset + i, col_offset + j, row_size, col_size);
+  const int i = get_global_id(0);
+  const int j = get_global_id(1);
+
+  if (i < rows && j < cols) {
+    const int index = get_2d_index(i, j, rows, cols);
     tgt[index] = src[index];
   }
 }
+
+/// Copy a rows x cols sub-matrix between matrices of leading dimensions
+/// src_ld and tgt_ld, starting at the element offsets src_offset and
+/// tgt_offset.
+/// Global work size: {rows, cols}, any work-group
+__kernel void copy_strided(const int rows, const int cols,
+                           const __global float* src, const int src_offset, const int src_ld,
+                           __global float* tgt, const int tgt_offset, const int tgt_ld) {
+  const int i = get_global_id(0);
+  const int j = get_global_id(1);
+
+  if (i < rows && j < cols) {
+    tgt[tgt_offset + get_2d_index(i, j, tgt_ld, cols)] = src[src_offset + get_2d_index(i, j, src_ld, cols)];
+  }
+}
+
+/// tgt (cols x rows) = transpose of src (rows x cols).
+///
+/// A work-group reads a tile with work-items running down the columns of
+/// src and writes it back with work-items running down the columns of tgt,
+/// so both sides are coalesced. The extra column of the local tile keeps
+/// the transposed reads free of bank conflicts.
+///
+/// Row-major to column-major conversion (and back) is this same kernel.
+///
+/// Work-group: {TRANSPOSE_TILE, TRANSPOSE_TILE}
+/// Global work size: {rows, cols}, each rounded up to TRANSPOSE_TILE
+__kernel void transpose(const int rows, const int cols,
+                        const __global float* src,
+                        __global float* tgt) {
+  const int lx = get_local_id(0);
+  const int ly = get_local_id(1);
+  const int tile_row = get_group_id(0) * TRANSPOSE_TILE;
+  const int tile_col = get_group_id(1) * TRANSPOSE_TILE;
+
+  __local float tile[TRANSPOSE_TILE][TRANSPOSE_TILE + 1];
+
+  if (tile_row + lx < rows && tile_col + ly < cols) {
+    tile[ly][lx] = src[get_2d_index(tile_row + lx, tile_col + ly, rows, cols)];
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (tile_col + lx < cols && tile_row + ly < rows) {
+    tgt[get_2d_index(tile_col + lx, tile_row + ly, cols, rows)] = tile[lx][ly];
+  }
+}
+
+/// Set num_elmts elements of tgt to value, 4 per work-item.
+/// Global work size: {ceil(num_elmts / 4)}, any work-group
+__kernel void fill(const int num_elmts,
+                   const float value,
+                   __global float* tgt) {
+  const int i = get_global_id(0) * 4;
+
+  if (i + 3 < num_elmts) {
+    vstore4((float4)(value), 0, tgt + i);
+  } else {
+    for (int k = i; k < num_elmts; k++) {
+      tgt[k] = value;
+    }
+  }
+}
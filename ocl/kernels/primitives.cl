@@ -0,0 +1,160 @@
+/// Work-group reductions, prefix scans and a fused buffer comparison.
+///
+/// The element type is float, or int with '-DPRIMITIVE_INT=1' (the compare
+/// kernel is float only). Reductions run in two stages: a first launch of
+/// up to get_num_groups work-groups leaves one partial per group, a second
+/// launch of one work-group reduces the partials. Scans work on blocks of
+/// SCAN_GROUP_SIZE elements and are completed by scanning the block sums
+/// and adding them back with scan_add_offsets.
+
+/// Work-group size of the reduction kernels (a power of two)
+#ifndef REDUCE_GROUP_SIZE
+#define REDUCE_GROUP_SIZE 256
+#endif
+
+/// Work-group size, and elements per block, of the scan kernels (a power
+/// of two)
+#ifndef SCAN_GROUP_SIZE
+#define SCAN_GROUP_SIZE 256
+#endif
+
+#if PRIMITIVE_INT
+typedef int prim_t;
+#define PRIM_MAX INT_MAX
+#define PRIM_MIN INT_MIN
+#else
+typedef float prim_t;
+#define PRIM_MAX INFINITY
+#define PRIM_MIN (-INFINITY)
+#endif
+
+#define OP_SUM(a, b) ((a) + (b))
+#define OP_MAX(a, b) max((a), (b))
+#define OP_MIN(a, b) min((a), (b))
+
+
+/// Tree reduction of 'value' over the work-group; the result is valid in
+/// work-item 0. Every work-item of the group must call it.
+#define DEFINE_GROUP_REDUCE(_name, _op)                                  \
+  prim_t _name(prim_t value, __local prim_t* scratch) {                  \
+    const int lid = get_local_id(0);                                     \
+    scratch[lid] = value;                                                \
+    barrier(CLK_LOCAL_MEM_FENCE);                                        \
+    for (int offset = REDUCE_GROUP_SIZE / 2; offset > 0; offset /= 2) {  \
+      if (lid < offset) {                                                \
+        scratch[lid] = _op(scratch[lid], scratch[lid + offset]);         \
+      }                                                                  \
+      barrier(CLK_LOCAL_MEM_FENCE);                                      \
+    }                                                                    \
+    return scratch[0];                                                   \
+  }
+
+DEFINE_GROUP_REDUCE(group_reduce_sum, OP_SUM)
+DEFINE_GROUP_REDUCE(group_reduce_max, OP_MAX)
+DEFINE_GROUP_REDUCE(group_reduce_min, OP_MIN)
+
+
+/// partial[group] = op over the elements src[i] the group strides over.
+/// Global work size: any multiple of REDUCE_GROUP_SIZE
+/// Work-group: {REDUCE_GROUP_SIZE}
+#define DEFINE_REDUCE_KERNEL(_name, _op, _identity, _group_reduce)                 \
+  __kernel void _name(const int n,                                                 \
+                      const __global prim_t* src,                                  \
+                      __global prim_t* partial) {                                  \
+    __local prim_t scratch[REDUCE_GROUP_SIZE];                                     \
+    prim_t value = _identity;                                                      \
+    for (int i = get_global_id(0); i < n; i += get_global_size(0)) {               \
+      value = _op(value, src[i]);                                                  \
+    }                                                                              \
+    value = _group_reduce(value, scratch);                                         \
+    if (get_local_id(0) == 0) {                                                    \
+      partial[get_group_id(0)] = value;                                            \
+    }                                                                              \
+  }
+
+DEFINE_REDUCE_KERNEL(reduce_sum, OP_SUM, 0, group_reduce_sum)
+DEFINE_REDUCE_KERNEL(reduce_max, OP_MAX, PRIM_MIN, group_reduce_max)
+DEFINE_REDUCE_KERNEL(reduce_min, OP_MIN, PRIM_MAX, group_reduce_min)
+
+
+#if !PRIMITIVE_INT
+/// Fused first stage of comparing a and b: per work-group sum and maximum
+/// of |a[i] - b[i]|, written to partial_sum and partial_max. A NaN in either
+/// buffer makes the sum NaN. Finish with reduce_sum / reduce_max.
+/// Global work size: any multiple of REDUCE_GROUP_SIZE
+/// Work-group: {REDUCE_GROUP_SIZE}
+__kernel void compare_reduce(const int n,
+                             const __global float* a,
+                             const __global float* b,
+                             __global float* partial_sum,
+                             __global float* partial_max) {
+  __local float scratch[REDUCE_GROUP_SIZE];
+  float sum = 0.0f;
+  float max_diff = 0.0f;
+  for (int i = get_global_id(0); i < n; i += get_global_size(0)) {
+    const float diff = fabs(a[i] - b[i]);
+    sum += diff;
+    max_diff = max(max_diff, diff);
+  }
+  sum = group_reduce_sum(sum, scratch);
+  if (get_local_id(0) == 0) {
+    partial_sum[get_group_id(0)] = sum;
+  }
+  // scratch[0] is read by every work-item before it is reused
+  barrier(CLK_LOCAL_MEM_FENCE);
+  max_diff = group_reduce_max(max_diff, scratch);
+  if (get_local_id(0) == 0) {
+    partial_max[get_group_id(0)] = max_diff;
+  }
+}
+#endif
+
+
+/// Prefix sum of each block of SCAN_GROUP_SIZE elements of src into dst,
+/// inclusive or exclusive, with the block totals in block_sums[group]
+/// (Hillis-Steele in local memory, double buffered).
+/// Global work size: n rounded up to SCAN_GROUP_SIZE
+/// Work-group: {SCAN_GROUP_SIZE}
+__kernel void scan_blocks(const int n,
+                          const int exclusive,
+                          const __global prim_t* src,
+                          __global prim_t* dst,
+                          __global prim_t* block_sums) {
+  __local prim_t buffers[2][SCAN_GROUP_SIZE];
+  const int lid = get_local_id(0);
+  const int i = get_global_id(0);
+
+  int current = 0;
+  buffers[current][lid] = i < n ? src[i] : 0;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  for (int offset = 1; offset < SCAN_GROUP_SIZE; offset *= 2) {
+    const prim_t value = buffers[current][lid];
+    buffers[1 - current][lid] = lid >= offset ? value + buffers[current][lid - offset] : value;
+    current = 1 - current;
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  if (i < n) {
+    if (exclusive) {
+      dst[i] = lid > 0 ? buffers[current][lid - 1] : 0;
+    } else {
+      dst[i] = buffers[current][lid];
+    }
+  }
+  if (lid == SCAN_GROUP_SIZE - 1) {
+    block_sums[get_group_id(0)] = buffers[current][lid];
+  }
+}
+
+/// dst[i] += offsets[block of i], with 'offsets' the exclusive scan of the
+/// block sums of scan_blocks.
+/// Global work size: n rounded up to SCAN_GROUP_SIZE
+/// Work-group: {SCAN_GROUP_SIZE}
+__kernel void scan_add_offsets(const int n,
+                               const __global prim_t* offsets,
+                               __global prim_t* dst) {
+  const int i = get_global_id(0);
+  if (i < n) {
+    dst[i] += offsets[get_group_id(0)];
+  }
+}
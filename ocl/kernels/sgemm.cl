@@ -0,0 +1,225 @@
+/// BLAS-style single precision GEMM:
+///   C = alpha * op(A) * op(B) + beta * C
+/// with column-major A, B and C of leading dimensions lda, ldb and ldc, and
+/// op(X) = X or X^T. op(A) is M x K, op(B) is K x N and C is M x N.
+///
+/// Each transpose combination is its own variant: with '-DTRANS_A=1' and
+/// '-DTRANS_B=1' the tiles are loaded along the contiguous direction of the
+/// stored matrices, so every variant reads global memory coalesced. The
+/// scaling is specialized as well: '-DALPHA_ONE=1' skips the multiply by
+/// alpha and '-DBETA_MODE' selects how C is read back:
+///   0: beta == 0, C is only written (not read, so it may hold NaNs)
+///   1: beta == 1, C += alpha * op(A) * op(B)
+///   2: any other beta
+///
+/// The tiling is the one of matmul_v3 (TILE_SIZE, WPT, TILE_K, PADDING),
+/// so its tuned configurations apply.
+
+#ifndef TILE_SIZE
+#define TILE_SIZE 32
+#endif
+
+#ifndef WPT
+#define WPT 4
+#endif
+#define RTS (TILE_SIZE / WPT)
+
+#ifndef TILE_K
+#define TILE_K 16
+#endif
+
+#ifndef PADDING
+#define PADDING 1
+#endif
+
+#ifndef TRANS_A
+#define TRANS_A 0
+#endif
+
+#ifndef TRANS_B
+#define TRANS_B 0
+#endif
+
+#ifndef ALPHA_ONE
+#define ALPHA_ONE 0
+#endif
+
+#ifndef BETA_MODE
+#define BETA_MODE 2
+#endif
+
+#if (TILE_SIZE % 4 == 0) && (TILE_K % 4 == 0)
+#define VECTOR_LOADS
+#endif
+
+
+/// Load 4 consecutive stored elements of a column of a num_rows x num_cols
+/// matrix with leading dimension ld, starting at (row, col), as zeros where
+/// they fall outside the matrix
+float4 load_strided4(const __global float* matrix,
+                     const int row, const int col,
+                     const int num_rows, const int num_cols,
+                     const int ld) {
+  if (col >= num_cols) {
+    return (float4)(0.0f);
+  }
+  const __global float* column = matrix + (size_t)col * ld + row;
+  if (row + 3 < num_rows) {
+    return vload4(0, column);
+  }
+  return (float4)(row < num_rows ? column[0] : 0.0f,
+                  row + 1 < num_rows ? column[1] : 0.0f,
+                  row + 2 < num_rows ? column[2] : 0.0f,
+                  0.0f);
+}
+
+/// Element (row, col) of a num_rows x num_cols matrix with leading
+/// dimension ld, or zero outside it
+float load_strided(const __global float* matrix,
+                   const int row, const int col,
+                   const int num_rows, const int num_cols,
+                   const int ld) {
+  return row < num_rows && col < num_cols ? matrix[(size_t)col * ld + row] : 0.0f;
+}
+
+/// Work-group: {TILE_SIZE / WPT, TILE_SIZE / WPT}
+/// Global work size: {ceil(M / TILE_SIZE) * RTS, ceil(N / TILE_SIZE) * RTS}
+__kernel void sgemm(const int M, const int N, const int K,
+                    const float alpha,
+                    const __global float* A, const int lda,
+                    const __global float* B, const int ldb,
+                    const float beta,
+                    __global float* C, const int ldc) {
+
+  // Identify threads
+  const int row = get_local_id(0);
+  const int col = get_local_id(1);
+  const int tile_row = TILE_SIZE * get_group_id(0); // first row of the C tile
+  const int tile_col = TILE_SIZE * get_group_id(1); // first col of the C tile
+  const int local_id = row + col * RTS;
+
+  // op(A) tile stored as [k][m] and op(B) tile as [n][k]
+  __local float local_a[TILE_K][TILE_SIZE + PADDING];
+  __local float local_b[TILE_SIZE][TILE_K + PADDING];
+
+  float acc[WPT][WPT];
+  for (int wm = 0; wm < WPT; wm++) {
+    for (int wn = 0; wn < WPT; wn++) {
+      acc[wm][wn] = 0.0f;
+    }
+  }
+
+  const int num_tiles = (K + TILE_K - 1) / TILE_K;
+  for (int t = 0; t < num_tiles; t++) {
+    const int tile_offset = t * TILE_K;
+
+#ifdef VECTOR_LOADS
+#if TRANS_A
+    // A is K x M: its columns run along k
+    for (int v = local_id; v < TILE_SIZE * TILE_K / 4; v += RTS * RTS) {
+      const int k = (v % (TILE_K / 4)) * 4;
+      const int m = v / (TILE_K / 4);
+      const float4 value = load_strided4(A, tile_offset + k, tile_row + m, K, M, lda);
+      local_a[k][m] = value.x;
+      local_a[k + 1][m] = value.y;
+      local_a[k + 2][m] = value.z;
+      local_a[k + 3][m] = value.w;
+    }
+#else
+    for (int v = local_id; v < TILE_SIZE * TILE_K / 4; v += RTS * RTS) {
+      const int m = (v % (TILE_SIZE / 4)) * 4;
+      const int k = v / (TILE_SIZE / 4);
+      const float4 value = load_strided4(A, tile_row + m, tile_offset + k, M, K, lda);
+      local_a[k][m] = value.x;
+      local_a[k][m + 1] = value.y;
+      local_a[k][m + 2] = value.z;
+      local_a[k][m + 3] = value.w;
+    }
+#endif
+#if TRANS_B
+    // B is N x K: its columns run along n
+    for (int v = local_id; v < TILE_K * TILE_SIZE / 4; v += RTS * RTS) {
+      const int n = (v % (TILE_SIZE / 4)) * 4;
+      const int k = v / (TILE_SIZE / 4);
+      const float4 value = load_strided4(B, tile_col + n, tile_offset + k, N, K, ldb);
+      local_b[n][k] = value.x;
+      local_b[n + 1][k] = value.y;
+      local_b[n + 2][k] = value.z;
+      local_b[n + 3][k] = value.w;
+    }
+#else
+    for (int v = local_id; v < TILE_K * TILE_SIZE / 4; v += RTS * RTS) {
+      const int k = (v % (TILE_K / 4)) * 4;
+      const int n = v / (TILE_K / 4);
+      const float4 value = load_strided4(B, tile_offset + k, tile_col + n, K, N, ldb);
+      local_b[n][k] = value.x;
+      local_b[n][k + 1] = value.y;
+      local_b[n][k + 2] = value.z;
+      local_b[n][k + 3] = value.w;
+    }
+#endif
+#else
+    // Consecutive work-items take consecutive stored elements
+    for (int i = local_id; i < TILE_SIZE * TILE_K; i += RTS * RTS) {
+#if TRANS_A
+      const int k = i % TILE_K;
+      const int m = i / TILE_K;
+      local_a[k][m] = load_strided(A, tile_offset + k, tile_row + m, K, M, lda);
+#else
+      const int m = i % TILE_SIZE;
+      const int k = i / TILE_SIZE;
+      local_a[k][m] = load_strided(A, tile_row + m, tile_offset + k, M, K, lda);
+#endif
+    }
+    for (int i = local_id; i < TILE_K * TILE_SIZE; i += RTS * RTS) {
+#if TRANS_B
+      const int n = i % TILE_SIZE;
+      const int k = i / TILE_SIZE;
+      local_b[n][k] = load_strided(B, tile_col + n, tile_offset + k, N, K, ldb);
+#else
+      const int k = i % TILE_K;
+      const int n = i / TILE_K;
+      local_b[n][k] = load_strided(B, tile_offset + k, tile_col + n, K, N, ldb);
+#endif
+    }
+#endif
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Accumulate the micro-tile from registers
+    for (int k = 0; k < TILE_K; k++) {
+      float a_reg[WPT];
+      float b_reg[WPT];
+      for (int w = 0; w < WPT; w++) {
+        a_reg[w] = local_a[k][row + w * RTS];
+        b_reg[w] = local_b[col + w * RTS][k];
+      }
+      for (int wm = 0; wm < WPT; wm++) {
+        for (int wn = 0; wn < WPT; wn++) {
+          acc[wm][wn] += a_reg[wm] * b_reg[wn];
+        }
+      }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  for (int wm = 0; wm < WPT; wm++) {
+    const int global_row = tile_row + row + wm * RTS;
+    for (int wn = 0; wn < WPT; wn++) {
+      const int global_col = tile_col + col + wn * RTS;
+      if (global_row < M && global_col < N) {
+        const size_t index = (size_t)global_col * ldc + global_row;
+#if ALPHA_ONE
+        float value = acc[wm][wn];
+#else
+        float value = alpha * acc[wm][wn];
+#endif
+#if BETA_MODE == 1
+        value += C[index];
+#elif BETA_MODE == 2
+        value += beta * C[index];
+#endif
+        C[index] = value;
+      }
+    }
+  }
+}
@@ -0,0 +1,208 @@
+/// Sparse times dense products Y = A * X of a sparse rows x cols matrix A
+/// and column-major dense matrices X (cols x n) and Y (rows x n). SpMV is
+/// the n = 1 case; the second global dimension runs over the n columns.
+
+/// Work-items sharing one row in spmm_csr_vector (a power of two, at most
+/// the work-group size), overridable with e.g. '-DVECTOR_SIZE=32'
+#ifndef VECTOR_SIZE
+#define VECTOR_SIZE 8
+#endif
+
+/// Work-group size of spmm_csr_vector
+#ifndef VECTOR_GROUP_SIZE
+#define VECTOR_GROUP_SIZE 128
+#endif
+
+/// Merge-path items (row ends plus non-zeros) of one spmm_csr_merge work-item
+#ifndef ITEMS_PER_THREAD
+#define ITEMS_PER_THREAD 16
+#endif
+
+
+/// CSR, one work-item per row: no synchronization, but the work-items of a
+/// group walk rows of different lengths, so best for short, even rows.
+/// Global work size: {rows, n}, any work-group
+__kernel void spmm_csr_scalar(const int rows, const int cols, const int n,
+                              const __global int* row_offsets,
+                              const __global int* col_indices,
+                              const __global float* values,
+                              const __global float* x,
+                              __global float* y) {
+  const int i = get_global_id(0);
+  const int j = get_global_id(1);
+  if (i >= rows || j >= n) {
+    return;
+  }
+
+  const __global float* x_col = x + (size_t)j * cols;
+  float sum = 0.0f;
+  for (int k = row_offsets[i]; k < row_offsets[i + 1]; k++) {
+    sum += values[k] * x_col[col_indices[k]];
+  }
+  y[(size_t)j * rows + i] = sum;
+}
+
+/// CSR, VECTOR_SIZE work-items per row: consecutive work-items read
+/// consecutive non-zeros, and the partial sums are reduced in local memory.
+/// Best for rows longer than VECTOR_SIZE.
+/// Work-group: {VECTOR_GROUP_SIZE, 1}
+/// Global work size: {rows * VECTOR_SIZE rounded up to VECTOR_GROUP_SIZE, n}
+__kernel void spmm_csr_vector(const int rows, const int cols, const int n,
+                              const __global int* row_offsets,
+                              const __global int* col_indices,
+                              const __global float* values,
+                              const __global float* x,
+                              __global float* y) {
+  const int lid = get_local_id(0);
+  const int lane = lid % VECTOR_SIZE;
+  const int i = get_global_id(0) / VECTOR_SIZE;
+  const int j = get_global_id(1);
+
+  __local float partial[VECTOR_GROUP_SIZE];
+
+  float sum = 0.0f;
+  if (i < rows && j < n) {
+    const __global float* x_col = x + (size_t)j * cols;
+    for (int k = row_offsets[i] + lane; k < row_offsets[i + 1]; k += VECTOR_SIZE) {
+      sum += values[k] * x_col[col_indices[k]];
+    }
+  }
+  partial[lid] = sum;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Every work-item reaches the barriers, also those past the last row
+  for (int offset = VECTOR_SIZE / 2; offset > 0; offset /= 2) {
+    if (lane < offset) {
+      partial[lid] += partial[lid + offset];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  if (lane == 0 && i < rows && j < n) {
+    y[(size_t)j * rows + i] = partial[lid];
+  }
+}
+
+/// Merge-path CSR: the sequence of row ends and non-zeros (rows + nnz
+/// items) is split evenly over the work-items, so every work-item does the
+/// same work however skewed the row lengths are.
+///
+/// A work-item finds its start on the path with a binary search, writes the
+/// rows that end in its range and leaves the partial sum of the row it stops
+/// in as a carry (row, value) for spmm_merge_fixup. Rows ending in the range
+/// of a work-item are only written by that work-item.
+/// Global work size: {num_threads = ceil((rows + nnz) / ITEMS_PER_THREAD), n}
+__kernel void spmm_csr_merge(const int rows, const int cols, const int n,
+                             const __global int* row_offsets,
+                             const __global int* col_indices,
+                             const __global float* values,
+                             const __global float* x,
+                             __global float* y,
+                             const int num_threads,
+                             __global int* carry_rows,
+                             __global float* carry_values) {
+  const int t = get_global_id(0);
+  const int j = get_global_id(1);
+  if (t >= num_threads || j >= n) {
+    return;
+  }
+
+  const int nnz = row_offsets[rows];
+  const int path_length = rows + nnz;
+  const int diagonal = min(t * ITEMS_PER_THREAD, path_length);
+  const int diagonal_end = min(diagonal + ITEMS_PER_THREAD, path_length);
+
+  // First path item on 'diagonal': the number of row ends before it
+  int lo = max(diagonal - nnz, 0);
+  int hi = min(diagonal, rows);
+  while (lo < hi) {
+    const int pivot = (lo + hi) / 2;
+    if (row_offsets[pivot + 1] <= diagonal - pivot - 1) {
+      lo = pivot + 1;
+    } else {
+      hi = pivot;
+    }
+  }
+  int row = lo;
+  int k = diagonal - lo;
+
+  const __global float* x_col = x + (size_t)j * cols;
+  __global float* y_col = y + (size_t)j * rows;
+  float sum = 0.0f;
+  for (int item = diagonal; item < diagonal_end; item++) {
+    if (row < rows && k < row_offsets[row + 1]) {
+      sum += values[k] * x_col[col_indices[k]];
+      k++;
+    } else {
+      y_col[row] = sum;
+      sum = 0.0f;
+      row++;
+    }
+  }
+
+  carry_rows[(size_t)j * num_threads + t] = row;
+  carry_values[(size_t)j * num_threads + t] = sum;
+}
+
+/// Add the carries of spmm_csr_merge to y. Carries of one row come from
+/// consecutive work-items; the first of each run adds them all, so no two
+/// work-items update the same element.
+/// Global work size: {num_threads, n}, any work-group
+__kernel void spmm_merge_fixup(const int rows, const int n,
+                               const int num_threads,
+                               const __global int* carry_rows,
+                               const __global float* carry_values,
+                               __global float* y) {
+  const int t = get_global_id(0);
+  const int j = get_global_id(1);
+  if (t >= num_threads || j >= n) {
+    return;
+  }
+
+  const __global int* rows_col = carry_rows + (size_t)j * num_threads;
+  const __global float* values_col = carry_values + (size_t)j * num_threads;
+  const int row = rows_col[t];
+  if (row >= rows || (t > 0 && rows_col[t - 1] == row)) {
+    return;
+  }
+
+  float sum = 0.0f;
+  for (int u = t; u < num_threads && rows_col[u] == row; u++) {
+    sum += values_col[u];
+  }
+  y[(size_t)j * rows + row] += sum;
+}
+
+/// Sliced ELLPACK, one work-item per row. Rows are grouped in slices of
+/// slice_size rows, each padded to the longest row of its slice and stored
+/// column by column, so the work-items of a slice read consecutive
+/// addresses. Padding has the column index -1 and ends a row.
+/// Global work size: {rows, n}, any work-group
+__kernel void spmm_ell(const int rows, const int cols, const int n,
+                       const int slice_size,
+                       const __global int* slice_offsets,
+                       const __global int* col_indices,
+                       const __global float* values,
+                       const __global float* x,
+                       __global float* y) {
+  const int i = get_global_id(0);
+  const int j = get_global_id(1);
+  if (i >= rows || j >= n) {
+    return;
+  }
+
+  const int slice = i / slice_size;
+  const int start = slice_offsets[slice] + i % slice_size;
+  const int end = slice_offsets[slice + 1];
+
+  const __global float* x_col = x + (size_t)j * cols;
+  float sum = 0.0f;
+  for (int k = start; k < end; k += slice_size) {
+    const int col = col_indices[k];
+    if (col < 0) {
+      break;
+    }
+    sum += values[k] * x_col[col];
+  }
+  y[(size_t)j * rows + i] = sum;
+}
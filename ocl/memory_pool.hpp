@@ -0,0 +1,214 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief Counters reported by MemoryPool
+  struct MemoryPoolStats {
+    size_t hits = 0;            // allocations served from the cache
+    size_t misses = 0;          // allocations that called clCreateBuffer
+    size_t releases = 0;        // cached blocks released to stay under the limit
+    size_t bytes_in_use = 0;    // size-class bytes handed out to buffers
+    size_t bytes_requested = 0; // bytes actually requested by those buffers
+    size_t bytes_cached = 0;    // bytes held in the bins, ready for reuse
+    size_t peak_bytes = 0;      // peak of bytes_in_use + bytes_cached
+
+    size_t BytesHeld() const { return bytes_in_use + bytes_cached; }
+
+    /// @brief Fraction of the held device memory that is not requested by
+    /// any live buffer (size-class rounding plus cached blocks)
+    double Fragmentation() const {
+      const size_t held = BytesHeld();
+      return held > 0 ? 1.0 - static_cast<double>(bytes_requested) / held : 0.0;
+    }
+  };
+
+
+  /// @brief Caching device memory allocator of one context.
+  ///
+  /// Buffer<T> objects created from the pool take their storage from
+  /// size-class bins and give it back when the last copy is destroyed,
+  /// instead of calling clCreateBuffer/clReleaseMemObject each time. The
+  /// pool never holds more than 'high_water_mark' bytes (0 means no limit):
+  /// cached blocks are released first, and an allocation that still does
+  /// not fit throws.
+  class MemoryPool {
+  private:
+    struct State;
+
+  public:
+    /// @brief A block of pooled device memory. Returned to its pool (or
+    /// released when the pool is gone) on destruction.
+    class Block {
+    public:
+      Block(const std::shared_ptr<State>& state, cl_mem mem, size_t size, size_t requested)
+        : state_(state), mem_(mem), size_(size), requested_(requested) {}
+
+      ~Block() {
+        auto state = state_.lock();
+        if (state) {
+          state->Return(mem_, size_, requested_);
+        } else {
+          clReleaseMemObject(mem_);
+        }
+      }
+
+      Block(const Block&) = delete;
+      Block& operator= (const Block&) = delete;
+
+      cl_mem Memory() const { return mem_; }
+      size_t Size() const { return size_; }
+
+    private:
+      std::weak_ptr<State> state_;
+      cl_mem mem_;
+      size_t size_;
+      size_t requested_;
+    }; // class Block
+
+    explicit MemoryPool(const Context& context, size_t high_water_mark=0)
+      : state_(std::make_shared<State>(context, high_water_mark)) {}
+
+    ~MemoryPool() {
+      Trim();
+    }
+
+    MemoryPool(const MemoryPool&) = delete;
+    MemoryPool& operator= (const MemoryPool&) = delete;
+
+    /// @brief Get a block of at least 'bytes' bytes
+    std::shared_ptr<Block> Allocate(size_t bytes) {
+      const size_t size = SizeClass(bytes);
+      cl_mem mem = state_->Acquire(size, bytes);
+      return std::make_shared<Block>(state_, mem, size, bytes);
+    }
+
+    /// @brief Release all cached blocks
+    void Trim() {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      state_->ReleaseCached(0);
+    }
+
+    void SetHighWaterMark(size_t high_water_mark) {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      state_->high_water_mark = high_water_mark;
+      state_->ReleaseCached(high_water_mark);
+    }
+
+    MemoryPoolStats Stats() const {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      return state_->stats;
+    }
+
+    void PrintStats(std::ostream& os) const {
+      MemoryPoolStats stats = Stats();
+      os << "memory pool: " << stats.hits << " hits, "
+         << stats.misses << " misses, "
+         << stats.bytes_in_use << " bytes in use, "
+         << stats.bytes_cached << " bytes cached, "
+         << stats.peak_bytes << " bytes peak, "
+         << "fragmentation " << stats.Fragmentation() << std::endl;
+    }
+
+    /// @brief Size class of an allocation: four classes per power of two,
+    /// with a minimum of 256 bytes
+    static size_t SizeClass(size_t bytes) {
+      const size_t min_size = 256;
+      if (bytes <= min_size) {
+        return min_size;
+      }
+      size_t power = min_size;
+      while (power * 2 < bytes) {
+        power *= 2;
+      }
+      const size_t step = power / 4;
+      return (bytes + step - 1) / step * step;
+    }
+
+  private:
+    struct State {
+      State(const Context& context, size_t high_water_mark)
+        : context(context), high_water_mark(high_water_mark) {}
+
+      ~State() {
+        ReleaseCached(0);
+      }
+
+      Context context;
+      size_t high_water_mark;
+      std::map<size_t, std::vector<cl_mem>> bins;
+      MemoryPoolStats stats;
+      std::mutex mutex;
+
+      cl_mem Acquire(size_t size, size_t requested) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& bin = bins[size];
+        if (!bin.empty()) {
+          cl_mem mem = bin.back();
+          bin.pop_back();
+          stats.hits++;
+          stats.bytes_cached -= size;
+          stats.bytes_in_use += size;
+          stats.bytes_requested += requested;
+          return mem;
+        }
+
+        if (high_water_mark != 0) {
+          if (stats.bytes_in_use + size > high_water_mark) {
+            throw std::runtime_error(
+              "MemoryPool: allocation of " + std::to_string(size)
+              + " bytes exceeds the high-water mark."
+            );
+          }
+          ReleaseCached(high_water_mark - size);
+        }
+
+        cl_int status = 0;
+        cl_mem mem = clCreateBuffer(context(), CL_MEM_READ_WRITE, size, nullptr, &status);
+        if (status == CL_MEM_OBJECT_ALLOCATION_FAILURE || status == CL_OUT_OF_RESOURCES) {
+          // Give the cached blocks back to the driver and try once more
+          ReleaseCached(0);
+          mem = clCreateBuffer(context(), CL_MEM_READ_WRITE, size, nullptr, &status);
+        }
+        if (status != CL_SUCCESS) {
+          throw std::runtime_error("Failed to create memory.");
+        }
+        stats.misses++;
+        stats.bytes_in_use += size;
+        stats.bytes_requested += requested;
+        stats.peak_bytes = std::max(stats.peak_bytes, stats.BytesHeld());
+        return mem;
+      }
+
+      void Return(cl_mem mem, size_t size, size_t requested) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.bytes_in_use -= size;
+        stats.bytes_requested -= requested;
+        bins[size].push_back(mem);
+        stats.bytes_cached += size;
+      }
+
+      // Release cached blocks, largest first, until at most 'limit' bytes
+      // are held. The caller holds the mutex.
+      void ReleaseCached(size_t limit) {
+        for (auto it = bins.rbegin(); it != bins.rend() && stats.BytesHeld() > limit; ++it) {
+          auto& bin = it->second;
+          while (!bin.empty() && stats.BytesHeld() > limit) {
+            clReleaseMemObject(bin.back());
+            bin.pop_back();
+            stats.bytes_cached -= it->first;
+            stats.releases++;
+          }
+        }
+      }
+    }; // struct State
+
+    std::shared_ptr<State> state_;
+  }; // class MemoryPool
+
+} // namespace cl
@@ -1,10 +1,20 @@
 #pragma once
 
 #include "ocl/common.h"
+#include "ocl/aligned_allocator.hpp"
+#include "ocl/half.hpp"
 #include "ocl/platform.hpp"
 #include "ocl/device.hpp"
+#include "ocl/device_selector.hpp"
 #include "ocl/context.hpp"
 #include "ocl/program.hpp"
+#include "ocl/program_cache.hpp"
 #include "ocl/command_queue.hpp"
+#include "ocl/event.hpp"
+#include "ocl/future.hpp"
+#include "ocl/memory_pool.hpp"
 #include "ocl/buffer.hpp"
-#include "ocl/kernel.hpp"
\ No newline at end of file
+#include "ocl/kernel.hpp"
+#include "ocl/typed_kernel.hpp"
+#include "ocl/program_variants.hpp"
+#include "ocl/task_graph.hpp"
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 //#include <numeric>
+#include <iostream>
 
 #include "ocl/common.h"
 
@@ -48,11 +49,53 @@ namespace ocl {
 
     virtual ~Program() {}
 
+    /// @brief Get the device binary of a built program (CL_PROGRAM_BINARIES).
+    /// The program is expected to be built for a single device.
+    std::string Binary() const {
+      size_t binary_size = 0;
+      CL_CHECK_ERROR(
+        clGetProgramInfo(
+          object_, 
+          CL_PROGRAM_BINARY_SIZES, 
+          sizeof(size_t), 
+          &binary_size, 
+          nullptr
+        )
+      );
+
+      std::string binary(binary_size, '\0');
+      unsigned char* binary_ptr = reinterpret_cast<unsigned char*>(&binary[0]);
+      CL_CHECK_ERROR(
+        clGetProgramInfo(
+          object_, 
+          CL_PROGRAM_BINARIES, 
+          sizeof(unsigned char*), 
+          &binary_ptr, 
+          nullptr
+        )
+      );
+      return binary;
+    }
+
+    /// @brief Build the program for the given device.
+    /// @param options Compiler options (e.g. "-DTILE_SIZE=16"), joined with spaces.
     void Build(const Device& device, const std::vector<std::string>& options) {
       const cl_device_id d = device();
 
+      std::string compile_opts("");
+      for (const auto& s : options) {
+        if (!s.empty()) {
+          compile_opts += s + std::string(" ");
+        }
+      }
+
       cl_int err = clBuildProgram(
-        object_, 1, &d, nullptr, nullptr, nullptr
+        object_, 
+        1, 
+        &d, 
+        compile_opts.empty() ? nullptr : compile_opts.c_str(), 
+        nullptr, 
+        nullptr
       );
       if (err == CL_BUILD_PROGRAM_FAILURE) {
         // Determine the size of the log
@@ -82,36 +125,11 @@ namespace ocl {
         std::cerr << log.data() << std::endl;
         throw std::runtime_error("Failed to build program");
       }
-
-      /*
-      if (options.size() != 0) {
-        std::string compile_opts("");
-        for (auto s : options) {
-          compile_opts += s + std::string(" ");
-        }
-        CL_CHECK_ERROR(
-          clBuildProgram(
-            object_,
-            1,
-            &d,
-            compile_opts.c_str(),
-            nullptr,
-            nullptr
-          )
-        );
-      } else {
-        CL_CHECK_ERROR(
-          clBuildProgram(
-            object_,
-            1,
-            &d,
-            nullptr,
-            nullptr,
-            nullptr
-          )
+      if (err != CL_SUCCESS) {
+        throw std::runtime_error(
+          "Failed to build program with status: " + std::to_string(err) + "."
         );
       }
-      */
     }
   }; // class Program
 
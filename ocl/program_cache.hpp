@@ -0,0 +1,151 @@
+#pragma once
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief Counters reported by ProgramCache
+  struct ProgramCacheStats {
+    size_t hits = 0;              // programs created from a cached binary
+    size_t misses = 0;            // programs compiled from source
+    size_t rejected = 0;          // cached binaries the driver refused
+    double compile_seconds = 0.0; // time spent building from source
+    double load_seconds = 0.0;    // time spent building from cached binaries
+  };
+
+  /// @brief Persistent on-disk cache of program binaries.
+  ///
+  /// Binaries are keyed by a hash of the kernel source, the device name,
+  /// the driver version and the build options, and stored as
+  /// '<cache_dir>/<key>.bin'. When the driver rejects a cached binary the
+  /// program is rebuilt from source and the entry is overwritten.
+  class ProgramCache {
+  public:
+    explicit ProgramCache(const std::string& cache_dir) : cache_dir_(cache_dir) {
+      if (!cache_dir_.empty()) {
+        mkdir(cache_dir_.c_str(), 0755);
+      }
+    }
+
+    /// @brief Load the program from the cache, or build it from source and
+    /// store its binary on a miss.
+    Program Get(const Device& device,
+                const Context& context,
+                const std::string& source,
+                const std::vector<std::string>& options) {
+      const std::string path = EntryPath(Key(device, source, options));
+
+      std::string binary;
+      if (ReadFile(path, binary)) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+          Program program(device, context, binary);
+          program.Build(device, options);
+          std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+          stats_.load_seconds += diff.count();
+          stats_.hits++;
+          return program;
+        } catch (const std::runtime_error&) {
+          stats_.rejected++;
+        }
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      Program program(context, source);
+      program.Build(device, options);
+      std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+      stats_.compile_seconds += diff.count();
+      stats_.misses++;
+
+      WriteFile(path, program.Binary());
+      return program;
+    }
+
+    /// @brief Cache key of a (source, device, options) triple
+    static std::string Key(const Device& device,
+                           const std::string& source,
+                           const std::vector<std::string>& options) {
+      uint64_t hash = kFnvOffset;
+      hash = Hash(hash, source);
+      hash = Hash(hash, device.Name());
+      hash = Hash(hash, device.DriverVersion());
+      hash = Hash(hash, device.Version());
+      for (const auto& option : options) {
+        hash = Hash(hash, option);
+      }
+
+      char key[17];
+      snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+      return std::string(key);
+    }
+
+    const ProgramCacheStats& Stats() const { return stats_; }
+
+    void PrintStats(std::ostream& os) const {
+      os << "program cache: " << stats_.hits << " hits, "
+         << stats_.misses << " misses, "
+         << stats_.rejected << " rejected, "
+         << "compile " << stats_.compile_seconds << " s, "
+         << "load " << stats_.load_seconds << " s" << std::endl;
+    }
+
+  private:
+    static constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+    static constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+    std::string cache_dir_;
+    ProgramCacheStats stats_;
+
+    // FNV-1a over the string followed by a '\0' separator
+    static uint64_t Hash(uint64_t hash, const std::string& str) {
+      for (const char c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= kFnvPrime;
+      }
+      hash *= kFnvPrime;
+      return hash;
+    }
+
+    std::string EntryPath(const std::string& key) const {
+      return cache_dir_ + "/" + key + ".bin";
+    }
+
+    static bool ReadFile(const std::string& path, std::string& contents) {
+      std::ifstream input_file_stream(path, std::ios::binary);
+      if (!input_file_stream) {
+        return false;
+      }
+      std::ostringstream buffer;
+      buffer << input_file_stream.rdbuf();
+      contents = buffer.str();
+      return !contents.empty();
+    }
+
+    // Write to a temporary file first so that concurrent processes never
+    // observe a partially written binary.
+    static void WriteFile(const std::string& path, const std::string& contents) {
+      if (contents.empty()) {
+        return;
+      }
+      const std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+      {
+        std::ofstream output_file_stream(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!output_file_stream) {
+          return;
+        }
+        output_file_stream.write(contents.data(), contents.size());
+      }
+      std::rename(tmp_path.c_str(), path.c_str());
+    }
+  }; // class ProgramCache
+
+} // namespace cl
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief Compile-time parameters of a kernel variant, passed to the
+  /// compiler as '-D<name>=<value>', e.g. {{"TILE_SIZE", 16}, {"FIXED_K", 8}}.
+  typedef std::map<std::string, long> VariantParams;
+
+  /// @brief Builds one kernel source several times with different
+  /// compile-time parameters and hands out the specialized kernels.
+  ///
+  /// Each distinct parameter set is compiled once, on first use. When a
+  /// ProgramCache is given the builds go through it, so the specialized
+  /// binaries are also reused across process launches.
+  class KernelVariants {
+  public:
+    explicit KernelVariants(const Device& device,
+                            const Context& context,
+                            const std::string& source,
+                            const std::vector<std::string>& base_options={},
+                            ProgramCache* cache=nullptr)
+      : device_(device), context_(context), source_(source),
+        base_options_(base_options), cache_(cache) {}
+
+    /// @brief Get the program specialized for the given parameters
+    Program& GetProgram(const VariantParams& params) {
+      auto it = programs_.find(params);
+      if (it == programs_.end()) {
+        auto options = Options(params);
+        if (cache_ != nullptr) {
+          it = programs_.emplace(params, cache_->Get(device_, context_, source_, options)).first;
+        } else {
+          Program program(context_, source_);
+          program.Build(device_, options);
+          it = programs_.emplace(params, program).first;
+        }
+      }
+      return it->second;
+    }
+
+    /// @brief Get the kernel 'kernel_name' specialized for the given parameters
+    Kernel Get(const std::string& kernel_name, const VariantParams& params) {
+      return Kernel(GetProgram(params), kernel_name);
+    }
+
+    /// @brief Number of variants built so far
+    size_t NumVariants() const { return programs_.size(); }
+
+    /// @brief Build options of a variant: the base options followed by one
+    /// '-D<name>=<value>' per parameter.
+    std::vector<std::string> Options(const VariantParams& params) const {
+      std::vector<std::string> options(base_options_);
+      for (const auto& param : params) {
+        options.push_back("-D" + param.first + "=" + std::to_string(param.second));
+      }
+      return options;
+    }
+
+  private:
+    Device device_;
+    Context context_;
+    std::string source_;
+    std::vector<std::string> base_options_;
+    ProgramCache* cache_;
+    std::map<VariantParams, Program> programs_;
+  }; // class KernelVariants
+
+} // namespace cl
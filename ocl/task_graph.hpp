@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <set>
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief Timing of one TaskGraph::Run
+  struct TaskGraphStats {
+    double makespan_seconds = 0.0;      // first start to last end on the device
+    double busy_seconds = 0.0;          // sum of the task durations
+    double critical_path_seconds = 0.0; // longest dependency chain
+    std::vector<size_t> critical_path;  // its tasks, in order
+    size_t num_dependencies = 0;        // edges derived from the access sets
+    size_t num_wait_events = 0;         // events actually waited on
+
+    /// @brief Average number of tasks running at once
+    double Concurrency() const {
+      return makespan_seconds > 0.0 ? busy_seconds / makespan_seconds : 0.0;
+    }
+  };
+
+
+  /// @brief Graph of kernel launches and transfers that are submitted with
+  /// the dependencies implied by the buffers they read and write.
+  ///
+  /// A task depends on the last writer of every buffer it reads or writes,
+  /// and on every reader since that write of the buffers it writes. The
+  /// edges implied by other edges are dropped, so each enqueue waits on the
+  /// fewest events. Tasks go to one out-of-order queue when the device has
+  /// one, otherwise to a set of in-order queues, where a task following its
+  /// only predecessor's queue needs no event at all.
+  ///
+  /// Tasks are added in an order that respects the intended data flow; the
+  /// graph can be Run() any number of times. The buffers and host memory of
+  /// the tasks must outlive the graph.
+  class TaskGraph {
+  public:
+    typedef std::vector<cl_mem> MemorySet;
+    typedef std::function<Event(CommandQueue&, cl_uint, const cl_event*)> Enqueue;
+
+    /// @param num_in_order_queues Queues used when out-of-order execution
+    /// is not supported
+    explicit TaskGraph(const Context& context,
+                       const Device& device,
+                       size_t num_in_order_queues=4)
+      : out_of_order_(device.SupportsOutOfOrderQueue()) {
+      if (out_of_order_) {
+        queues_.emplace_back(
+          context, device, CL_QUEUE_PROFILING_ENABLE | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE
+        );
+      } else {
+        for (size_t i = 0; i < std::max<size_t>(1, num_in_order_queues); i++) {
+          queues_.emplace_back(context, device);
+        }
+      }
+    }
+
+    bool OutOfOrder() const { return out_of_order_; }
+    size_t NumTasks() const { return tasks_.size(); }
+    const std::string& TaskName(size_t task) const { return tasks_[task].name; }
+
+    /// @brief Add any command: 'enqueue' receives the queue and the event
+    /// wait list and returns the event of the command
+    size_t AddTask(const std::string& name,
+                   const MemorySet& reads,
+                   const MemorySet& writes,
+                   const Enqueue& enqueue) {
+      const size_t id = tasks_.size();
+      Task task;
+      task.name = name;
+      task.enqueue = enqueue;
+
+      std::set<size_t> dependencies;
+      for (cl_mem mem : reads) {
+        auto it = accesses_.find(mem);
+        if (it != accesses_.end() && it->second.has_writer) {
+          dependencies.insert(it->second.last_writer);
+        }
+      }
+      for (cl_mem mem : writes) {
+        auto it = accesses_.find(mem);
+        if (it != accesses_.end()) {
+          if (it->second.has_writer) {
+            dependencies.insert(it->second.last_writer);
+          }
+          dependencies.insert(it->second.readers.begin(), it->second.readers.end());
+        }
+      }
+      dependencies.erase(id);
+      num_dependencies_ += dependencies.size();
+
+      // Keep only the direct predecessors: drop any task that is already
+      // an ancestor of another dependency
+      for (size_t dependency : dependencies) {
+        bool implied = false;
+        for (size_t other : dependencies) {
+          if (other != dependency && tasks_[other].ancestors.count(dependency) != 0) {
+            implied = true;
+            break;
+          }
+        }
+        if (!implied) {
+          task.predecessors.push_back(dependency);
+        }
+        task.ancestors.insert(dependency);
+        task.ancestors.insert(tasks_[dependency].ancestors.begin(), tasks_[dependency].ancestors.end());
+      }
+
+      for (cl_mem mem : reads) {
+        accesses_[mem].readers.insert(id);
+      }
+      for (cl_mem mem : writes) {
+        Access& access = accesses_[mem];
+        access.has_writer = true;
+        access.last_writer = id;
+        access.readers.clear();
+      }
+      tasks_.push_back(std::move(task));
+      return id;
+    }
+
+    /// @brief Add a kernel launch. Kernel arguments are read when the task
+    /// is submitted, so tasks sharing a Kernel object set them in
+    /// 'set_arguments', which is called right before the launch.
+    size_t AddKernel(const std::string& name,
+                     Kernel kernel,
+                     const std::vector<size_t>& global_work_size,
+                     const std::vector<size_t>& local_work_size,
+                     const MemorySet& reads,
+                     const MemorySet& writes,
+                     const std::function<void(Kernel&)>& set_arguments=nullptr) {
+      return AddTask(name, reads, writes,
+        [=](CommandQueue& queue, cl_uint num_events, const cl_event* events) mutable {
+          if (set_arguments) {
+            set_arguments(kernel);
+          }
+          return kernel.Run(
+            queue,
+            static_cast<cl_uint>(global_work_size.size()),
+            nullptr,
+            global_work_size.data(),
+            local_work_size.empty() ? nullptr : local_work_size.data(),
+            num_events,
+            events
+          );
+        });
+    }
+
+    /// @brief Add a host to device transfer; 'src' must stay valid until
+    /// Run() returns
+    template <typename T>
+    size_t AddWrite(const std::string& name, Buffer<T>& dst, const T* src, size_t num_elmts) {
+      return AddTask(name, {}, { dst() },
+        [&dst, src, num_elmts](CommandQueue& queue, cl_uint num_events, const cl_event* events) {
+          return dst.CopyFromHost(queue, src, num_elmts, 0, false, num_events, events);
+        });
+    }
+
+    /// @brief Add a device to host transfer
+    template <typename T>
+    size_t AddRead(const std::string& name, Buffer<T>& src, T* dst, size_t num_elmts) {
+      return AddTask(name, { src() }, {},
+        [&src, dst, num_elmts](CommandQueue& queue, cl_uint num_events, const cl_event* events) {
+          return src.CopyFromDevice(queue, dst, num_elmts, 0, false, num_events, events);
+        });
+    }
+
+    /// @brief Submit every task, wait for all of them and return the timing
+    TaskGraphStats Run() {
+      size_t num_wait_events = 0;
+      std::vector<size_t> queue_tail(queues_.size(), tasks_.size());
+      size_t next_queue = 0;
+
+      for (size_t id = 0; id < tasks_.size(); id++) {
+        Task& task = tasks_[id];
+        std::vector<size_t> waits(task.predecessors);
+
+        size_t queue_index = 0;
+        if (!out_of_order_) {
+          // Follow a predecessor that is still the tail of its queue: the
+          // in-order queue then orders the two without an event
+          queue_index = queues_.size();
+          for (size_t q = 0; q < queues_.size() && queue_index == queues_.size(); q++) {
+            auto it = std::find(waits.begin(), waits.end(), queue_tail[q]);
+            if (it != waits.end()) {
+              queue_index = q;
+              waits.erase(it);
+            }
+          }
+          if (queue_index == queues_.size()) {
+            queue_index = next_queue;
+            next_queue = (next_queue + 1) % queues_.size();
+          }
+          queue_tail[queue_index] = id;
+        }
+
+        std::vector<cl_event> wait_list;
+        for (size_t wait : waits) {
+          wait_list.push_back(tasks_[wait].event());
+        }
+        num_wait_events += wait_list.size();
+        task.event = task.enqueue(
+          queues_[queue_index],
+          static_cast<cl_uint>(wait_list.size()),
+          wait_list.empty() ? nullptr : wait_list.data()
+        );
+      }
+      for (auto& queue : queues_) {
+        queue.Flush();
+      }
+      for (auto& queue : queues_) {
+        queue.Finish();
+      }
+
+      TaskGraphStats stats = Timing();
+      stats.num_dependencies = num_dependencies_;
+      stats.num_wait_events = num_wait_events;
+      return stats;
+    }
+
+    void PrintStats(std::ostream& os, const TaskGraphStats& stats) const {
+      os << "task graph: " << tasks_.size() << " tasks on "
+         << (out_of_order_ ? "an out-of-order queue" : std::to_string(queues_.size()) + " in-order queues")
+         << ", " << stats.num_dependencies << " dependencies, "
+         << stats.num_wait_events << " waited events" << std::endl;
+      os << "makespan: " << stats.makespan_seconds * 1e3 << " ms, "
+         << "critical path: " << stats.critical_path_seconds * 1e3 << " ms, "
+         << "concurrency: " << stats.Concurrency() << std::endl;
+      os << "critical path:";
+      for (size_t task : stats.critical_path) {
+        os << " " << tasks_[task].name;
+      }
+      os << std::endl;
+    }
+
+  private:
+    struct Task {
+      std::string name;
+      Enqueue enqueue;
+      std::vector<size_t> predecessors;   // after the transitive reduction
+      std::set<size_t> ancestors;
+      Event event;                        // of the last Run
+    }; // struct Task
+
+    struct Access {
+      bool has_writer = false;
+      size_t last_writer = 0;
+      std::set<size_t> readers;           // since the last write
+    }; // struct Access
+
+    bool out_of_order_;
+    std::vector<CommandQueue> queues_;
+    std::vector<Task> tasks_;
+    std::map<cl_mem, Access> accesses_;
+    size_t num_dependencies_ = 0;
+
+    // Makespan, busy time and critical path from the profiling timestamps
+    TaskGraphStats Timing() const {
+      TaskGraphStats stats;
+      if (tasks_.empty()) {
+        return stats;
+      }
+      cl_ulong first_start = tasks_[0].event.StartTime();
+      cl_ulong last_end = 0;
+      std::vector<double> path_seconds(tasks_.size(), 0.0);
+      std::vector<size_t> path_previous(tasks_.size(), tasks_.size());
+      size_t path_end = 0;
+
+      for (size_t id = 0; id < tasks_.size(); id++) {
+        const Task& task = tasks_[id];
+        const double seconds = task.event.Duration();
+        first_start = std::min(first_start, task.event.StartTime());
+        last_end = std::max(last_end, task.event.EndTime());
+        stats.busy_seconds += seconds;
+
+        // Tasks are in topological order, so the predecessors are final
+        for (size_t predecessor : task.predecessors) {
+          if (path_seconds[predecessor] > path_seconds[id]) {
+            path_seconds[id] = path_seconds[predecessor];
+            path_previous[id] = predecessor;
+          }
+        }
+        path_seconds[id] += seconds;
+        if (path_seconds[id] > path_seconds[path_end]) {
+          path_end = id;
+        }
+      }
+
+      stats.makespan_seconds = last_end > first_start ? static_cast<double>(last_end - first_start) * 1e-9 : 0.0;
+      stats.critical_path_seconds = path_seconds[path_end];
+      for (size_t id = path_end; id < tasks_.size(); id = path_previous[id]) {
+        stats.critical_path.push_back(id);
+      }
+      std::reverse(stats.critical_path.begin(), stats.critical_path.end());
+      return stats;
+    }
+  }; // class TaskGraph
+
+} // namespace cl
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <array>
+#include <type_traits>
+
+#include "ocl/common.h"
+
+
+namespace ocl {
+
+  /// @brief OpenCL C name of a host scalar type, as reported by
+  /// CL_KERNEL_ARG_TYPE_NAME, or nullptr when the name is not checked
+  template <typename T>
+  struct KernelArgTypeName {
+    static const char* Get() { return nullptr; }
+  };
+
+#define OCL_KERNEL_ARG_TYPE_NAME(_type, _name)  \
+  template <>                                   \
+  struct KernelArgTypeName<_type> {             \
+    static const char* Get() { return _name; }  \
+  };
+
+  OCL_KERNEL_ARG_TYPE_NAME(cl_char, "char")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_uchar, "uchar")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_short, "short")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_ushort, "ushort")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_int, "int")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_uint, "uint")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_long, "long")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_ulong, "ulong")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_float, "float")
+  OCL_KERNEL_ARG_TYPE_NAME(cl_double, "double")
+
+#undef OCL_KERNEL_ARG_TYPE_NAME
+
+
+  /// @brief How a host value is passed to clSetKernelArg: scalars by value
+  template <typename T>
+  struct KernelArgument {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Kernel arguments must be trivially copyable or Buffer<T>.");
+    static const bool kIsPointer = false;
+    static size_t Size() { return sizeof(T); }
+    static const void* Pointer(const T& arg) { return &arg; }
+    static const char* TypeName() { return KernelArgTypeName<T>::Get(); }
+  };
+
+  /// @brief ... and buffers as their cl_mem handle
+  template <typename T>
+  struct KernelArgument<Buffer<T>> {
+    static const bool kIsPointer = true;
+    static size_t Size() { return sizeof(cl_mem); }
+    static const void* Pointer(const Buffer<T>& arg) { return &arg(); }
+    static const char* TypeName() { return KernelArgTypeName<T>::Get(); }
+  };
+
+
+  /// @brief Kernel whose argument types are declared once, e.g.
+  /// TypedKernel<int, int, int, Buffer<float>, Buffer<float>, Buffer<float>>
+  /// for matmul_v1.
+  ///
+  /// The declared types are checked against the kernel at construction:
+  /// the number of arguments always, and scalar vs. global pointer and the
+  /// element type when the program was built with '-cl-kernel-arg-info'
+  /// (otherwise the driver may not report them). Every launch only calls
+  /// clSetKernelArg for the arguments whose value changed since the last
+  /// one, so repeated launches with the same buffers and sizes skip it
+  /// entirely.
+  ///
+  /// The argument cache assumes no one else sets arguments of the wrapped
+  /// cl_kernel, so a TypedKernel owns its kernel and is not copyable.
+  template <typename... Args>
+  class TypedKernel {
+  public:
+    static const size_t kNumArgs = sizeof...(Args);
+
+    /// @param kernel A kernel not shared with other users, e.g. from
+    /// KernelVariants::Get, which creates a new one on every call
+    explicit TypedKernel(Kernel kernel) : kernel_(std::move(kernel)) {
+      Validate();
+    }
+
+    explicit TypedKernel(Program& program, const std::string& kernel_name)
+      : TypedKernel(Kernel(program, kernel_name)) {}
+
+    TypedKernel(const TypedKernel&) = delete;
+    TypedKernel& operator= (const TypedKernel&) = delete;
+    TypedKernel(TypedKernel&&) = default;
+    TypedKernel& operator= (TypedKernel&&) = default;
+
+    const std::string& Name() const { return name_; }
+
+    /// @brief Whether the driver reported the argument types, i.e. whether
+    /// they were checked beyond their number
+    bool ArgInfoChecked() const { return arg_info_checked_; }
+
+    /// @brief clSetKernelArg calls made and skipped so far
+    size_t NumArgumentsSet() const { return num_arguments_set_; }
+    size_t NumArgumentsSkipped() const { return num_arguments_skipped_; }
+
+    /// @brief Set the arguments of the next launch, skipping the unchanged ones
+    void SetArguments(const Args&... args) {
+      SetArgumentsRecursive<0>(args...);
+    }
+
+    /// @brief Launch with the arguments of the last SetArguments
+    Event Run(CommandQueue& queue,
+              cl_uint work_dim,
+              const size_t* global_work_size,
+              const size_t* local_work_size,
+              cl_uint num_events_in_wait_list=0,
+              const cl_event* event_wait_list=nullptr) {
+      return kernel_.Run(
+        queue,
+        work_dim,
+        nullptr,
+        global_work_size,
+        local_work_size,
+        num_events_in_wait_list,
+        event_wait_list
+      );
+    }
+
+    /// @brief Set the arguments and launch
+    Event operator()(CommandQueue& queue,
+                     cl_uint work_dim,
+                     const size_t* global_work_size,
+                     const size_t* local_work_size,
+                     const Args&... args) {
+      SetArguments(args...);
+      return Run(queue, work_dim, global_work_size, local_work_size);
+    }
+
+    Kernel& GetKernel() { return kernel_; }
+
+  private:
+    Kernel kernel_;
+    std::string name_;
+    bool arg_info_checked_ = false;
+    std::array<std::vector<unsigned char>, kNumArgs> last_values_;
+    size_t num_arguments_set_ = 0;
+    size_t num_arguments_skipped_ = 0;
+
+    template <size_t Index>
+    void SetArgumentsRecursive() {}
+
+    template <size_t Index, typename T, typename... Rest>
+    void SetArgumentsRecursive(const T& first, const Rest&... rest) {
+      const size_t size = KernelArgument<T>::Size();
+      const unsigned char* value = static_cast<const unsigned char*>(KernelArgument<T>::Pointer(first));
+      std::vector<unsigned char>& last = last_values_[Index];
+      if (last.size() == size && memcmp(last.data(), value, size) == 0) {
+        num_arguments_skipped_++;
+      } else {
+        CL_CHECK_ERROR(clSetKernelArg(kernel_(), static_cast<cl_uint>(Index), size, value));
+        last.assign(value, value + size);
+        num_arguments_set_++;
+      }
+      SetArgumentsRecursive<Index + 1>(rest...);
+    }
+
+    void Validate() {
+      size_t size = 0;
+      CL_CHECK_ERROR(clGetKernelInfo(kernel_(), CL_KERNEL_FUNCTION_NAME, 0, nullptr, &size));
+      std::vector<char> name(size + 1, '\0');
+      CL_CHECK_ERROR(clGetKernelInfo(kernel_(), CL_KERNEL_FUNCTION_NAME, size, name.data(), nullptr));
+      name_ = name.data();
+
+      cl_uint num_args = 0;
+      CL_CHECK_ERROR(clGetKernelInfo(kernel_(), CL_KERNEL_NUM_ARGS, sizeof(cl_uint), &num_args, nullptr));
+      if (num_args != kNumArgs) {
+        throw std::runtime_error(
+          "Kernel '" + name_ + "' takes " + std::to_string(num_args)
+          + " arguments, " + std::to_string(kNumArgs) + " declared."
+        );
+      }
+      arg_info_checked_ = true;
+      ValidateRecursive<0, Args...>();
+    }
+
+    template <size_t Index>
+    void ValidateRecursive() {}
+
+    template <size_t Index, typename T, typename... Rest>
+    void ValidateRecursive() {
+      cl_kernel_arg_address_qualifier address = 0;
+      cl_int status = clGetKernelArgInfo(
+        kernel_(), static_cast<cl_uint>(Index), CL_KERNEL_ARG_ADDRESS_QUALIFIER,
+        sizeof(address), &address, nullptr
+      );
+      if (status == CL_KERNEL_ARG_INFO_NOT_AVAILABLE) {
+        arg_info_checked_ = false;
+        return;
+      }
+      CL_CHECK_ERROR(status);
+
+      const bool is_pointer = address == CL_KERNEL_ARG_ADDRESS_GLOBAL
+                           || address == CL_KERNEL_ARG_ADDRESS_CONSTANT;
+      if (address == CL_KERNEL_ARG_ADDRESS_LOCAL || is_pointer != KernelArgument<T>::kIsPointer) {
+        throw std::runtime_error(
+          "Kernel '" + name_ + "' argument " + std::to_string(Index) + " is "
+          + (is_pointer ? "a global pointer" : address == CL_KERNEL_ARG_ADDRESS_LOCAL ? "a local pointer" : "a scalar")
+          + ", declared " + (KernelArgument<T>::kIsPointer ? "a buffer." : "a scalar.")
+        );
+      }
+
+      const char* expected = KernelArgument<T>::TypeName();
+      if (expected != nullptr) {
+        const std::string type_name = ArgTypeName(Index);
+        // half has no host type of its own: cl_half is cl_ushort
+        const bool matches = type_name == expected
+                          || (type_name == "half" && std::string(expected) == "ushort");
+        if (!matches) {
+          throw std::runtime_error(
+            "Kernel '" + name_ + "' argument " + std::to_string(Index) + " has type '"
+            + type_name + "', declared '" + expected + "'."
+          );
+        }
+      }
+      ValidateRecursive<Index + 1, Rest...>();
+    }
+
+    // Element type of a pointer argument or type of a scalar one, e.g.
+    // "float" for 'const __global float*'
+    std::string ArgTypeName(size_t index) const {
+      size_t size = 0;
+      CL_CHECK_ERROR(clGetKernelArgInfo(
+        kernel_(), static_cast<cl_uint>(index), CL_KERNEL_ARG_TYPE_NAME, 0, nullptr, &size
+      ));
+      std::vector<char> buffer(size + 1, '\0');
+      CL_CHECK_ERROR(clGetKernelArgInfo(
+        kernel_(), static_cast<cl_uint>(index), CL_KERNEL_ARG_TYPE_NAME, size, buffer.data(), nullptr
+      ));
+      std::string type_name(buffer.data());
+      while (!type_name.empty() && (type_name.back() == '*' || type_name.back() == ' ')) {
+        type_name.pop_back();
+      }
+      return type_name;
+    }
+  }; // class TypedKernel
+
+} // namespace cl